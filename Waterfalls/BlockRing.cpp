@@ -0,0 +1,92 @@
+/***************************************************/
+/*! \class BlockRing
+    \brief Hands blocks of stems from one thread to another.
+
+    The audio thread write()s each buffer it plays,
+    one block per stem, along with the stream frame
+    it starts at and each stem's power and silence.
+    Another thread read()s the newest block waiting,
+    passing over older ones.  Each block has a slot
+    of its own in a ring of BLOCKRING_SLOTS, which the
+    writer doesn't touch again until the reader is
+    done with it, so a block is never read while it
+    is being written.  Neither side locks or waits: a
+    block written while the ring is full is dropped,
+    and counted.
+*/
+/***************************************************/
+
+#include "BlockRing.h"
+#include <string.h>
+
+BlockRing :: BlockRing( unsigned int nStems, unsigned int size )
+  : nStems(nStems), size(size), in(0), out(0), dropped(0)
+{
+  for (unsigned int i=0; i<BLOCKRING_SLOTS; i++) {
+    slots[i].frame = 0.0;
+    slots[i].frames = 0;
+    slots[i].samples = new MY_FLOAT[nStems * size];
+    slots[i].power = new double[nStems];
+    slots[i].silent = new bool[nStems];
+  }
+}
+
+BlockRing :: ~BlockRing()
+{
+  for (unsigned int i=0; i<BLOCKRING_SLOTS; i++) {
+    delete [] slots[i].samples;
+    delete [] slots[i].power;
+    delete [] slots[i].silent;
+  }
+}
+
+bool BlockRing :: write( double frame, unsigned int frames, const MY_FLOAT * const *blocks,
+                         const double *power, const bool *silent )
+{
+  // The slot after the last one written is free unless the reader is
+  // still BLOCKRING_SLOTS behind.
+  unsigned long n = in;
+  if ( n - out >= BLOCKRING_SLOTS ) {
+    dropped++;
+    return false;
+  }
+
+  if ( frames > size ) frames = size;
+  Slot &s = slots[n % BLOCKRING_SLOTS];
+  s.frame = frame;
+  s.frames = frames;
+  for (unsigned int i=0; i<nStems; i++) {
+    s.power[i] = power[i];
+    s.silent[i] = silent[i];
+    if ( !silent[i] )
+      memcpy( s.samples + i * size, blocks[i], frames * sizeof(MY_FLOAT) );
+  }
+  in = n + 1;
+  return true;
+}
+
+bool BlockRing :: read( double *frame, unsigned int *frames, MY_FLOAT * const *blocks,
+                        double *power, bool *silent )
+{
+  unsigned long n = in;
+  unsigned long o = out;
+  if ( o == n ) return false;
+
+  // Only the newest is wanted; the others are given back with it.
+  const Slot &s = slots[(n-1) % BLOCKRING_SLOTS];
+  *frame = s.frame;
+  *frames = s.frames;
+  for (unsigned int i=0; i<nStems; i++) {
+    power[i] = s.power[i];
+    silent[i] = s.silent[i];
+    if ( !s.silent[i] )
+      memcpy( blocks[i], s.samples + i * size, s.frames * sizeof(MY_FLOAT) );
+  }
+  out = n;
+  return true;
+}
+
+unsigned long BlockRing :: getDropped( void ) const
+{
+  return dropped;
+}
@@ -0,0 +1,78 @@
+/***************************************************/
+/*! \class BlockRing
+    \brief Hands blocks of stems from one thread to another.
+
+    The audio thread write()s each buffer it plays,
+    one block per stem, along with the stream frame
+    it starts at and each stem's power and silence.
+    Another thread read()s the newest block waiting,
+    passing over older ones.  Each block has a slot
+    of its own in a ring of BLOCKRING_SLOTS, which the
+    writer doesn't touch again until the reader is
+    done with it, so a block is never read while it
+    is being written.  Neither side locks or waits: a
+    block written while the ring is full is dropped,
+    and counted.
+*/
+/***************************************************/
+
+#if !defined(__BLOCKRING_H)
+#define __BLOCKRING_H
+
+#define BLOCKRING_SLOTS 8           // blocks waiting to be read, at most (a power of 2)
+
+#include "Stk.h"
+#include <atomic>
+
+class BlockRing : public Stk
+{
+public:
+  //! Class constructor, for blocks of \e nStems stems of up to \e size frames.
+  BlockRing( unsigned int nStems, unsigned int size );
+
+  //! Class destructor.
+  ~BlockRing();
+
+  //! Add a block of \e frames frames from stream frame \e frame.  Returns FALSE if the ring was full and it was dropped.
+  /*!
+    Called by the one writing thread.  \e blocks holds the samples
+    of each stem, and \e power and \e silent its power and whether
+    it is silent.  The samples of silent stems aren't copied.
+    Blocks longer than \e size are cut short.
+  */
+  bool write( double frame, unsigned int frames, const MY_FLOAT * const *blocks,
+              const double *power, const bool *silent );
+
+  //! Take the newest block waiting, passing over the others.  Returns FALSE if there was none.
+  /*!
+    Called by the one reading thread.  The samples of each stem are
+    copied to \e blocks, except for those of silent stems, which are
+    left as they were, and its power and silence to \e power and
+    \e silent.  The block's stream frame and length are returned in
+    \e frame and \e frames.
+  */
+  bool read( double *frame, unsigned int *frames, MY_FLOAT * const *blocks,
+             double *power, bool *silent );
+
+  //! Return the number of blocks dropped because the ring was full.
+  unsigned long getDropped( void ) const;
+
+protected:
+
+  struct Slot {
+    double frame;
+    unsigned int frames;
+    MY_FLOAT *samples;                    // nStems blocks of size frames
+    double *power;
+    bool *silent;
+  };
+
+  unsigned int nStems;
+  unsigned int size;
+  Slot slots[BLOCKRING_SLOTS];
+  std::atomic<unsigned long> in;          // written by the writer
+  std::atomic<unsigned long> out;         // written by the reader
+  std::atomic<unsigned long> dropped;
+};
+
+#endif // defined(__BLOCKRING_H)
@@ -0,0 +1,108 @@
+/***************************************************/
+/*! \class CallbackProfiler
+    \brief How long the audio callback takes, against its deadline.
+
+    The audio thread calls start() as each buffer's
+    callback begins and stop() as it ends.  Each
+    buffer has as long as it lasts to be filled, its
+    budget; the time taken, on a clock which only
+    goes forward, is counted in a histogram of
+    PROFILER_BINS bins, each PROFILER_STEP percent of
+    the budget wide (the last takes everything over).
+    The worst time, the total time against the total
+    budget, the buffers over budget and the stream's
+    underflows and overflows are kept too.
+
+    stop() doesn't lock or allocate, and getStats()
+    and print() can be called from any other thread
+    while it runs.
+*/
+/***************************************************/
+
+#include "CallbackProfiler.h"
+#include <stdio.h>
+#include <chrono>
+
+CallbackProfiler :: CallbackProfiler()
+  : callbacks(0), late(0), underflows(0), overflows(0), worst(0), time(0), budget(0)
+{
+  for (unsigned int i=0; i<PROFILER_BINS; i++)
+    bins[i] = 0;
+}
+
+CallbackProfiler :: ~CallbackProfiler()
+{
+}
+
+UINT64 CallbackProfiler :: start( void ) const
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+void CallbackProfiler :: stop( UINT64 started, unsigned int frames, MY_FLOAT rate, bool underflow, bool overflow )
+{
+  UINT64 taken = start() - started;
+  UINT64 allowed = (UINT64) ( frames * 1e9 / rate );
+
+  // Only the audio thread writes, so the counts needn't be added
+  // atomically, just stored so that other threads can read them.
+  std::memory_order relaxed = std::memory_order_relaxed;
+  unsigned int bin = PROFILER_BINS - 1;
+  if ( allowed > 0 && taken * 100 / allowed / PROFILER_STEP < bin )
+    bin = (unsigned int) ( taken * 100 / allowed / PROFILER_STEP );
+  bins[bin].store( bins[bin].load(relaxed) + 1, relaxed );
+  time.store( time.load(relaxed) + taken, relaxed );
+  budget.store( budget.load(relaxed) + allowed, relaxed );
+  if ( taken > worst.load(relaxed) ) worst.store( taken, relaxed );
+  if ( taken > allowed ) late.store( late.load(relaxed) + 1, relaxed );
+  if ( underflow ) underflows.store( underflows.load(relaxed) + 1, relaxed );
+  if ( overflow ) overflows.store( overflows.load(relaxed) + 1, relaxed );
+  callbacks.store( callbacks.load(relaxed) + 1, relaxed );
+}
+
+void CallbackProfiler :: getStats( CallbackStats *stats ) const
+{
+  stats->callbacks = callbacks;
+  stats->late = late;
+  stats->underflows = underflows;
+  stats->overflows = overflows;
+  stats->worst = worst * 1e-9;
+  stats->time = time * 1e-9;
+  stats->budget = budget * 1e-9;
+  for (unsigned int i=0; i<PROFILER_BINS; i++)
+    stats->bins[i] = bins[i];
+}
+
+void CallbackProfiler :: print( void ) const
+{
+  CallbackStats stats;
+  getStats( &stats );
+  if ( stats.callbacks == 0 ) {
+    fprintf( stderr, "no callbacks yet\n" );
+    return;
+  }
+
+  double mean = stats.time / stats.callbacks;
+  double allowed = stats.budget / stats.callbacks;
+  fprintf( stderr, "%lu callbacks, %lu over budget, %lu output underflows, %lu input overflows\n",
+           stats.callbacks, stats.late, stats.underflows, stats.overflows );
+  fprintf( stderr, "mean %.3f ms, worst %.3f ms, of %.3f ms: %.1f%% of the budget used, worst %.1f%%\n",
+           mean * 1e3, stats.worst * 1e3, allowed * 1e3,
+           100.0 * stats.time / stats.budget, 100.0 * stats.worst / allowed );
+
+  // The bars are scaled to the fullest bin; empty bins are left out.
+  unsigned long most = 0;
+  for (unsigned int i=0; i<PROFILER_BINS; i++)
+    if ( stats.bins[i] > most ) most = stats.bins[i];
+  for (unsigned int i=0; i<PROFILER_BINS; i++) {
+    if ( stats.bins[i] == 0 ) continue;
+    char bar[41];
+    unsigned int length = (unsigned int) ( stats.bins[i] * 40 / most );
+    for (unsigned int j=0; j<length; j++) bar[j] = '#';
+    bar[length] = '\0';
+    if ( i == PROFILER_BINS - 1 )
+      fprintf( stderr, "     >%3u%% %-40s %lu\n", i * PROFILER_STEP, bar, stats.bins[i] );
+    else
+      fprintf( stderr, "%4u-%3u%% %-40s %lu\n", i * PROFILER_STEP, (i+1) * PROFILER_STEP, bar, stats.bins[i] );
+  }
+}
@@ -0,0 +1,84 @@
+/***************************************************/
+/*! \class CallbackProfiler
+    \brief How long the audio callback takes, against its deadline.
+
+    The audio thread calls start() as each buffer's
+    callback begins and stop() as it ends.  Each
+    buffer has as long as it lasts to be filled, its
+    budget; the time taken, on a clock which only
+    goes forward, is counted in a histogram of
+    PROFILER_BINS bins, each PROFILER_STEP percent of
+    the budget wide (the last takes everything over).
+    The worst time, the total time against the total
+    budget, the buffers over budget and the stream's
+    underflows and overflows are kept too.
+
+    stop() doesn't lock or allocate, and getStats()
+    and print() can be called from any other thread
+    while it runs.
+*/
+/***************************************************/
+
+#if !defined(__CALLBACKPROFILER_H)
+#define __CALLBACKPROFILER_H
+
+#define PROFILER_BINS 41            // 0-5%, 5-10% ... 195-200%, and over
+#define PROFILER_STEP 5             // percent of the budget in each bin
+
+#include "Stk.h"
+#include <atomic>
+
+//! What a CallbackProfiler has counted, as returned by CallbackProfiler::getStats().
+struct CallbackStats {
+  unsigned long callbacks;
+  unsigned long late;             // callbacks over budget
+  unsigned long underflows;       // of the output
+  unsigned long overflows;        // of the input
+  double worst;                   // seconds, the longest callback
+  double time;                    // seconds, in all the callbacks
+  double budget;                  // seconds, their budgets
+  unsigned long bins[PROFILER_BINS];
+};
+
+class CallbackProfiler : public Stk
+{
+public:
+  //! Default constructor, which clears the counts.
+  CallbackProfiler();
+
+  //! Class destructor.
+  ~CallbackProfiler();
+
+  //! Return the time a callback starts, to pass to stop().
+  UINT64 start( void ) const;
+
+  //! Count a callback which started at \e started and filled \e frames frames at \e rate.
+  /*!
+    \e underflow and \e overflow are whether the stream reported an
+    output underflow or input overflow before it.
+  */
+  void stop( UINT64 started, unsigned int frames, MY_FLOAT rate, bool underflow, bool overflow );
+
+  //! Copy the counts so far into \e stats.
+  /*!
+    The counts are read one by one while callbacks go on being
+    counted, so they can differ by a callback or two.
+  */
+  void getStats( CallbackStats *stats ) const;
+
+  //! Print the counts so far, and the histogram, to stderr.
+  void print( void ) const;
+
+protected:
+
+  std::atomic<unsigned long> callbacks;
+  std::atomic<unsigned long> late;
+  std::atomic<unsigned long> underflows;
+  std::atomic<unsigned long> overflows;
+  std::atomic<UINT64> worst;              // nanoseconds
+  std::atomic<UINT64> time;
+  std::atomic<UINT64> budget;
+  std::atomic<unsigned long> bins[PROFILER_BINS];
+};
+
+#endif // defined(__CALLBACKPROFILER_H)
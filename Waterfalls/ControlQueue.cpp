@@ -0,0 +1,46 @@
+/***************************************************/
+/*! \class ControlQueue
+    \brief Carries controls from one thread to the audio thread.
+
+    The user interface push()es each change to the
+    playback (a gain, mute or solo, a seek, a loop, a
+    song skip or a speed) as a Control, and the audio
+    callback pop()s them at the start of a buffer, so
+    that nothing changes part way through one.  The
+    queue is a ring of CONTROL_SLOTS for one thread
+    to push to and one to pop from.  Neither locks or
+    waits: push() returns FALSE, and the control is
+    not sent, when the ring is full.
+*/
+/***************************************************/
+
+#include "ControlQueue.h"
+
+ControlQueue :: ControlQueue()
+  : in(0), out(0)
+{
+}
+
+ControlQueue :: ~ControlQueue()
+{
+}
+
+bool ControlQueue :: push( const Control &control )
+{
+  unsigned long n = in;
+  if ( n - out >= CONTROL_SLOTS ) return false;
+
+  slots[n % CONTROL_SLOTS] = control;
+  in = n + 1;
+  return true;
+}
+
+bool ControlQueue :: pop( Control *control )
+{
+  unsigned long o = out;
+  if ( o == in ) return false;
+
+  *control = slots[o % CONTROL_SLOTS];
+  out = o + 1;
+  return true;
+}
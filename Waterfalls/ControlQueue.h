@@ -0,0 +1,69 @@
+/***************************************************/
+/*! \class ControlQueue
+    \brief Carries controls from one thread to the audio thread.
+
+    The user interface push()es each change to the
+    playback (a gain, mute or solo, a seek, a loop, a
+    song skip or a speed) as a Control, and the audio
+    callback pop()s them at the start of a buffer, so
+    that nothing changes part way through one.  The
+    queue is a ring of CONTROL_SLOTS for one thread
+    to push to and one to pop from.  Neither locks or
+    waits: push() returns FALSE, and the control is
+    not sent, when the ring is full.
+*/
+/***************************************************/
+
+#if !defined(__CONTROLQUEUE_H)
+#define __CONTROLQUEUE_H
+
+#define CONTROL_SLOTS 64              // controls waiting, at most (a power of 2)
+
+#include "Stk.h"
+#include <atomic>
+
+//! A change to the playback, sent through a ControlQueue.
+struct Control {
+  //! What is to change.
+  enum TYPE {
+    GAIN,           /*!< The gain of stem \e stem to output channel \e channel, to \e value. */
+    MUTE,           /*!< Mute stem \e stem if \e value is not 0, or unmute it. */
+    SOLO,           /*!< Solo stem \e stem if \e value is not 0, or unsolo it. */
+    SOLO_ONLY,      /*!< Solo stem \e stem and unsolo the others. */
+    CLEAR_SOLO,     /*!< Unsolo every stem. */
+    SEEK,           /*!< Move every stem to \e value seconds into the song. */
+    LOOP,           /*!< Loop from \e value to \e end seconds, or stop looping if they're equal. */
+    SKIP,           /*!< Go on to the next song now. */
+    SPEED           /*!< Play at \e value times the speed, without changing the pitch. */
+  };
+
+  TYPE type;
+  unsigned int stem;
+  unsigned int channel;
+  double value;
+  double end;
+};
+
+class ControlQueue : public Stk
+{
+public:
+  //! Default constructor, for an empty queue.
+  ControlQueue();
+
+  //! Class destructor.
+  ~ControlQueue();
+
+  //! Send \e control, called by the one sending thread.  Returns FALSE if the queue was full.
+  bool push( const Control &control );
+
+  //! Take the oldest control waiting into \e control, called by the audio thread.  Returns FALSE if there was none.
+  bool pop( Control *control );
+
+protected:
+
+  Control slots[CONTROL_SLOTS];
+  std::atomic<unsigned long> in;          // written by the sender
+  std::atomic<unsigned long> out;         // written by the audio thread
+};
+
+#endif // defined(__CONTROLQUEUE_H)
@@ -0,0 +1,558 @@
+/***************************************************/
+/*! \class FlacDecoder
+    \brief FLAC audio data decoder.
+
+    This class decodes FLAC streams one FLAC frame
+    (here called a block, to avoid confusion with
+    sample frames) at a time, without any external
+    libraries.  When a stream is opened, the block
+    headers are scanned (nothing is decoded) to build
+    a table of the file offset and first sample frame
+    of every block.  Any range of sample frames can
+    then be read by decoding just the blocks which
+    hold it, so a seek costs one block decode.  The
+    last decoded block is kept, so reading a stream in
+    small consecutive pieces decodes each block once.
+
+    Samples are returned as STK_SINT16 for streams of
+    up to 16 bits and as STK_SINT32 for deeper ones
+    (up to 24 bits), aligned to the most significant
+    bit so that the full scale is that of the type.
+*/
+/***************************************************/
+
+#include "FlacDecoder.h"
+#include <string.h>
+
+// Reads big-endian bit fields from a block held in memory.  Reading
+// past the end gives zeros and sets overrun.
+struct BitReader {
+  const unsigned char *data;
+  const unsigned char *end;
+  UINT64 cache;
+  unsigned int bits;
+  bool overrun;
+
+  BitReader( const unsigned char *p, size_t n )
+    : data(p), end(p+n), cache(0), bits(0), overrun(false) {}
+
+  inline void refill( void )
+  {
+    while ( bits <= 56 && data < end ) {
+      cache |= (UINT64) *data++ << (56 - bits);
+      bits += 8;
+    }
+  }
+
+  // Read an n-bit unsigned value, n <= 32.
+  inline UINT32 read( unsigned int n )
+  {
+    if ( n == 0 ) return 0;
+    if ( bits < n ) {
+      refill();
+      if ( bits < n ) {
+        overrun = true;
+        bits = 64;
+      }
+    }
+    UINT32 value = (UINT32) (cache >> (64 - n));
+    cache <<= n;
+    bits -= n;
+    return value;
+  }
+
+  // Read an n-bit two's complement value, n <= 32.
+  inline SINT32 readSigned( unsigned int n )
+  {
+    if ( n == 0 ) return 0;
+    return (SINT32) (read( n ) << (32 - n)) >> (32 - n);
+  }
+
+  // Count the zero bits before the next one bit, and skip them all.
+  inline UINT32 unary( void )
+  {
+    UINT32 zeros = 0;
+    for (;;) {
+      if ( bits == 0 ) {
+        refill();
+        if ( bits == 0 ) {
+          overrun = true;
+          return zeros;
+        }
+      }
+      if ( cache == 0 ) {
+        zeros += bits;
+        bits = 0;
+        continue;
+      }
+      unsigned int n = __builtin_clzll( cache );
+      zeros += n;
+      cache <<= n;
+      cache <<= 1;
+      bits -= n + 1;
+      return zeros;
+    }
+  }
+};
+
+// CRC-8 (header) and CRC-16 (block) lookup tables, made on first use.
+struct CrcTables {
+  unsigned char crc8[256];
+  unsigned short crc16[256];
+
+  CrcTables()
+  {
+    for (int i=0; i<256; i++) {
+      unsigned char c8 = (unsigned char) i;
+      unsigned short c16 = (unsigned short) (i << 8);
+      for (int j=0; j<8; j++) {
+        c8 = (c8 & 0x80) ? (unsigned char) ((c8 << 1) ^ 0x07) : (unsigned char) (c8 << 1);
+        c16 = (c16 & 0x8000) ? (unsigned short) ((c16 << 1) ^ 0x8005) : (unsigned short) (c16 << 1);
+      }
+      crc8[i] = c8;
+      crc16[i] = c16;
+    }
+  }
+};
+
+static const CrcTables &crcTables( void )
+{
+  static const CrcTables tables;
+  return tables;
+}
+
+// Decode the residual of a subframe with a predictor of the given
+// order, into out[order] to out[blockSize-1].
+static bool readResidual( BitReader &in, unsigned int blockSize, unsigned int order, SINT32 *out )
+{
+  unsigned int method = in.read( 2 );
+  if ( method > 1 ) return false;
+  unsigned int paramBits = (method == 0) ? 4 : 5;
+  unsigned int escape = (method == 0) ? 15 : 31;
+  unsigned int partitionOrder = in.read( 4 );
+  unsigned int partitions = 1 << partitionOrder;
+  unsigned int partitionSize = blockSize >> partitionOrder;
+  if ( (partitionSize << partitionOrder) != blockSize || partitionSize < order ) return false;
+
+  unsigned int i = order;
+  for (unsigned int p=0; p<partitions; p++) {
+    unsigned int n = (p == 0) ? partitionSize - order : partitionSize;
+    unsigned int k = in.read( paramBits );
+    if ( k == escape ) {
+      // Unencoded binary samples.
+      unsigned int size = in.read( 5 );
+      for (unsigned int j=0; j<n; j++)
+        out[i++] = in.readSigned( size );
+    }
+    else {
+      for (unsigned int j=0; j<n; j++) {
+        UINT32 value = (in.unary() << k) | in.read( k );
+        out[i++] = (SINT32) (value >> 1) ^ -(SINT32) (value & 1);
+      }
+    }
+    if ( in.overrun ) return false;
+  }
+
+  return true;
+}
+
+// Decode one subframe of bps-bit samples into out.
+static bool readSubframe( BitReader &in, unsigned int blockSize, unsigned int bps, SINT32 *out )
+{
+  unsigned int i, j;
+  if ( in.read( 1 ) ) return false;
+  unsigned int type = in.read( 6 );
+
+  unsigned int wasted = 0;
+  if ( in.read( 1 ) ) {
+    wasted = in.unary() + 1;
+    if ( wasted >= bps ) return false;
+    bps -= wasted;
+  }
+
+  if ( type == 0 ) {
+    // Constant.
+    SINT32 value = in.readSigned( bps );
+    for (i=0; i<blockSize; i++) out[i] = value;
+  }
+  else if ( type == 1 ) {
+    // Verbatim.
+    for (i=0; i<blockSize; i++) out[i] = in.readSigned( bps );
+  }
+  else if ( type >= 8 && type <= 12 ) {
+    // Fixed polynomial predictor.
+    unsigned int order = type - 8;
+    if ( order > blockSize ) return false;
+    for (i=0; i<order; i++) out[i] = in.readSigned( bps );
+    if ( !readResidual( in, blockSize, order, out ) ) return false;
+    switch ( order ) {
+    case 1:
+      for (i=1; i<blockSize; i++) out[i] += out[i-1];
+      break;
+    case 2:
+      for (i=2; i<blockSize; i++) out[i] += 2*out[i-1] - out[i-2];
+      break;
+    case 3:
+      for (i=3; i<blockSize; i++) out[i] += 3*out[i-1] - 3*out[i-2] + out[i-3];
+      break;
+    case 4:
+      for (i=4; i<blockSize; i++) out[i] += 4*out[i-1] - 6*out[i-2] + 4*out[i-3] - out[i-4];
+      break;
+    }
+  }
+  else if ( type >= 32 ) {
+    // Linear predictor.
+    unsigned int order = type - 31;
+    if ( order > blockSize ) return false;
+    for (i=0; i<order; i++) out[i] = in.readSigned( bps );
+    unsigned int precision = in.read( 4 ) + 1;
+    if ( precision == 16 ) return false;
+    int shift = in.readSigned( 5 );
+    if ( shift < 0 ) return false;
+    SINT32 coefficients[32];
+    for (j=0; j<order; j++) coefficients[j] = in.readSigned( precision );
+    if ( !readResidual( in, blockSize, order, out ) ) return false;
+    for (i=order; i<blockSize; i++) {
+      long long sum = 0;
+      for (j=0; j<order; j++)
+        sum += (long long) coefficients[j] * out[i-1-j];
+      out[i] += (SINT32) (sum >> shift);
+    }
+  }
+  else return false;
+
+  if ( wasted ) {
+    for (i=0; i<blockSize; i++) out[i] <<= wasted;
+  }
+
+  return !in.overrun;
+}
+
+FlacDecoder :: FlacDecoder()
+  : scanned(false), dataStart(0), dataEnd(0), totalFrames(0), sampleRate(0), channels(0), bits(0),
+    minBlockSize(0), maxBlockSize(0), variable(false),
+    blockData(0), blockDataSize(0), samples(0), current(-1), currentSize(0)
+{
+  msg[0] = 0;
+}
+
+FlacDecoder :: ~FlacDecoder()
+{
+  if ( blockData ) delete [] blockData;
+  if ( samples ) delete [] samples;
+}
+
+bool FlacDecoder :: open( FILE *file )
+{
+  blocks.clear();
+  scanned = false;
+  current = -1;
+
+  unsigned char marker[4];
+  if ( fread(marker, 4, 1, file) != 1 || strncmp((char *) marker, "fLaC", 4) ) {
+    sprintf(msg, "FlacDecoder: Stream marker not found.");
+    return false;
+  }
+
+  // Metadata blocks ... only STREAMINFO is used.
+  bool info = false, last = false;
+  while ( !last ) {
+    unsigned char header[4];
+    if ( fread(header, 4, 1, file) != 1 ) goto error;
+    last = (header[0] & 0x80) != 0;
+    unsigned int type = header[0] & 0x7F;
+    long length = (header[1] << 16) | (header[2] << 8) | header[3];
+    if ( type == 0 && length >= 34 ) {
+      unsigned char b[34];
+      if ( fread(b, 34, 1, file) != 1 ) goto error;
+      minBlockSize = (b[0] << 8) | b[1];
+      maxBlockSize = (b[2] << 8) | b[3];
+      sampleRate = (b[10] << 12) | (b[11] << 4) | (b[12] >> 4);
+      channels = ((b[12] >> 1) & 7) + 1;
+      bits = (((b[12] & 1) << 4) | (b[13] >> 4)) + 1;
+      totalFrames = (unsigned long) ( ((UINT64) (b[13] & 15) << 32) |
+        ((UINT64) b[14] << 24) | (b[15] << 16) | (b[16] << 8) | b[17] );
+      length -= 34;
+      info = true;
+    }
+    else if ( type == 127 ) goto error;
+    if ( length > 0 && fseek(file, length, SEEK_CUR) == -1 ) goto error;
+  }
+
+  if ( !info ) {
+    sprintf(msg, "FlacDecoder: STREAMINFO block not found.");
+    return false;
+  }
+  if ( bits < 4 || bits > 24 ) {
+    sprintf(msg, "FlacDecoder: %d bits per sample are not supported.", bits);
+    return false;
+  }
+  if ( sampleRate == 0 || maxBlockSize < 16 || minBlockSize > maxBlockSize ) {
+    sprintf(msg, "FlacDecoder: Invalid stream information.");
+    return false;
+  }
+
+  {
+    long start = ftell(file);
+    if ( start == -1 || fseek(file, 0, SEEK_END) == -1 ) goto error;
+    long end = ftell(file);
+    if ( end == -1 ) goto error;
+
+    if ( samples ) delete [] samples;
+    samples = new SINT32[channels * maxBlockSize];
+    dataStart = start;
+    dataEnd = end;
+  }
+
+  // The blocks are left to be found when the data is read, unless
+  // finding them is the only way to know the length.
+  if ( totalFrames == 0 ) {
+    if ( !scan( file, dataStart, dataEnd ) ) goto error;
+    if ( blocks.empty() ) {
+      sprintf(msg, "FlacDecoder: No audio data found.");
+      return false;
+    }
+  }
+  return true;
+
+ error:
+  sprintf(msg, "FlacDecoder: Error reading stream.");
+  return false;
+}
+
+unsigned int FlacDecoder :: parseHeader( const unsigned char *p, size_t n, Header *header ) const
+{
+  if ( n < 6 || p[0] != 0xFF || (p[1] & 0xFE) != 0xF8 ) return 0;
+  unsigned int sizeCode = p[2] >> 4;
+  unsigned int rateCode = p[2] & 15;
+  unsigned int assignment = p[3] >> 4;
+  unsigned int bitsCode = (p[3] >> 1) & 7;
+  if ( sizeCode == 0 || rateCode == 15 || assignment > 10 || bitsCode == 3 || (p[3] & 1) ) return 0;
+
+  // UTF-8 style coded block or sample number.
+  size_t i = 4;
+  UINT64 number = p[i++];
+  unsigned int extra = 0;
+  if ( number & 0x80 ) {
+    unsigned int mask = 0x40;
+    while ( (number & mask) && mask > 1 ) {
+      extra++;
+      mask >>= 1;
+    }
+    if ( extra == 0 || extra > 6 || (number & mask) ) return 0;
+    number &= mask - 1;
+  }
+  if ( i + extra + 5 > n ) return 0;
+  for (unsigned int j=0; j<extra; j++) {
+    if ( (p[i] & 0xC0) != 0x80 ) return 0;
+    number = (number << 6) | (p[i++] & 0x3F);
+  }
+
+  unsigned int blockSize;
+  if ( sizeCode == 1 ) blockSize = 192;
+  else if ( sizeCode <= 5 ) blockSize = 576 << (sizeCode - 2);
+  else if ( sizeCode == 6 ) blockSize = p[i++] + 1;
+  else if ( sizeCode == 7 ) {
+    blockSize = ((p[i] << 8) | p[i+1]) + 1;
+    i += 2;
+  }
+  else blockSize = 256 << (sizeCode - 8);
+
+  if ( rateCode == 12 ) i++;
+  else if ( rateCode == 13 || rateCode == 14 ) i += 2;
+
+  const unsigned char *table = crcTables().crc8;
+  unsigned char crc = 0;
+  for (size_t j=0; j<i; j++) crc = table[crc ^ p[j]];
+  if ( crc != p[i++] ) return 0;
+
+  static const unsigned int sizes[8] = { 0, 8, 12, 0, 16, 20, 24, 32 };
+  header->length = (unsigned int) i;
+  header->blockSize = blockSize;
+  header->assignment = assignment;
+  header->channels = (assignment < 8) ? assignment + 1 : 2;
+  header->bits = (bitsCode == 0) ? bits : sizes[bitsCode];
+  header->number = number;
+  return header->length;
+}
+
+bool FlacDecoder :: scan( FILE *file, UINT64 offset, UINT64 end )
+{
+  // A block header is accepted where it carries the next block or
+  // sample number and the bytes since the previous header pass the
+  // CRC-16 of the previous block.  Sync codes in the audio data are
+  // thereby skipped without decoding anything.
+  if ( fseek(file, (long) offset, SEEK_SET) == -1 ) return false;
+  unsigned char *buffer = new unsigned char[FLAC_SCAN_SIZE];
+  const unsigned short *table = crcTables().crc16;
+  UINT64 base = offset, total = 0;
+  size_t have = 0, pos = 0;
+  unsigned short crc = 0;
+  bool eof = false;
+
+  while ( !eof ) {
+    // Keep the bytes not yet searched and refill the buffer.
+    memmove( buffer, buffer + pos, have - pos );
+    base += pos;
+    have -= pos;
+    pos = 0;
+    size_t count = fread( buffer + have, 1, FLAC_SCAN_SIZE - have, file );
+    have += count;
+    eof = ( count == 0 || base + have >= end );
+
+    // Leave room for the longest header (16 bytes) until the end.
+    size_t limit = eof ? have : (have > 16 ? have - 16 : 0);
+    for ( ; pos<limit; pos++ ) {
+      Header header;
+      if ( buffer[pos] == 0xFF && (blocks.empty() || crc == 0) &&
+           parseHeader( buffer + pos, have - pos, &header ) ) {
+        if ( blocks.empty() ) variable = (buffer[pos+1] & 1) != 0;
+        UINT64 expected = variable ? total : blocks.size();
+        if ( header.number == expected && header.channels == channels && header.bits == bits &&
+             ((buffer[pos+1] & 1) != 0) == variable && header.blockSize <= maxBlockSize ) {
+          Block block = { base + pos, total };
+          blocks.push_back( block );
+          total += header.blockSize;
+          crc = 0;
+        }
+      }
+      crc = (unsigned short) ((crc << 8) ^ table[(crc >> 8) ^ buffer[pos]]);
+    }
+  }
+
+  delete [] buffer;
+  dataEnd = base + have;
+  totalFrames = (unsigned long) total;
+  scanned = true;
+  return true;
+}
+
+void FlacDecoder :: shareBlocks( const FlacDecoder &source )
+{
+  // The table isn't changed once built, so it can be copied while
+  // source reads with it.
+  if ( !source.scanned || source.dataStart != dataStart || source.channels != channels ||
+       source.bits != bits || source.maxBlockSize != maxBlockSize ) return;
+  blocks = source.blocks;
+  dataEnd = source.dataEnd;
+  totalFrames = source.totalFrames;
+  variable = source.variable;
+  current = -1;
+  scanned = true;
+}
+
+bool FlacDecoder :: decode( FILE *file, unsigned long index )
+{
+  UINT64 offset = blocks[index].offset;
+  UINT64 end = (index + 1 < blocks.size()) ? blocks[index+1].offset : dataEnd;
+  size_t size = (size_t) (end - offset);
+  if ( size > blockDataSize ) {
+    if ( blockData ) delete [] blockData;
+    blockData = new unsigned char[size];
+    blockDataSize = size;
+  }
+  if ( fseek(file, (long) offset, SEEK_SET) == -1 ) return false;
+  if ( fread(blockData, 1, size, file) != size ) return false;
+
+  Header header;
+  if ( !parseHeader( blockData, size, &header ) ) return false;
+  if ( header.blockSize > maxBlockSize ) return false;
+
+  unsigned int c, i, n = header.blockSize;
+  BitReader in( blockData + header.length, size - header.length );
+  for (c=0; c<channels; c++) {
+    // The side channel has one more bit.
+    unsigned int bps = header.bits;
+    if ( (header.assignment == 8 || header.assignment == 10) && c == 1 ) bps++;
+    if ( header.assignment == 9 && c == 0 ) bps++;
+    if ( !readSubframe( in, n, bps, samples + c*maxBlockSize ) ) return false;
+  }
+
+  SINT32 *left = samples, *right = samples + maxBlockSize;
+  if ( header.assignment == 8 ) {
+    for (i=0; i<n; i++) right[i] = left[i] - right[i];
+  }
+  else if ( header.assignment == 9 ) {
+    for (i=0; i<n; i++) left[i] += right[i];
+  }
+  else if ( header.assignment == 10 ) {
+    for (i=0; i<n; i++) {
+      SINT32 side = right[i];
+      SINT32 mid = (SINT32) (((UINT32) left[i] << 1) | (side & 1));
+      left[i] = (mid + side) >> 1;
+      right[i] = (mid - side) >> 1;
+    }
+  }
+
+  current = index;
+  currentSize = n;
+  return true;
+}
+
+bool FlacDecoder :: read( FILE *file, unsigned long frame, unsigned long frames, void *buffer )
+{
+  if ( !scanned && !scan( file, dataStart, dataEnd ) ) return false;
+  if ( frame >= totalFrames || frames > totalFrames - frame ) return false;
+
+  unsigned int shift = ((bits > 16) ? 32 : 16) - bits;
+  SINT16 *out16 = (SINT16 *) buffer;
+  SINT32 *out32 = (SINT32 *) buffer;
+  while ( frames > 0 ) {
+    // Find the block holding frame.
+    unsigned long low = 0, high = blocks.size() - 1;
+    while ( low < high ) {
+      unsigned long middle = (low + high + 1) / 2;
+      if ( blocks[middle].start <= frame ) low = middle;
+      else high = middle - 1;
+    }
+    if ( (long) low != current && !decode( file, low ) ) {
+      current = -1;
+      return false;
+    }
+
+    unsigned long offset = frame - (unsigned long) blocks[low].start;
+    unsigned long n = currentSize - offset;
+    if ( n > frames ) n = frames;
+    for (unsigned long i=0; i<n; i++) {
+      for (unsigned int c=0; c<channels; c++) {
+        SINT32 sample = samples[c*maxBlockSize + offset + i];
+        if ( bits > 16 ) *out32++ = (SINT32) ((UINT32) sample << shift);
+        else *out16++ = (SINT16) (sample << shift);
+      }
+    }
+    frame += n;
+    frames -= n;
+  }
+
+  return true;
+}
+
+unsigned long FlacDecoder :: getFrames( void ) const
+{
+  return totalFrames;
+}
+
+unsigned int FlacDecoder :: getChannels( void ) const
+{
+  return channels;
+}
+
+unsigned long FlacDecoder :: getSampleRate( void ) const
+{
+  return sampleRate;
+}
+
+unsigned int FlacDecoder :: getBits( void ) const
+{
+  return bits;
+}
+
+Stk::STK_FORMAT FlacDecoder :: getFormat( void ) const
+{
+  return (bits > 16) ? STK_SINT32 : STK_SINT16;
+}
+
+const char *FlacDecoder :: getMessage( void ) const
+{
+  return msg;
+}
@@ -0,0 +1,131 @@
+/***************************************************/
+/*! \class FlacDecoder
+    \brief FLAC audio data decoder.
+
+    This class decodes FLAC streams one FLAC frame
+    (here called a block, to avoid confusion with
+    sample frames) at a time, without any external
+    libraries.  Opening a stream only reads its
+    STREAMINFO, so its format and length are quick to
+    find.  When samples are first read, the block
+    headers are scanned (nothing is decoded) to build
+    a table of the file offset and first sample frame
+    of every block.  Any range of sample frames can
+    then be read by decoding just the blocks which
+    hold it, so a seek costs one block decode.  The
+    last decoded block is kept, so reading a stream in
+    small consecutive pieces decodes each block once.
+
+    Samples are returned as STK_SINT16 for streams of
+    up to 16 bits and as STK_SINT32 for deeper ones
+    (up to 24 bits), aligned to the most significant
+    bit so that the full scale is that of the type.
+*/
+/***************************************************/
+
+#if !defined(__FLACDECODER_H)
+#define __FLACDECODER_H
+
+#define FLAC_SCAN_SIZE 65536    // bytes read at a time while scanning
+
+#include "Stk.h"
+#include <stdio.h>
+#include <vector>
+
+class FlacDecoder : public Stk
+{
+public:
+  //! Default constructor.
+  FlacDecoder();
+
+  //! Class destructor.
+  ~FlacDecoder();
+
+  //! Read the stream information.
+  /*!
+    \e file must be positioned at the "fLaC" marker.  The block table
+    is built by the first read(), or here if STREAMINFO doesn't give
+    the stream length.  Returns FALSE if the stream is invalid or uses
+    an unsupported feature, with a description in getMessage().
+  */
+  bool open( FILE *file );
+
+  //! Take the block table from \e source, opened on the same stream, if it has been built.
+  /*!
+    Another reader of a stream is opened this way without reading the
+    whole stream again.  \e source can go on reading meanwhile.
+  */
+  void shareBlocks( const FlacDecoder &source );
+
+  //! Read \e frames sample frames, starting at \e frame, from \e file into \e buffer.
+  /*!
+    \e buffer receives interleaved samples of the type given by
+    getFormat().  Returns FALSE if the range is not in the stream or
+    the data is corrupt.  Once the blocks are scanned, the stream is
+    as long as the blocks found, should STREAMINFO say otherwise.
+  */
+  bool read( FILE *file, unsigned long frame, unsigned long frames, void *buffer );
+
+  //! Return the stream length in sample frames (see read()).
+  unsigned long getFrames( void ) const;
+
+  //! Return the number of audio channels.
+  unsigned int getChannels( void ) const;
+
+  //! Return the sample rate in Hz.
+  unsigned long getSampleRate( void ) const;
+
+  //! Return the number of bits per sample in the stream.
+  unsigned int getBits( void ) const;
+
+  //! Return the format of the samples read (STK_SINT16 or STK_SINT32).
+  STK_FORMAT getFormat( void ) const;
+
+  //! Return a description of the last open() error.
+  const char *getMessage( void ) const;
+
+protected:
+
+  struct Block {
+    UINT64 offset;
+    UINT64 start;
+  };
+
+  struct Header {
+    unsigned int length;
+    unsigned int blockSize;
+    unsigned int channels;
+    unsigned int assignment;
+    unsigned int bits;
+    UINT64 number;
+  };
+
+  // Parse the block header at \e p, of at most \e n bytes.  Return its length, or 0 if invalid.
+  unsigned int parseHeader( const unsigned char *p, size_t n, Header *header ) const;
+
+  // Find the blocks of the audio data, which starts at \e offset and ends at \e end.
+  bool scan( FILE *file, UINT64 offset, UINT64 end );
+
+  // Decode block \e index into the sample buffer.
+  bool decode( FILE *file, unsigned long index );
+
+  std::vector<Block> blocks;
+  bool scanned;
+  UINT64 dataStart;
+  UINT64 dataEnd;
+  unsigned long totalFrames;
+  unsigned long sampleRate;
+  unsigned int channels;
+  unsigned int bits;
+  unsigned int minBlockSize;
+  unsigned int maxBlockSize;
+  bool variable;
+  unsigned char *blockData;
+  size_t blockDataSize;
+  SINT32 *samples;
+  long current;
+  unsigned int currentSize;
+  char msg[256];
+};
+
+#endif // defined(__FLACDECODER_H)
@@ -0,0 +1,427 @@
+/***************************************************/
+/*! \class LibraryScanner
+    \brief Index of the formats of a library of audio files.
+
+    Files are added one by one or by directory, and
+    scan() finds the channels, sample rate, length and
+    data format of each with WvIn::openInfo(), which
+    reads only the file's header.  The headers are
+    read on a thread per processor.  The index can be
+    saved to a compact file and loaded again, after
+    which only files whose size or modification time
+    have changed are read, so a library of thousands
+    of files can be browsed without opening any.
+
+    Index files are in the host byte order; one
+    written on a host of the other order is ignored.
+*/
+/***************************************************/
+
+#include "LibraryScanner.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/stat.h>
+
+#if defined(__OS_WINDOWS__)
+  #include <windows.h>
+  #include <process.h>
+  #define getpid _getpid
+#else
+  #include <unistd.h>
+  #include <dirent.h>
+#endif
+
+#define LIBRARY_VERSION 1
+#define LIBRARY_ORDER 0x01020304
+#define LIBRARY_UNREAD ((UINT64) -1)   // fileBytes of an entry not read yet
+
+// Fixed part of an index file, followed by its entries, each a
+// LibraryRecord and then the file name, without a terminating zero.
+struct LibraryHeader {
+  char magic[4];                // "LIBR"
+  UINT32 order;                 // LIBRARY_ORDER in the writer's byte order
+  UINT32 version;
+  UINT32 reserved;
+  UINT64 count;
+};
+
+struct LibraryRecord {
+  UINT64 fileBytes;
+  UINT64 modified;
+  UINT64 frames;
+  FLOAT64 fileRate;
+  UINT32 channels;
+  UINT32 format;
+  UINT32 nameLength;
+  UINT32 reserved;
+};
+
+static const char *audioExtensions[] = {
+  ".wav", ".aif", ".aiff", ".aifc", ".snd", ".au", ".flac", ".mat", 0
+};
+
+static bool isAudioFile( const char *name )
+{
+  const char *dot = strrchr( name, '.' );
+  if ( !dot ) return false;
+  for (unsigned int i=0; audioExtensions[i]; i++) {
+    const char *a = dot, *b = audioExtensions[i];
+    while ( *a && *b && tolower( *a ) == *b ) { a++; b++; }
+    if ( *a == 0 && *b == 0 ) return true;
+  }
+  return false;
+}
+
+static int compareEntries( const void *a, const void *b )
+{
+  return strcmp( ((const LibraryEntry *) a)->fileName, ((const LibraryEntry *) b)->fileName );
+}
+
+static unsigned int processorCount( void )
+{
+#if defined(__OS_WINDOWS__)
+  SYSTEM_INFO info;
+  GetSystemInfo( &info );
+  return (unsigned int) info.dwNumberOfProcessors;
+#else
+  long n = sysconf( _SC_NPROCESSORS_ONLN );
+  return ( n > 0 ) ? (unsigned int) n : 1;
+#endif
+}
+
+LibraryScanner :: LibraryScanner()
+  : entries(0), count(0), size(0), sorted(true), gone(0), next(0), probed(0), active(0)
+{
+}
+
+LibraryScanner :: ~LibraryScanner()
+{
+  clear();
+}
+
+void LibraryScanner :: clear( void )
+{
+  for (unsigned long i=0; i<count; i++)
+    delete [] entries[i].fileName;
+  delete [] entries;
+  entries = 0;
+  count = 0;
+  size = 0;
+  sorted = true;
+}
+
+LibraryEntry *LibraryScanner :: append( const char *fileName )
+{
+  if ( count == size ) {
+    unsigned long newSize = ( size > 0 ) ? 2 * size : 256;
+    LibraryEntry *newEntries = new LibraryEntry[newSize];
+    if ( count > 0 ) memcpy( newEntries, entries, count * sizeof(LibraryEntry) );
+    delete [] entries;
+    entries = newEntries;
+    size = newSize;
+  }
+
+  LibraryEntry *entry = &entries[count++];
+  entry->fileName = new char[strlen(fileName) + 1];
+  strcpy( entry->fileName, fileName );
+  entry->fileBytes = LIBRARY_UNREAD;
+  entry->modified = 0;
+  entry->frames = 0;
+  entry->fileRate = 0.0;
+  entry->channels = 0;
+  entry->format = 0;
+  sorted = false;
+  return entry;
+}
+
+void LibraryScanner :: addFile( const char *fileName )
+{
+  // Repeats are dropped by sort(), so that adding a directory of
+  // thousands of files doesn't search the library for each.
+  append( fileName );
+}
+
+unsigned long LibraryScanner :: addDirectory( const char *dirName )
+{
+  char name[1024];
+  unsigned long added = 0;
+
+#if defined(__OS_WINDOWS__)
+  WIN32_FIND_DATAA found;
+  sprintf( name, "%.1000s/*", dirName );
+  HANDLE handle = FindFirstFileA( name, &found );
+  if ( handle == INVALID_HANDLE_VALUE ) {
+    sprintf(msg, "LibraryScanner: Could not read directory (%.200s).", dirName);
+    handleError(msg, StkError::FILE_NOT_FOUND);
+  }
+  do {
+    const char *leaf = found.cFileName;
+    if ( leaf[0] == '.' ) continue;
+    // (a name too long to hold is skipped)
+    if ( snprintf( name, sizeof(name), "%s/%s", dirName, leaf ) >= (int) sizeof(name) ) continue;
+    if ( found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) {
+      try {
+        added += addDirectory( name );
+      }
+      catch ( StkError & ) {
+      }
+    }
+    else if ( isAudioFile( leaf ) ) {
+      append( name );
+      added++;
+    }
+  } while ( FindNextFileA( handle, &found ) );
+  FindClose( handle );
+#else
+  DIR *dir = opendir( dirName );
+  if ( !dir ) {
+    sprintf(msg, "LibraryScanner: Could not read directory (%.200s).", dirName);
+    handleError(msg, StkError::FILE_NOT_FOUND);
+  }
+  struct dirent *found;
+  while ( (found = readdir( dir )) != 0 ) {
+    const char *leaf = found->d_name;
+    if ( leaf[0] == '.' ) continue;
+    // (a name too long to hold is skipped)
+    if ( snprintf( name, sizeof(name), "%s/%s", dirName, leaf ) >= (int) sizeof(name) ) continue;
+    struct stat filestat;
+    if ( stat( name, &filestat ) == -1 ) continue;
+    if ( S_ISDIR( filestat.st_mode ) ) {
+      // A subdirectory which can't be read is skipped rather than
+      // ending the whole scan.
+      try {
+        added += addDirectory( name );
+      }
+      catch ( StkError & ) {
+      }
+    }
+    else if ( isAudioFile( leaf ) ) {
+      append( name );
+      added++;
+    }
+  }
+  closedir( dir );
+#endif
+
+  return added;
+}
+
+void LibraryScanner :: sort( void )
+{
+  if ( sorted ) return;
+  qsort( entries, count, sizeof(LibraryEntry), compareEntries );
+
+  // Of repeated names, keep an entry which has been read, if any.
+  unsigned long kept = 0;
+  for (unsigned long i=0; i<count; i++) {
+    if ( kept > 0 && !strcmp( entries[kept-1].fileName, entries[i].fileName ) ) {
+      if ( entries[kept-1].fileBytes == LIBRARY_UNREAD ) {
+        delete [] entries[kept-1].fileName;
+        entries[kept-1] = entries[i];
+      }
+      else delete [] entries[i].fileName;
+      continue;
+    }
+    entries[kept++] = entries[i];
+  }
+  count = kept;
+  sorted = true;
+}
+
+unsigned long LibraryScanner :: scan( unsigned int nThreads )
+{
+  sort();
+  if ( count == 0 ) return 0;
+
+  if ( nThreads == 0 ) nThreads = processorCount();
+  if ( nThreads > LIBRARY_THREADS ) nThreads = LIBRARY_THREADS;
+  if ( nThreads > count ) nThreads = (unsigned int) count;
+
+  gone = new bool[count];
+  memset( gone, 0, count * sizeof(bool) );
+  next = 0;
+  probed = 0;
+
+  Thread threads[LIBRARY_THREADS];
+  unsigned int i, started = 0;
+  for (i=0; i<nThreads; i++) {
+    active++;
+    if ( !threads[i].start( &workerThread, this ) ) {
+      active--;
+      break;
+    }
+    started++;
+  }
+
+  // Do without threads rather than not at all.
+  if ( started == 0 ) {
+    active++;
+    workerThread( this );
+  }
+
+  // Let each thread return before it is joined.
+  while ( active > 0 ) Stk::sleep( LIBRARY_POLL );
+  for (i=0; i<started; i++)
+    threads[i].wait();
+
+  unsigned long kept = 0;
+  for (unsigned long j=0; j<count; j++) {
+    if ( gone[j] ) delete [] entries[j].fileName;
+    else entries[kept++] = entries[j];
+  }
+  count = kept;
+  delete [] gone;
+  gone = 0;
+
+  return probed;
+}
+
+int LibraryScanner :: probe( LibraryEntry *entry, WvIn *input )
+{
+  struct stat filestat;
+  if ( stat( entry->fileName, &filestat ) == -1 ) return -1;
+  if ( entry->fileBytes == (UINT64) filestat.st_size &&
+       entry->modified == (UINT64) filestat.st_mtime )
+    return 0;
+
+  entry->fileBytes = (UINT64) filestat.st_size;
+  entry->modified = (UINT64) filestat.st_mtime;
+  try {
+    input->openInfo( entry->fileName );
+    entry->frames = input->getSize();
+    entry->fileRate = input->getFileRate();
+    entry->channels = input->getChannels();
+    entry->format = (UINT32) input->getDataType();
+  }
+  catch ( StkError & ) {
+    // The error has been reported by handleError().
+    entry->frames = 0;
+    entry->fileRate = 0.0;
+    entry->channels = 0;
+    entry->format = 0;
+  }
+  return 1;
+}
+
+THREAD_RETURN THREAD_TYPE LibraryScanner :: workerThread( void *ptr )
+{
+  LibraryScanner *scanner = (LibraryScanner *) ptr;
+  WvIn input;
+
+  unsigned long i;
+  while ( (i = scanner->next++) < scanner->count ) {
+    int result = probe( &scanner->entries[i], &input );
+    if ( result < 0 ) scanner->gone[i] = true;
+    else if ( result > 0 ) scanner->probed++;
+  }
+
+  scanner->active--;
+  return 0;
+}
+
+bool LibraryScanner :: load( const char *indexName )
+{
+  clear();
+  FILE *fd = fopen( indexName, "rb" );
+  if ( !fd ) return false;
+
+  LibraryHeader header;
+  bool ok = fread( &header, sizeof(header), 1, fd ) == 1 &&
+    !strncmp( header.magic, "LIBR", 4 ) && header.order == LIBRARY_ORDER &&
+    header.version == LIBRARY_VERSION;
+
+  LibraryRecord record;
+  char name[1024];
+  for (UINT64 i=0; ok && i<header.count; i++) {
+    if ( fread( &record, sizeof(record), 1, fd ) != 1 ||
+         record.nameLength == 0 || record.nameLength >= sizeof(name) ||
+         fread( name, 1, record.nameLength, fd ) != record.nameLength ) {
+      ok = false;
+      break;
+    }
+    name[record.nameLength] = 0;
+    LibraryEntry *entry = append( name );
+    entry->fileBytes = record.fileBytes;
+    entry->modified = record.modified;
+    entry->frames = record.frames;
+    entry->fileRate = record.fileRate;
+    entry->channels = record.channels;
+    entry->format = record.format;
+  }
+
+  fclose( fd );
+  if ( !ok ) {
+    clear();
+    return false;
+  }
+
+  // The index is saved sorted, but a hand-made one might not be.
+  sort();
+  return true;
+}
+
+bool LibraryScanner :: save( const char *indexName ) const
+{
+  char tempName[1040];
+  if ( strlen( indexName ) > 1024 ) return false;
+
+  LibraryHeader header;
+  memcpy( header.magic, "LIBR", 4 );
+  header.order = LIBRARY_ORDER;
+  header.version = LIBRARY_VERSION;
+  header.reserved = 0;
+  header.count = count;
+
+  // Write a temporary file and rename it, as PeakCache does.
+  sprintf( tempName, "%s.%lu", indexName, (unsigned long) getpid() );
+  FILE *fd = fopen( tempName, "wb" );
+  if ( !fd ) return false;
+  bool ok = fwrite( &header, sizeof(header), 1, fd ) == 1;
+
+  LibraryRecord record;
+  for (unsigned long i=0; ok && i<count; i++) {
+    const LibraryEntry *entry = &entries[i];
+    record.fileBytes = entry->fileBytes;
+    record.modified = entry->modified;
+    record.frames = entry->frames;
+    record.fileRate = entry->fileRate;
+    record.channels = entry->channels;
+    record.format = entry->format;
+    record.nameLength = (UINT32) strlen( entry->fileName );
+    record.reserved = 0;
+    ok = fwrite( &record, sizeof(record), 1, fd ) == 1 &&
+      fwrite( entry->fileName, 1, record.nameLength, fd ) == record.nameLength;
+  }
+
+  if ( fclose( fd ) != 0 ) ok = false;
+  if ( ok && rename( tempName, indexName ) == 0 ) return true;
+
+  remove( tempName );
+  return false;
+}
+
+unsigned long LibraryScanner :: getCount( void ) const
+{
+  return count;
+}
+
+const LibraryEntry *LibraryScanner :: getEntry( unsigned long index ) const
+{
+  if ( index >= count ) return 0;
+  return &entries[index];
+}
+
+const LibraryEntry *LibraryScanner :: find( const char *fileName ) const
+{
+  if ( sorted ) {
+    LibraryEntry key;
+    key.fileName = (char *) fileName;
+    return (const LibraryEntry *) bsearch( &key, entries, count, sizeof(LibraryEntry), compareEntries );
+  }
+
+  for (unsigned long i=0; i<count; i++)
+    if ( !strcmp( entries[i].fileName, fileName ) ) return &entries[i];
+  return 0;
+}
@@ -0,0 +1,121 @@
+/***************************************************/
+/*! \class LibraryScanner
+    \brief Index of the formats of a library of audio files.
+
+    Files are added one by one or by directory, and
+    scan() finds the channels, sample rate, length and
+    data format of each with WvIn::openInfo(), which
+    reads only the file's header.  The headers are
+    read on a thread per processor.  The index can be
+    saved to a compact file and loaded again, after
+    which only files whose size or modification time
+    have changed are read, so a library of thousands
+    of files can be browsed without opening any.
+
+    Index files are in the host byte order; one
+    written on a host of the other order is ignored.
+*/
+/***************************************************/
+
+#if !defined(__LIBRARYSCANNER_H)
+#define __LIBRARYSCANNER_H
+
+#define LIBRARY_THREADS 32        // worker threads, at most
+#define LIBRARY_POLL 2            // milliseconds
+
+#include "Stk.h"
+#include "WvIn.h"
+#include "Thread.h"
+#include <atomic>
+
+//! What a LibraryScanner knows of one audio file.
+struct LibraryEntry {
+  char *fileName;
+  UINT64 fileBytes;               // size of the file
+  UINT64 modified;                // its modification time, in seconds
+  UINT64 frames;
+  FLOAT64 fileRate;
+  UINT32 channels;                // 0 if the file could not be read
+  UINT32 format;                  // one of the Stk::STK_FORMAT values
+};
+
+class LibraryScanner : public Stk
+{
+public:
+  //! Default constructor, for an empty library.
+  LibraryScanner();
+
+  //! Class destructor.
+  ~LibraryScanner();
+
+  //! Add the audio file \e fileName to the library, if it isn't in it already.
+  void addFile( const char *fileName );
+
+  //! Add the audio files in directory \e dirName and those below it, and return how many there were.
+  /*!
+    Files are recognised by their extensions: .wav, .aif, .aiff,
+    .aifc, .snd, .au, .flac and .mat.  Names starting with a dot are
+    skipped.  An StkError will be thrown if the directory can't be
+    read.
+  */
+  unsigned long addDirectory( const char *dirName );
+
+  //! Read the header of every file which is new or has changed, and return how many were read.
+  /*!
+    The headers are read by \e nThreads threads, or one per
+    processor if \e nThreads is 0, and at most LIBRARY_THREADS.
+    Files which no longer exist are dropped from the library.  Files
+    which can't be read are kept, with no channels, so that they
+    aren't read again until they change.
+  */
+  unsigned long scan( unsigned int nThreads = 0 );
+
+  //! Replace the library with the one in the index file \e indexName.
+  /*!
+    Returns FALSE, leaving the library empty, if the file can't be
+    read or isn't an index.  The entries are as they were when the
+    index was saved; scan() brings them up to date.
+  */
+  bool load( const char *indexName );
+
+  //! Save the library to the index file \e indexName.  Returns FALSE if it could not be written.
+  bool save( const char *indexName ) const;
+
+  //! Return the number of files in the library.
+  unsigned long getCount( void ) const;
+
+  //! Return entry \e index, in order of file name after a scan() or load(), or NULL if out of range.
+  const LibraryEntry *getEntry( unsigned long index ) const;
+
+  //! Return the entry of \e fileName, as it was added, or NULL if it isn't in the library.
+  const LibraryEntry *find( const char *fileName ) const;
+
+protected:
+
+  // Add an entry for \e fileName, copying the name, and return it.
+  LibraryEntry *append( const char *fileName );
+
+  // Sort the entries by file name and drop repeated ones.
+  void sort( void );
+
+  // Free the entries.
+  void clear( void );
+
+  // Read the header of \e entry into \e input unless its file is
+  // unchanged.  Return 1 if it was read, 0 if not, or -1 if the file is gone.
+  static int probe( LibraryEntry *entry, WvIn *input );
+
+  static THREAD_RETURN THREAD_TYPE workerThread( void *ptr );
+
+  LibraryEntry *entries;
+  unsigned long count;
+  unsigned long size;             // entries allocated
+  bool sorted;
+  bool *gone;                     // entries whose files no longer exist, during a scan()
+  std::atomic<unsigned long> next;        // next entry for a worker
+  std::atomic<unsigned long> probed;
+  std::atomic<unsigned int> active;
+  char msg[256];
+};
+
+#endif // defined(__LIBRARYSCANNER_H)
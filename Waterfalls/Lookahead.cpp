@@ -0,0 +1,220 @@
+/***************************************************/
+/*! \class Lookahead
+    \brief Spectra of stems, ready before they are heard.
+
+    The audio thread marks each buffer with mark()
+    before it ticks the stems.  A thread of this
+    class then reads the same frames of each stem
+    through its cursor (see SetlistSong), ahead of
+    the output, and transforms them.  The spectra
+    are tagged with the stream frame the buffer is
+    played from, and getSpectrum() returns those of
+    the buffer holding a given frame.  A buffer is
+    heard the output latency after it is played, so
+    getHeardFrame() returns the frame reaching the
+    speakers as the latency behind the last mark,
+    estimated between buffers from its time.
+
+    Spectra are made with make_window() and rfft(),
+    as Waterfall does, and kept for the last
+    LOOKAHEAD_FRAMES buffers.  mark() doesn't lock or
+    allocate.  getSpectrum() and getHeardFrame()
+    can be called from any one other thread.
+*/
+/***************************************************/
+
+#include "Lookahead.h"
+#include "chuck_fft.h"
+#include <math.h>
+#include <string.h>
+#include <chrono>
+
+// Seconds on a clock which only goes forward.
+static double clockNow( void )
+{
+  return std::chrono::duration<double>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+Lookahead :: Lookahead( Setlist *setlist, unsigned int nStems, unsigned int size, unsigned int fftSize )
+  : setlist(setlist), marksIn(0), marksOut(0), framesIn(0), latency(0), running(false), stopped(true)
+{
+  if ( nStems > SETLIST_STEMS ) nStems = SETLIST_STEMS;
+  if ( size > fftSize ) size = fftSize;
+  this->nStems = nStems;
+  this->size = size;
+  this->fftSize = fftSize;
+
+  window = new float[size];
+  make_window( window, size );
+  samples = new MY_FLOAT[size];
+  for (unsigned int i=0; i<LOOKAHEAD_FRAMES; i++) {
+    frames[i].frame = 0.0;
+    frames[i].frames = 0;
+    frames[i].spectra = new float[nStems * fftSize];
+  }
+
+  running = true;
+  stopped = false;
+  if ( !thread.start( &analysisThread, this ) ) {
+    running = false;
+    stopped = true;
+    sprintf(msg, "Lookahead: Unable to start the analysis thread.");
+    handleError(msg, StkError::PROCESS_THREAD);
+  }
+}
+
+Lookahead :: ~Lookahead()
+{
+  if ( !stopped ) {
+    // Let the thread finish the buffer it is on rather than cancelling it.
+    running = false;
+    while ( !stopped ) Stk::sleep( LOOKAHEAD_POLL );
+    thread.wait();
+  }
+
+  delete [] window;
+  delete [] samples;
+  for (unsigned int i=0; i<LOOKAHEAD_FRAMES; i++)
+    delete [] frames[i].spectra;
+}
+
+void Lookahead :: setLatency( long frames )
+{
+  latency = frames;
+}
+
+void Lookahead :: mark( double frame, unsigned int frames )
+{
+  unsigned long in = marksIn;
+  Mark &m = marks[in % LOOKAHEAD_MARKS];
+  SetlistSong *song = setlist->getSong();
+  m.frame = frame;
+  m.clock = clockNow();
+  m.frames = frames;
+  m.song = song;
+  m.index = song->index;
+  m.swaps = setlist->getSwaps();
+  for (unsigned int i=0; i<nStems; i++) {
+    m.cursors[i] = song->cursors[i];
+    m.time[i] = song->stems[i]->getTime();
+    m.gain[i] = song->gain[i];
+  }
+  marksIn = in + 1;
+}
+
+bool Lookahead :: readMark( unsigned long index, Mark *mark ) const
+{
+  *mark = marks[index % LOOKAHEAD_MARKS];
+  // The audio thread writes mark marksIn next, which is in the same
+  // place as this one once they are LOOKAHEAD_MARKS apart.
+  return marksIn - index < LOOKAHEAD_MARKS;
+}
+
+double Lookahead :: getHeardFrame( void ) const
+{
+  unsigned long in = marksIn;
+  Mark mark;
+  if ( in == 0 || !readMark( in - 1, &mark ) ) return -1.0;
+
+  // The stream moves on from the last mark until the next, which comes
+  // a buffer later unless the stream has stopped.
+  double played = ( clockNow() - mark.clock ) * Stk::sampleRate();
+  if ( played > mark.frames ) played = mark.frames;
+  return mark.frame + played - latency;
+}
+
+bool Lookahead :: getSpectrum( unsigned int stem, double frame, float *buffer, bool *silent ) const
+{
+  if ( stem >= nStems ) return false;
+
+  // A heard frame is usually in one of the last few buffers analysed,
+  // the output latency behind the newest.
+  unsigned long in = framesIn;
+  for (unsigned long n=in; n>0 && in-n<LOOKAHEAD_FRAMES-1; n--) {
+    const Frame &f = frames[(n-1) % LOOKAHEAD_FRAMES];
+    double start = f.frame;
+    unsigned int length = f.frames;
+    if ( start > frame ) continue;
+    if ( frame >= start + length ) return false;
+
+    memcpy( buffer, f.spectra + stem * fftSize, fftSize * sizeof(float) );
+    *silent = f.silent[stem];
+    // The analysis thread writes frame framesIn next, which is in the
+    // same place as this one once they are LOOKAHEAD_FRAMES apart.
+    return framesIn - (n-1) < LOOKAHEAD_FRAMES;
+  }
+  return false;
+}
+
+void Lookahead :: analyse( const Mark &mark )
+{
+  // A song or stem which has gone since the mark might have been
+  // closed, so its cursors are only read if nothing has changed.
+  SetlistSong *song = setlist->hold();
+  if ( song != mark.song || song->index != mark.index || setlist->getSwaps() != mark.swaps ) {
+    setlist->release();
+    return;
+  }
+
+  unsigned long n = framesIn;
+  Frame &f = frames[n % LOOKAHEAD_FRAMES];
+  for (unsigned int i=0; i<nStems; i++) {
+    float *x = f.spectra + i * fftSize;
+    memset( x, 0, fftSize * sizeof(float) );
+    f.silent[i] = true;
+
+    WvIn *cursor = mark.cursors[i];
+    try {
+      cursor->seek( mark.time[i] );
+      cursor->tick( samples, size );
+    }
+    catch ( StkError & ) {
+      // The error has been reported by handleError().
+      continue;
+    }
+
+    MY_FLOAT gain = mark.gain[i];
+    float peak = 0.0;
+    for (unsigned int j=0; j<size; j++) {
+      x[j] = (float) (samples[j] * gain);
+      if ( fabs( x[j] ) > peak ) peak = (float) fabs( x[j] );
+    }
+    if ( peak <= LOOKAHEAD_SILENCE ) {
+      memset( x, 0, size * sizeof(float) );
+      continue;
+    }
+
+    apply_window( x, window, size );
+    rfft( x, fftSize/2, FFT_FORWARD );
+    f.silent[i] = false;
+  }
+  setlist->release();
+
+  f.frame = mark.frame;
+  f.frames = mark.frames;
+  framesIn = n + 1;
+}
+
+THREAD_RETURN THREAD_TYPE Lookahead :: analysisThread( void *ptr )
+{
+  Lookahead *lookahead = (Lookahead *) ptr;
+  Mark mark;
+
+  while ( lookahead->running ) {
+    unsigned long in = lookahead->marksIn;
+    unsigned long out = lookahead->marksOut;
+    if ( out == in ) {
+      Stk::sleep( LOOKAHEAD_POLL );
+      continue;
+    }
+
+    // Fallen behind: what is still waiting will be heard soon, if it
+    // hasn't been already, so go on to the newest.
+    if ( in - out > LOOKAHEAD_MARKS / 2 ) out = in - 1;
+    lookahead->marksOut = out + 1;
+    if ( lookahead->readMark( out, &mark ) ) lookahead->analyse( mark );
+  }
+
+  lookahead->stopped = true;
+  return 0;
+}
@@ -0,0 +1,126 @@
+/***************************************************/
+/*! \class Lookahead
+    \brief Spectra of stems, ready before they are heard.
+
+    The audio thread marks each buffer with mark()
+    before it ticks the stems.  A thread of this
+    class then reads the same frames of each stem
+    through its cursor (see SetlistSong), ahead of
+    the output, and transforms them.  The spectra
+    are tagged with the stream frame the buffer is
+    played from, and getSpectrum() returns those of
+    the buffer holding a given frame.  A buffer is
+    heard the output latency after it is played, so
+    getHeardFrame() returns the frame reaching the
+    speakers as the latency behind the last mark,
+    estimated between buffers from its time.
+
+    Spectra are made with make_window() and rfft(),
+    as Waterfall does, and kept for the last
+    LOOKAHEAD_FRAMES buffers.  mark() doesn't lock or
+    allocate.  getSpectrum() and getHeardFrame()
+    can be called from any one other thread.
+*/
+/***************************************************/
+
+#if !defined(__LOOKAHEAD_H)
+#define __LOOKAHEAD_H
+
+#define LOOKAHEAD_MARKS 64          // buffers waiting to be analysed, at most (a power of 2)
+#define LOOKAHEAD_FRAMES 64         // buffers of spectra kept (a power of 2)
+#define LOOKAHEAD_SILENCE 0.0003    // peaks below this are drawn flat, without a transform (-70 dB)
+#define LOOKAHEAD_POLL 1            // milliseconds
+
+#include "Stk.h"
+#include "WvIn.h"
+#include "Setlist.h"
+#include "Thread.h"
+#include <atomic>
+
+class Lookahead : public Stk
+{
+public:
+  //! Class constructor, for \e nStems stems of \e setlist, in buffers of \e size frames transformed to \e fftSize values.
+  /*!
+    \e size must be at most \e fftSize, a power of 2; the rest of
+    the transform is zero padding.  The analysis thread is started
+    here.  An StkError will be thrown if it cannot be.
+  */
+  Lookahead( Setlist *setlist, unsigned int nStems, unsigned int size, unsigned int fftSize );
+
+  //! Class destructor, which stops the analysis thread.
+  ~Lookahead();
+
+  //! Set the frames between a buffer being played and being heard.
+  void setLatency( long frames );
+
+  //! Mark the buffer of \e frames frames about to be played from stream frame \e frame.
+  /*!
+    Called by the audio thread after Setlist::update() and anything
+    else which moves the stems, and before they are ticked.  The
+    stems' positions and gains are taken from the song playing.
+    When more than LOOKAHEAD_MARKS buffers are waiting, the oldest
+    are not analysed.
+  */
+  void mark( double frame, unsigned int frames );
+
+  //! Return the stream frame reaching the speakers now, or a negative value before the first mark.
+  double getHeardFrame( void ) const;
+
+  //! Copy the transform of stem \e stem at stream frame \e frame into \e buffer, of \e fftSize values.
+  /*!
+    The transform is that of the buffer which holds stream frame
+    \e frame, such as getHeardFrame().  \e silent is set to TRUE,
+    and \e buffer is zeroed, if the buffer is silent.  Returns FALSE
+    if that buffer hasn't been analysed, or is no longer kept.
+  */
+  bool getSpectrum( unsigned int stem, double frame, float *buffer, bool *silent ) const;
+
+protected:
+
+  struct Mark {
+    double frame;                         // stream frame the buffer starts at
+    double clock;                         // seconds, when it was marked
+    unsigned int frames;
+    SetlistSong *song;                    // not read unless it is still playing
+    unsigned int index;
+    unsigned long swaps;                  // the setlist's, which changes when a cursor goes
+    WvIn *cursors[SETLIST_STEMS];
+    double time[SETLIST_STEMS];
+    MY_FLOAT gain[SETLIST_STEMS];
+  };
+
+  struct Frame {
+    double frame;                         // stream frame the buffer starts at
+    unsigned int frames;
+    float *spectra;                       // nStems transforms of fftSize values
+    bool silent[SETLIST_STEMS];
+  };
+
+  // Copy mark number \e index to \e mark.  Returns FALSE if it was overwritten meanwhile.
+  bool readMark( unsigned long index, Mark *mark ) const;
+
+  // Transform the stems of the buffer \e mark if its song is still playing, with the same cursors.
+  void analyse( const Mark &mark );
+
+  static THREAD_RETURN THREAD_TYPE analysisThread( void *ptr );
+
+  Setlist *setlist;
+  unsigned int nStems;
+  unsigned int size;
+  unsigned int fftSize;
+  float *window;
+  MY_FLOAT *samples;
+  Mark marks[LOOKAHEAD_MARKS];
+  std::atomic<unsigned long> marksIn;       // written by the audio thread
+  unsigned long marksOut;                   // next to analyse
+  Frame frames[LOOKAHEAD_FRAMES];
+  std::atomic<unsigned long> framesIn;      // written by the analysis thread
+  std::atomic<long> latency;
+  Thread thread;
+  std::atomic<bool> running;
+  std::atomic<bool> stopped;
+  char msg[256];
+};
+
+#endif // defined(__LOOKAHEAD_H)
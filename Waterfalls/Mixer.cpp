@@ -0,0 +1,283 @@
+/***************************************************/
+/*! \class Mixer
+    \brief Mixes N inputs into M output channels.
+
+    Each input reaches each output channel with the
+    gain set for that pair in an N by M matrix, so a
+    mono stem can be panned or sent to any channels.
+    Inputs can be soloed and muted: when any input is
+    soloed, only soloed inputs are heard, and muted
+    inputs never are.
+
+    The gains, solos and mutes are set by the audio
+    thread between blocks (see ControlQueue), and the
+    gains ramp from their old values to the new over
+    the next block.  isHeard() can be called from
+    any other thread.  tick() mixes a block at a
+    time with the same branch-free loop for every
+    input and channel; on x86 processors, SSE2 or
+    AVX2 versions are chosen at runtime, as in
+    SampleConvert.  It doesn't lock or allocate.
+*/
+/***************************************************/
+
+#include "Mixer.h"
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && defined(__SSE2__)
+  #define __MIXER_X86__
+  #include <immintrin.h>
+  #define AVX2 __attribute__((target("avx2")))
+#endif
+
+// Add n samples of in to bus, with a gain of g ramping by dg a sample.
+typedef void (*MIX_KERNEL)( const MY_FLOAT *in, MY_FLOAT *bus, unsigned long n, MY_FLOAT g, MY_FLOAT dg );
+// Interleave n samples of each of channels buses, stride apart, into out.
+typedef void (*INTERLEAVE_KERNEL)( const MY_FLOAT *buses, unsigned long stride, unsigned int channels,
+                                   FLOAT64 *out, unsigned long n );
+
+struct MixKernels {
+  const char *name;
+  MIX_KERNEL mix;
+  INTERLEAVE_KERNEL interleave;
+};
+
+// Plain loops, also used for the samples left over by the vector loops.
+// The gain of each sample is worked out afresh, not accumulated, so that
+// every version gives the same results.
+
+static void mixScalar( const MY_FLOAT *in, MY_FLOAT *bus, unsigned long n, MY_FLOAT g, MY_FLOAT dg )
+{
+  for (unsigned long i=0; i<n; i++)
+    bus[i] += in[i] * (g + (MY_FLOAT) i * dg);
+}
+
+static void interleaveScalar( const MY_FLOAT *buses, unsigned long stride, unsigned int channels,
+                              FLOAT64 *out, unsigned long n )
+{
+  for (unsigned int c=0; c<channels; c++) {
+    const MY_FLOAT *bus = buses + c * stride;
+    for (unsigned long i=0; i<n; i++)
+      out[i*channels+c] = (FLOAT64) bus[i];
+  }
+}
+
+static const MixKernels scalarKernels = {
+  "scalar", mixScalar, interleaveScalar
+};
+
+#if defined(__MIXER_X86__)
+
+static void mixSse2( const MY_FLOAT *in, MY_FLOAT *bus, unsigned long n, MY_FLOAT g, MY_FLOAT dg )
+{
+  __m128 gain = _mm_set1_ps( g );
+  __m128 step = _mm_set1_ps( dg );
+  __m128 index = _mm_setr_ps( 0.0f, 1.0f, 2.0f, 3.0f );
+  __m128 four = _mm_set1_ps( 4.0f );
+  unsigned long i;
+  for (i=0; i+4<=n; i+=4) {
+    __m128 x = _mm_mul_ps( _mm_loadu_ps(in+i), _mm_add_ps(gain, _mm_mul_ps(index, step)) );
+    _mm_storeu_ps( bus+i, _mm_add_ps(_mm_loadu_ps(bus+i), x) );
+    index = _mm_add_ps( index, four );
+  }
+  for (; i<n; i++)
+    bus[i] += in[i] * (g + (MY_FLOAT) i * dg);
+}
+
+// Stereo, the usual case, is interleaved in registers.
+static void interleaveSse2( const MY_FLOAT *buses, unsigned long stride, unsigned int channels,
+                            FLOAT64 *out, unsigned long n )
+{
+  if ( channels != 2 ) {
+    interleaveScalar( buses, stride, channels, out, n );
+    return;
+  }
+
+  const MY_FLOAT *left = buses;
+  const MY_FLOAT *right = buses + stride;
+  unsigned long i;
+  for (i=0; i+4<=n; i+=4) {
+    __m128 l = _mm_loadu_ps( left+i );
+    __m128 r = _mm_loadu_ps( right+i );
+    __m128 lo = _mm_unpacklo_ps( l, r );
+    __m128 hi = _mm_unpackhi_ps( l, r );
+    _mm_storeu_pd( out+2*i, _mm_cvtps_pd(lo) );
+    _mm_storeu_pd( out+2*i+2, _mm_cvtps_pd(_mm_movehl_ps(lo, lo)) );
+    _mm_storeu_pd( out+2*i+4, _mm_cvtps_pd(hi) );
+    _mm_storeu_pd( out+2*i+6, _mm_cvtps_pd(_mm_movehl_ps(hi, hi)) );
+  }
+  for (; i<n; i++) {
+    out[2*i] = (FLOAT64) left[i];
+    out[2*i+1] = (FLOAT64) right[i];
+  }
+}
+
+static const MixKernels sse2Kernels = {
+  "sse2", mixSse2, interleaveSse2
+};
+
+AVX2 static void mixAvx2( const MY_FLOAT *in, MY_FLOAT *bus, unsigned long n, MY_FLOAT g, MY_FLOAT dg )
+{
+  __m256 gain = _mm256_set1_ps( g );
+  __m256 step = _mm256_set1_ps( dg );
+  __m256 index = _mm256_setr_ps( 0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f );
+  __m256 eight = _mm256_set1_ps( 8.0f );
+  unsigned long i;
+  for (i=0; i+8<=n; i+=8) {
+    __m256 x = _mm256_mul_ps( _mm256_loadu_ps(in+i), _mm256_add_ps(gain, _mm256_mul_ps(index, step)) );
+    _mm256_storeu_ps( bus+i, _mm256_add_ps(_mm256_loadu_ps(bus+i), x) );
+    index = _mm256_add_ps( index, eight );
+  }
+  for (; i<n; i++)
+    bus[i] += in[i] * (g + (MY_FLOAT) i * dg);
+}
+
+static const MixKernels avx2Kernels = {
+  "avx2", mixAvx2, interleaveSse2
+};
+
+#endif // defined(__MIXER_X86__)
+
+static const MixKernels *chooseKernels( void )
+{
+#if defined(__MIXER_X86__)
+  __builtin_cpu_init();
+  if ( __builtin_cpu_supports("avx2") ) return &avx2Kernels;
+  return &sse2Kernels;
+#else
+  return &scalarKernels;
+#endif
+}
+
+Mixer :: Mixer( unsigned int nInputs, unsigned int nOutputs, unsigned int bufferFrames )
+  : changed(false)
+{
+  if ( nInputs == 0 || nOutputs == 0 || bufferFrames == 0 ) {
+    sprintf(msg, "Mixer: Can't mix %d inputs into %d channels.", nInputs, nOutputs);
+    handleError(msg, StkError::FUNCTION_ARGUMENT);
+  }
+
+  this->nInputs = nInputs;
+  this->nOutputs = nOutputs;
+  this->bufferFrames = bufferFrames;
+  unsigned int n = nInputs * nOutputs;
+  gains = new MY_FLOAT[n];
+  current = new MY_FLOAT[n];
+  target = new MY_FLOAT[n];
+  for (unsigned int i=0; i<n; i++) {
+    gains[i] = 1.0;
+    current[i] = target[i] = 1.0;
+  }
+  solo = new std::atomic<bool>[nInputs];
+  mute = new std::atomic<bool>[nInputs];
+  for (unsigned int i=0; i<nInputs; i++) {
+    solo[i] = false;
+    mute[i] = false;
+  }
+  buses = new MY_FLOAT[nOutputs * bufferFrames];
+  kernels = chooseKernels();
+}
+
+Mixer :: ~Mixer()
+{
+  delete [] gains;
+  delete [] current;
+  delete [] target;
+  delete [] solo;
+  delete [] mute;
+  delete [] buses;
+}
+
+void Mixer :: setGain( unsigned int input, unsigned int output, MY_FLOAT gain )
+{
+  if ( input >= nInputs || output >= nOutputs ) {
+    sprintf(msg, "Mixer: There is no input %d or output %d.", input, output);
+    handleError(msg, StkError::FUNCTION_ARGUMENT);
+  }
+
+  gains[input * nOutputs + output] = gain;
+  changed = true;
+}
+
+MY_FLOAT Mixer :: getGain( unsigned int input, unsigned int output ) const
+{
+  if ( input >= nInputs || output >= nOutputs ) return 0.0;
+  return gains[input * nOutputs + output];
+}
+
+void Mixer :: setSolo( unsigned int input, bool solo )
+{
+  if ( input >= nInputs ) return;
+  this->solo[input] = solo;
+  changed = true;
+}
+
+void Mixer :: setSoloOnly( unsigned int input )
+{
+  for (unsigned int i=0; i<nInputs; i++)
+    solo[i] = ( i == input );
+  changed = true;
+}
+
+void Mixer :: clearSolo( void )
+{
+  for (unsigned int i=0; i<nInputs; i++)
+    solo[i] = false;
+  changed = true;
+}
+
+void Mixer :: setMute( unsigned int input, bool mute )
+{
+  if ( input >= nInputs ) return;
+  this->mute[input] = mute;
+  changed = true;
+}
+
+bool Mixer :: isHeard( unsigned int input ) const
+{
+  if ( input >= nInputs || mute[input] ) return false;
+  if ( solo[input] ) return true;
+  for (unsigned int i=0; i<nInputs; i++)
+    if ( solo[i] ) return false;
+  return true;
+}
+
+void Mixer :: update( void )
+{
+  if ( !changed ) return;
+
+  // Solos and mutes are folded into the gains once, here, rather than
+  // tested for each sample.
+  for (unsigned int i=0; i<nInputs; i++) {
+    MY_FLOAT heard = isHeard( i ) ? 1.0 : 0.0;
+    for (unsigned int j=0; j<nOutputs; j++)
+      target[i*nOutputs+j] = heard * gains[i*nOutputs+j];
+  }
+  changed = false;
+}
+
+void Mixer :: tick( const MY_FLOAT * const *inputs, const bool *silent, FLOAT64 *output, unsigned int frames )
+{
+  if ( frames == 0 ) return;
+  update();
+
+  for (unsigned int offset=0; offset<frames; offset+=bufferFrames) {
+    unsigned int n = frames - offset;
+    if ( n > bufferFrames ) n = bufferFrames;
+
+    memset( buses, 0, nOutputs * bufferFrames * sizeof(MY_FLOAT) );
+    for (unsigned int i=0; i<nInputs; i++) {
+      if ( silent && silent[i] ) continue;
+      for (unsigned int j=0; j<nOutputs; j++) {
+        MY_FLOAT from = current[i*nOutputs+j];
+        MY_FLOAT to = target[i*nOutputs+j];
+        if ( from == 0.0 && to == 0.0 ) continue;
+        MY_FLOAT step = ( to - from ) / frames;
+        kernels->mix( inputs[i] + offset, buses + j * bufferFrames, n, from + offset * step, step );
+      }
+    }
+    kernels->interleave( buses, bufferFrames, nOutputs, output + offset * nOutputs, n );
+  }
+
+  memcpy( current, target, nInputs * nOutputs * sizeof(MY_FLOAT) );
+}
@@ -0,0 +1,98 @@
+/***************************************************/
+/*! \class Mixer
+    \brief Mixes N inputs into M output channels.
+
+    Each input reaches each output channel with the
+    gain set for that pair in an N by M matrix, so a
+    mono stem can be panned or sent to any channels.
+    Inputs can be soloed and muted: when any input is
+    soloed, only soloed inputs are heard, and muted
+    inputs never are.
+
+    The gains, solos and mutes are set by the audio
+    thread between blocks (see ControlQueue), and the
+    gains ramp from their old values to the new over
+    the next block.  isHeard() can be called from
+    any other thread.  tick() mixes a block at a
+    time with the same branch-free loop for every
+    input and channel; on x86 processors, SSE2 or
+    AVX2 versions are chosen at runtime, as in
+    SampleConvert.  It doesn't lock or allocate.
+*/
+/***************************************************/
+
+#if !defined(__MIXER_H)
+#define __MIXER_H
+
+#include "Stk.h"
+#include <atomic>
+
+struct MixKernels;
+
+class Mixer : public Stk
+{
+public:
+  //! Class constructor, for \e nInputs inputs and \e nOutputs output channels, mixed \e bufferFrames frames at a time.
+  /*!
+    Every input starts at unity gain to every output, none soloed
+    or muted.  Longer blocks are mixed in pieces of \e bufferFrames.
+    An StkError will be thrown if there are no inputs or outputs.
+  */
+  Mixer( unsigned int nInputs, unsigned int nOutputs, unsigned int bufferFrames );
+
+  //! Class destructor.
+  ~Mixer();
+
+  //! Set the gain from input \e input to output channel \e output.
+  /*!
+    An StkError will be thrown if either is out of range.
+  */
+  void setGain( unsigned int input, unsigned int output, MY_FLOAT gain );
+
+  //! Return the gain from input \e input to output channel \e output, or 0 if either is out of range.
+  MY_FLOAT getGain( unsigned int input, unsigned int output ) const;
+
+  //! Solo (or unsolo) input \e input.
+  void setSolo( unsigned int input, bool solo );
+
+  //! Solo input \e input and unsolo the others, all at once.
+  void setSoloOnly( unsigned int input );
+
+  //! Unsolo every input.
+  void clearSolo( void );
+
+  //! Mute (or unmute) input \e input.
+  void setMute( unsigned int input, bool mute );
+
+  //! Return whether input \e input is heard, given the solos and mutes set, from any thread.
+  bool isHeard( unsigned int input ) const;
+
+  //! Mix \e frames frames of each of the inputs into interleaved \e output, replacing what was there.
+  /*!
+    Called by the audio thread.  \e inputs holds a buffer for each
+    input.  Inputs flagged in \e silent, if it is given, are taken
+    to be zero and aren't read.  Settings changed since the last
+    call ramp in over these frames.
+  */
+  void tick( const MY_FLOAT * const *inputs, const bool *silent, FLOAT64 *output, unsigned int frames );
+
+protected:
+
+  // Take up the settings, if they have changed, as the gains to ramp to.
+  void update( void );
+
+  unsigned int nInputs;
+  unsigned int nOutputs;
+  unsigned int bufferFrames;
+  MY_FLOAT *gains;                        // nInputs by nOutputs, as set
+  std::atomic<bool> *solo;                // read by isHeard() from other threads
+  std::atomic<bool> *mute;
+  bool changed;                           // since the gains to ramp to were worked out
+  MY_FLOAT *current;                      // gains at the end of the last block
+  MY_FLOAT *target;                       // gains at the end of the next
+  MY_FLOAT *buses;                        // nOutputs of bufferFrames
+  const MixKernels *kernels;
+  char msg[256];
+};
+
+#endif // defined(__MIXER_H)
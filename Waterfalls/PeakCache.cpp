@@ -0,0 +1,219 @@
+/***************************************************/
+/*! \class PeakCache
+    \brief Sidecar cache of audio file levels.
+
+    The peak and RMS levels of a file, overall, for
+    each channel and for each PEAKCACHE_BLOCK sample
+    frames, are kept in a small file next
+    to it, named after it with PEAKCACHE_SUFFIX
+    appended.  The cache records the size and
+    modification time of the file it was made from
+    and is ignored once either changes, so an edited
+    take is scanned again.
+
+    Levels are in the units of the data as stored
+    (see WvIn::getStats()).  The cache files are in
+    the host byte order; one written on a host of the
+    other order is ignored.  Failing to write one is
+    not an error, so read-only media still play.
+*/
+/***************************************************/
+
+#include "PeakCache.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#if defined(__OS_WINDOWS__)
+  #include <process.h>
+  #define getpid _getpid
+#else
+  #include <unistd.h>
+#endif
+
+#define PEAKCACHE_VERSION 2
+#define PEAKCACHE_ORDER 0x01020304
+
+// Fixed part of a cache file, followed by the peak and then the RMS
+// level of each channel, up to PEAKCACHE_CHANNELS, as FLOAT64 values,
+// and then the peak and then the RMS level of each block as FLOAT32 values.
+struct PeakCacheHeader {
+  char magic[4];                // "PEAK"
+  UINT32 order;                 // PEAKCACHE_ORDER in the writer's byte order
+  UINT32 version;
+  UINT32 channels;
+  UINT64 fileBytes;             // size of the audio file
+  UINT64 modified;              // its modification time, in seconds
+  UINT64 frames;
+  FLOAT64 peak;
+  FLOAT64 rms;
+  UINT64 blocks;
+  UINT32 blockFrames;           // PEAKCACHE_BLOCK
+  UINT32 reserved;
+};
+
+PeakStats :: PeakStats()
+  : frames(0), channels(0), peak(0.0), rms(0.0), blocks(0), blockPeak(0), blockRms(0)
+{
+}
+
+PeakStats :: ~PeakStats()
+{
+  delete [] blockPeak;
+  delete [] blockRms;
+}
+
+void PeakStats :: resize( unsigned long count )
+{
+  delete [] blockPeak;
+  delete [] blockRms;
+  blockPeak = 0;
+  blockRms = 0;
+  blocks = count;
+  if ( count == 0 ) return;
+  blockPeak = new MY_FLOAT[count];
+  blockRms = new MY_FLOAT[count];
+}
+
+void PeakStats :: getLevels( double start, double frames, MY_FLOAT *peak, MY_FLOAT *meanSquare ) const
+{
+  *peak = 0.0;
+  *meanSquare = 0.0;
+  double end = start + frames;
+  if ( start < 0.0 ) start = 0.0;
+  if ( blocks == 0 || end <= start ) return;
+
+  unsigned long first = (unsigned long) (start / PEAKCACHE_BLOCK);
+  unsigned long last = (unsigned long) (end / PEAKCACHE_BLOCK);
+  if ( first >= blocks ) return;
+  if ( last >= blocks ) last = blocks - 1;
+
+  double squares = 0.0;
+  for (unsigned long i=first; i<=last; i++) {
+    if ( blockPeak[i] > *peak ) *peak = blockPeak[i];
+    squares += (double) blockRms[i] * blockRms[i];
+  }
+  *meanSquare = (MY_FLOAT) (squares / (last - first + 1));
+}
+
+// Build the cache file name and find the key of the audio file.
+static bool cacheKey( const char *fileName, char *cacheName, size_t length, UINT64 *bytes, UINT64 *modified )
+{
+  struct stat filestat;
+  if ( stat( fileName, &filestat ) == -1 ) return false;
+  if ( strlen( fileName ) + strlen( PEAKCACHE_SUFFIX ) + 1 > length ) return false;
+
+  strcpy( cacheName, fileName );
+  strcat( cacheName, PEAKCACHE_SUFFIX );
+  *bytes = (UINT64) filestat.st_size;
+  *modified = (UINT64) filestat.st_mtime;
+  return true;
+}
+
+// The block index is kept as FLOAT32 values, whatever MY_FLOAT is.
+static bool readBlocks( FILE *fd, MY_FLOAT *levels, unsigned long count )
+{
+  FLOAT32 buffer[PEAKCACHE_BLOCK];
+  for (unsigned long i=0; i<count; ) {
+    size_t n = ( count - i < PEAKCACHE_BLOCK ) ? count - i : PEAKCACHE_BLOCK;
+    if ( fread( buffer, sizeof(FLOAT32), n, fd ) != n ) return false;
+    for (size_t j=0; j<n; j++) levels[i++] = (MY_FLOAT) buffer[j];
+  }
+  return true;
+}
+
+static bool writeBlocks( FILE *fd, const MY_FLOAT *levels, unsigned long count )
+{
+  FLOAT32 buffer[PEAKCACHE_BLOCK];
+  for (unsigned long i=0; i<count; ) {
+    size_t n = ( count - i < PEAKCACHE_BLOCK ) ? count - i : PEAKCACHE_BLOCK;
+    for (size_t j=0; j<n; j++) buffer[j] = (FLOAT32) levels[i++];
+    if ( fwrite( buffer, sizeof(FLOAT32), n, fd ) != n ) return false;
+  }
+  return true;
+}
+
+bool PeakCache :: find( const char *fileName, PeakStats *stats )
+{
+  char cacheName[1024];
+  UINT64 bytes, modified;
+  if ( !cacheKey( fileName, cacheName, sizeof(cacheName), &bytes, &modified ) ) return false;
+
+  FILE *fd = fopen( cacheName, "rb" );
+  if ( !fd ) return false;
+
+  PeakCacheHeader header;
+  FLOAT64 levels[2 * PEAKCACHE_CHANNELS];
+  bool found = false;
+  if ( fread( &header, sizeof(header), 1, fd ) == 1 &&
+       !strncmp( header.magic, "PEAK", 4 ) && header.order == PEAKCACHE_ORDER &&
+       header.version == PEAKCACHE_VERSION && header.fileBytes == bytes &&
+       header.modified == modified && header.channels > 0 &&
+       header.blockFrames == PEAKCACHE_BLOCK &&
+       header.blocks == (header.frames + PEAKCACHE_BLOCK - 1) / PEAKCACHE_BLOCK ) {
+    unsigned int n = header.channels;
+    if ( n > PEAKCACHE_CHANNELS ) n = PEAKCACHE_CHANNELS;
+    unsigned long blocks = (unsigned long) header.blocks;
+    stats->resize( blocks );
+    if ( fread( levels, sizeof(FLOAT64), 2 * n, fd ) == 2 * n &&
+         readBlocks( fd, stats->blockPeak, blocks ) && readBlocks( fd, stats->blockRms, blocks ) ) {
+      stats->frames = (unsigned long) header.frames;
+      stats->channels = header.channels;
+      stats->peak = (MY_FLOAT) header.peak;
+      stats->rms = (MY_FLOAT) header.rms;
+      for (unsigned int i=0; i<n; i++) {
+        stats->channelPeak[i] = (MY_FLOAT) levels[i];
+        stats->channelRms[i] = (MY_FLOAT) levels[n+i];
+      }
+      found = true;
+    }
+    else stats->resize( 0 );
+  }
+
+  fclose( fd );
+  return found;
+}
+
+bool PeakCache :: store( const char *fileName, const PeakStats &stats )
+{
+  char cacheName[1024], tempName[1040];
+  UINT64 bytes, modified;
+  if ( !cacheKey( fileName, cacheName, sizeof(cacheName), &bytes, &modified ) ) return false;
+
+  PeakCacheHeader header;
+  memcpy( header.magic, "PEAK", 4 );
+  header.order = PEAKCACHE_ORDER;
+  header.version = PEAKCACHE_VERSION;
+  header.channels = stats.channels;
+  header.fileBytes = bytes;
+  header.modified = modified;
+  header.frames = stats.frames;
+  header.peak = stats.peak;
+  header.rms = stats.rms;
+  header.blocks = stats.blocks;
+  header.blockFrames = PEAKCACHE_BLOCK;
+  header.reserved = 0;
+
+  FLOAT64 levels[2 * PEAKCACHE_CHANNELS];
+  unsigned int n = stats.channels;
+  if ( n > PEAKCACHE_CHANNELS ) n = PEAKCACHE_CHANNELS;
+  for (unsigned int i=0; i<n; i++) {
+    levels[i] = stats.channelPeak[i];
+    levels[n+i] = stats.channelRms[i];
+  }
+
+  // Write a temporary file and rename it, so that a reader never sees
+  // half a cache, even with two copies of the program scanning at once.
+  sprintf( tempName, "%s.%lu", cacheName, (unsigned long) getpid() );
+  FILE *fd = fopen( tempName, "wb" );
+  if ( !fd ) return false;
+  bool ok = fwrite( &header, sizeof(header), 1, fd ) == 1 &&
+    fwrite( levels, sizeof(FLOAT64), 2 * n, fd ) == 2 * n &&
+    writeBlocks( fd, stats.blockPeak, stats.blocks ) &&
+    writeBlocks( fd, stats.blockRms, stats.blocks );
+  if ( fclose( fd ) != 0 ) ok = false;
+  if ( ok && rename( tempName, cacheName ) == 0 ) return true;
+
+  remove( tempName );
+  return false;
+}
@@ -0,0 +1,76 @@
+/***************************************************/
+/*! \class PeakCache
+    \brief Sidecar cache of audio file levels.
+
+    The peak and RMS levels of a file, overall, for
+    each channel and for each PEAKCACHE_BLOCK sample
+    frames, are kept in a small file next
+    to it, named after it with PEAKCACHE_SUFFIX
+    appended.  The cache records the size and
+    modification time of the file it was made from
+    and is ignored once either changes, so an edited
+    take is scanned again.
+
+    Levels are in the units of the data as stored
+    (see WvIn::getStats()).  The cache files are in
+    the host byte order; one written on a host of the
+    other order is ignored.  Failing to write one is
+    not an error, so read-only media still play.
+*/
+/***************************************************/
+
+#if !defined(__PEAKCACHE_H)
+#define __PEAKCACHE_H
+
+#define PEAKCACHE_SUFFIX ".peaks"
+#define PEAKCACHE_CHANNELS 16   // channels with their own levels, at most
+#define PEAKCACHE_BLOCK 1024    // sample frames per entry of the block index
+
+#include "Stk.h"
+
+//! The levels of an audio file, overall and block by block.
+struct PeakStats {
+  unsigned long frames;
+  unsigned int channels;
+  MY_FLOAT peak;                              // greatest magnitude of any sample
+  MY_FLOAT rms;                               // over all channels
+  MY_FLOAT channelPeak[PEAKCACHE_CHANNELS];
+  MY_FLOAT channelRms[PEAKCACHE_CHANNELS];
+  unsigned long blocks;                       // entries in the block index
+  MY_FLOAT *blockPeak;                        // greatest magnitude in each block, of any channel
+  MY_FLOAT *blockRms;                         // RMS level of each block, of the channels' average
+
+  PeakStats();
+  ~PeakStats();
+
+  //! Make room for an index of \e count blocks, dropping the one held.
+  void resize( unsigned long count );
+
+  //! Find the peak and mean square levels over \e frames sample frames from frame \e start.
+  /*!
+    The levels are those of the blocks the frames fall in, so they
+    may take in a little more than was asked for.  Frames outside
+    the file count as silent.
+  */
+  void getLevels( double start, double frames, MY_FLOAT *peak, MY_FLOAT *meanSquare ) const;
+
+private:
+  PeakStats( const PeakStats & );
+  void operator=( const PeakStats & );
+};
+
+class PeakCache : public Stk
+{
+public:
+  //! Read the levels of \e fileName into \e stats.
+  /*!
+    Returns FALSE if there is no cache for the file, or if the
+    file has changed since it was made.
+  */
+  static bool find( const char *fileName, PeakStats *stats );
+
+  //! Store the levels of \e fileName.  Returns FALSE if the cache could not be written.
+  static bool store( const char *fileName, const PeakStats &stats );
+};
+
+#endif // defined(__PEAKCACHE_H)
@@ -0,0 +1,321 @@
+/***************************************************/
+/*! \class PrefetchWvIn
+    \brief WvIn subclass with background chunk loading.
+
+    This class inherits from WvIn.  For files that
+    are read incrementally from disk, a loader thread
+    keeps PREFETCH_SLOTS chunks of upcoming sample
+    frames resident, so that tickFrame() never reads
+    the file itself.  readData() only swaps in a chunk
+    that has already been loaded.  If the chunk is not
+    ready yet, silence is output for CHUNK_SIZE frames
+    and the underrun is counted rather than waiting
+    for the disk.  While a loop is set, the chunks at
+    the loop start are loaded ahead of the loop end,
+    so wrapping around the loop never waits either.
+
+    Files that are loaded completely or memory-mapped,
+    and attached data, behave exactly as with WvIn and no thread is run.
+*/
+/***************************************************/
+
+#include "PrefetchWvIn.h"
+#include <string.h>
+
+PrefetchWvIn :: PrefetchWvIn()
+  : WvIn(), current(0), chunkData(0), silence(0),
+    running(false), stopped(true), request(0), direction(1),
+    loopFirst(-1), loopLast(-1), underruns(0)
+{
+  for (int i=0; i<PREFETCH_SLOTS; i++) {
+    slots[i].buffer = 0;
+    slots[i].state = SLOT_FREE;
+  }
+}
+
+PrefetchWvIn :: PrefetchWvIn( const char *fileName, bool raw, bool doNormalize, bool doMap )
+  : WvIn(), current(0), chunkData(0), silence(0),
+    running(false), stopped(true), request(0), direction(1),
+    loopFirst(-1), loopLast(-1), underruns(0)
+{
+  for (int i=0; i<PREFETCH_SLOTS; i++) {
+    slots[i].buffer = 0;
+    slots[i].state = SLOT_FREE;
+  }
+  openFile( fileName, raw, doNormalize, doMap );
+}
+
+PrefetchWvIn :: ~PrefetchWvIn()
+{
+  stopLoader();
+}
+
+void PrefetchWvIn :: openFile( const char *fileName, bool raw, bool doNormalize, bool doMap )
+{
+  stopLoader();
+
+  // The first chunk is read synchronously by WvIn.
+  WvIn::openFile( fileName, raw, doNormalize, doMap );
+
+  if ( chunking ) startLoader();
+}
+
+void PrefetchWvIn :: attachData( const void *samples, unsigned long frames, unsigned int nChannels,
+                                 STK_FORMAT format, MY_FLOAT aFileRate, MY_FLOAT peak,
+                                 bool doNormalize )
+{
+  stopLoader();
+  WvIn::attachData( samples, frames, nChannels, format, aFileRate, peak, doNormalize );
+}
+
+void PrefetchWvIn :: closeFile(void)
+{
+  stopLoader();
+  WvIn::closeFile();
+}
+
+void PrefetchWvIn :: seek( double frame )
+{
+  WvIn::seek( frame );
+  if ( !running || finished ) return;
+
+  // Point the loader at the new position before the next tick asks for it.
+  long index = (long) time;
+  direction = ( rate < 0.0 ) ? -1 : 1;
+  request = (index / PREFETCH_CHUNK_SIZE) * PREFETCH_CHUNK_SIZE;
+  publishLoop( time );
+}
+
+void PrefetchWvIn :: setLoop( unsigned long start, unsigned long end )
+{
+  WvIn::setLoop( start, end );
+  if ( running ) publishLoop( time );
+}
+
+void PrefetchWvIn :: clearLoop(void)
+{
+  WvIn::clearLoop();
+  if ( running ) publishLoop( time );
+}
+
+void PrefetchWvIn :: publishLoop( double position )
+{
+  long first = -1, last = -1;
+  if ( looping && ( (rate >= 0.0 && position < loopEnd) || (rate < 0.0 && position >= loopStart) ) ) {
+    first = (loopStart / PREFETCH_CHUNK_SIZE) * PREFETCH_CHUNK_SIZE;
+    last = ((loopEnd - 1) / PREFETCH_CHUNK_SIZE) * PREFETCH_CHUNK_SIZE;
+  }
+  loopFirst = first;
+  loopLast = last;
+}
+
+long PrefetchWvIn :: nextChunk( long start, long step ) const
+{
+  long first = loopFirst, last = loopLast;
+  if ( first >= 0 ) {
+    if ( step > 0 && start == last ) return first;
+    if ( step < 0 && start == first ) return last;
+  }
+  return start + step * PREFETCH_CHUNK_SIZE;
+}
+
+unsigned long PrefetchWvIn :: getUnderruns(void) const
+{
+  return underruns;
+}
+
+void PrefetchWvIn :: startLoader( void )
+{
+  unsigned long samples = (PREFETCH_CHUNK_SIZE+1) * channels;
+  for (int i=0; i<PREFETCH_SLOTS; i++) {
+    slots[i].buffer = new MY_FLOAT[samples];
+    slots[i].start = 0;
+    slots[i].frames = 0;
+    slots[i].state = SLOT_FREE;
+  }
+  silence = new MY_FLOAT[(CHUNK_SIZE+1) * channels];
+  memset( silence, 0, (CHUNK_SIZE+1) * channels * sizeof(MY_FLOAT) );
+
+  chunkData = data;
+  current = 0;
+  request = 0;
+  direction = 1;
+  underruns = 0;
+  publishLoop( time );
+
+  running = true;
+  stopped = false;
+  if ( !loader.start( &loaderThread, this ) ) {
+    running = false;
+    stopped = true;
+    sprintf(msg, "PrefetchWvIn: Unable to start the loader thread.");
+    handleError(msg, StkError::PROCESS_THREAD);
+  }
+}
+
+void PrefetchWvIn :: stopLoader( void )
+{
+  if ( !stopped ) {
+    // Let the loader finish its current read rather than cancelling it.
+    running = false;
+    while ( !stopped ) Stk::sleep( PREFETCH_POLL );
+    loader.wait();
+  }
+
+  // Give the chunk buffer back to WvIn before freeing the slots.
+  if ( chunkData ) data = chunkData;
+  chunkData = 0;
+  current = 0;
+
+  for (int i=0; i<PREFETCH_SLOTS; i++) {
+    if ( slots[i].buffer ) delete [] slots[i].buffer;
+    slots[i].buffer = 0;
+    slots[i].state = SLOT_FREE;
+  }
+  if ( silence ) delete [] silence;
+  silence = 0;
+}
+
+void PrefetchWvIn :: readData( unsigned long index )
+{
+  // Before the loader runs (while opening), read directly.
+  if ( !running ) {
+    WvIn::readData( index );
+    return;
+  }
+
+  long start = (index / PREFETCH_CHUNK_SIZE) * PREFETCH_CHUNK_SIZE;
+  long step = ( rate < 0.0 ) ? -1 : 1;
+
+  Slot *found = 0;
+  for (int i=0; i<PREFETCH_SLOTS && !found; i++) {
+    int ready = SLOT_READY;
+    if ( slots[i].start != start ||
+         !slots[i].state.compare_exchange_strong( ready, SLOT_PLAYING ) )
+      continue;
+    // The loader may have reloaded the slot with another chunk between
+    // the check and the claim, so check again now that it can't.
+    if ( slots[i].start == start )
+      found = &slots[i];
+    else
+      slots[i].state = SLOT_READY;
+  }
+
+  // Hand the chunk we are leaving back to the loader.
+  if ( current ) current->state = SLOT_FREE;
+  current = found;
+
+  publishLoop( index );
+  if ( found ) {
+    data = found->buffer;
+    chunkPointer = start;
+    bufferSize = found->frames;
+    direction = step;
+    request = nextChunk( start, step );
+  }
+  else {
+    // Not resident yet: play silence for a short while and try again.
+    underruns++;
+    data = silence;
+    if ( step < 0 ) {
+      // Cover the frames before index, which are read next in reverse.
+      chunkPointer = ( index + 1 > CHUNK_SIZE ) ? index + 1 - CHUNK_SIZE : 0;
+      bufferSize = index + 1 - chunkPointer;
+    }
+    else {
+      chunkPointer = index;
+      bufferSize = CHUNK_SIZE;
+      if ( index + CHUNK_SIZE > fileSize ) bufferSize = fileSize - index;
+    }
+    direction = step;
+    request = start;
+  }
+}
+
+PrefetchWvIn::Slot *PrefetchWvIn :: claimSlot( const long *wanted, int count )
+{
+  int i, j, expected;
+
+  for (i=0; i<PREFETCH_SLOTS; i++) {
+    expected = SLOT_FREE;
+    if ( slots[i].state.compare_exchange_strong( expected, SLOT_LOADING ) )
+      return &slots[i];
+  }
+
+  // Reuse a loaded chunk that is no longer ahead of the read position.
+  for (i=0; i<PREFETCH_SLOTS; i++) {
+    for (j=0; j<count; j++)
+      if ( slots[i].start == wanted[j] ) break;
+    if ( j < count ) continue;
+    expected = SLOT_READY;
+    if ( slots[i].state.compare_exchange_strong( expected, SLOT_LOADING ) )
+      return &slots[i];
+  }
+
+  return 0;
+}
+
+bool PrefetchWvIn :: prefetch( void )
+{
+  long step = direction;
+  bool loaded = false;
+
+  // The chunks to be read next, in order, following the loop.
+  long wanted[PREFETCH_SLOTS-1];
+  int count = 0;
+  for (long start = request; count<PREFETCH_SLOTS-1; start = nextChunk( start, step )) {
+    if ( start < 0 || start >= (long) fileSize ) break;
+    wanted[count++] = start;
+  }
+
+  for (int ahead=0; ahead<count; ahead++) {
+    long start = wanted[ahead];
+
+    // Already resident (or playing)?
+    int i;
+    for (i=0; i<PREFETCH_SLOTS; i++) {
+      int state = slots[i].state;
+      if ( (state == SLOT_READY || state == SLOT_PLAYING) && slots[i].start == start )
+        break;
+    }
+    if ( i < PREFETCH_SLOTS ) continue;
+
+    Slot *slot = claimSlot( wanted, count );
+    if ( !slot ) break;
+
+    unsigned long frames = PREFETCH_CHUNK_SIZE;
+    if ( start + frames > fileSize ) frames = fileSize - start;
+    bool endfile = ( start + frames == fileSize );
+
+    if ( !readFrames( fd, start, endfile ? frames : frames + 1, slot->buffer ) ) {
+      slot->state = SLOT_FREE;
+      break;
+    }
+
+    // If at end of file, repeat last sample frame for interpolation.
+    if ( endfile ) {
+      for (unsigned int j=0; j<channels; j++)
+        slot->buffer[frames*channels+j] = slot->buffer[(frames-1)*channels+j];
+    }
+
+    slot->start = start;
+    slot->frames = frames;
+    slot->state = SLOT_READY;
+    loaded = true;
+  }
+
+  return loaded;
+}
+
+THREAD_RETURN THREAD_TYPE PrefetchWvIn :: loaderThread( void *ptr )
+{
+  PrefetchWvIn *input = (PrefetchWvIn *) ptr;
+
+  while ( input->running ) {
+    if ( !input->prefetch() )
+      Stk::sleep( PREFETCH_POLL );
+  }
+
+  input->stopped = true;
+  return 0;
+}
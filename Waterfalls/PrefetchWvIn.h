@@ -0,0 +1,126 @@
+/***************************************************/
+/*! \class PrefetchWvIn
+    \brief WvIn subclass with background chunk loading.
+
+    This class inherits from WvIn.  For files that
+    are read incrementally from disk, a loader thread
+    keeps PREFETCH_SLOTS chunks of upcoming sample
+    frames resident, so that tickFrame() never reads
+    the file itself.  readData() only swaps in a chunk
+    that has already been loaded.  If the chunk is not
+    ready yet, silence is output for CHUNK_SIZE frames
+    and the underrun is counted rather than waiting
+    for the disk.  While a loop is set, the chunks at
+    the loop start are loaded ahead of the loop end,
+    so wrapping around the loop never waits either.
+
+    Files that are loaded completely or memory-mapped,
+    and attached data, behave exactly as with WvIn and no thread is run.
+*/
+/***************************************************/
+
+#if !defined(__PREFETCHWVIN_H)
+#define __PREFETCHWVIN_H
+
+// Number of chunk buffers per file and their size in sample frames.
+// One chunk is being played while the others are loaded ahead.
+
+#define PREFETCH_SLOTS 3
+#define PREFETCH_CHUNK_SIZE 16384  // sample frames
+
+// Loader thread polling interval (milliseconds).
+#define PREFETCH_POLL 2
+
+#include "WvIn.h"
+#include "Thread.h"
+#include <atomic>
+
+class PrefetchWvIn : public WvIn
+{
+public:
+  //! Default constructor.
+  PrefetchWvIn();
+
+  //! Overloaded constructor for file input.
+  /*!
+    An StkError will be thrown if the file is not found, its format is
+    unknown, or a read error occurs.
+  */
+  PrefetchWvIn( const char *fileName, bool raw = FALSE, bool doNormalize = TRUE, bool doMap = FALSE );
+
+  //! Class destructor.
+  ~PrefetchWvIn();
+
+  //! Open the specified file, load its first chunk and start the loader thread if needed.
+  /*!
+    An StkError will be thrown if the file is not found, its format is
+    unknown, or a read error occurs.
+  */
+  void openFile( const char *fileName, bool raw = FALSE, bool doNormalize = TRUE, bool doMap = FALSE );
+
+  //! Stop the loader thread and read from memory owned by the caller (see WvIn::attachData()).
+  void attachData( const void *samples, unsigned long frames, unsigned int nChannels,
+                   STK_FORMAT format, MY_FLOAT aFileRate, MY_FLOAT peak = 0.0,
+                   bool doNormalize = TRUE );
+
+  //! Stop the loader thread and close the file.
+  void closeFile(void);
+
+  //! Move the read pointer (see WvIn::seek()) and start loading the chunks there.
+  void seek( double frame );
+
+  //! Loop reading (see WvIn::setLoop()), loading the loop start ahead of the loop end.
+  void setLoop( unsigned long start, unsigned long end );
+
+  //! Stop looping.
+  void clearLoop(void);
+
+  //! Return the number of chunks that were not resident when they were needed.
+  unsigned long getUnderruns(void) const;
+
+protected:
+
+  struct Slot {
+    MY_FLOAT *buffer;
+    std::atomic<long> start;
+    unsigned long frames;
+    std::atomic<int> state;
+  };
+
+  enum { SLOT_FREE, SLOT_LOADING, SLOT_READY, SLOT_PLAYING };
+
+  // Swap in a resident chunk covering \e index, or silence.
+  void readData(unsigned long index);
+
+  // Load any missing chunks ahead of the requested one.  Returns TRUE if a chunk was loaded.
+  bool prefetch( void );
+
+  // Claim a free slot, or a loaded one whose chunk is not among the \e count chunks \e wanted.
+  Slot *claimSlot( const long *wanted, int count );
+
+  // Return the start of the chunk read after the one at \e start in direction \e step.
+  long nextChunk( long start, long step ) const;
+
+  // Publish the loop chunks to the loader, if the loop applies at \e position.
+  void publishLoop( double position );
+
+  void startLoader( void );
+  void stopLoader( void );
+
+  static THREAD_RETURN THREAD_TYPE loaderThread( void *ptr );
+
+  Thread loader;
+  Slot slots[PREFETCH_SLOTS];
+  Slot *current;
+  MY_FLOAT *chunkData;
+  MY_FLOAT *silence;
+  std::atomic<bool> running;
+  std::atomic<bool> stopped;
+  std::atomic<long> request;
+  std::atomic<long> direction;
+  std::atomic<long> loopFirst;
+  std::atomic<long> loopLast;
+  std::atomic<unsigned long> underruns;
+};
+
+#endif // defined(__PREFETCHWVIN_H)
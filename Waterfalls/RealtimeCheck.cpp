@@ -0,0 +1,426 @@
+/***************************************************/
+/*! \class RealtimeCheck
+    \brief Reports calls which may block from the audio thread.
+
+    The audio callback is marked with enter() and
+    leave().  When built with __RT_CHECK__ defined
+    (make RTCHECK=1, on Linux), the allocator,
+    pthread mutex locks and condition waits, sleeps,
+    file I/O and C++ throws (such as handleError()'s)
+    are wrapped, and any call to one of them from a
+    thread between enter() and leave() is reported to
+    stderr with a backtrace.  Each place they are
+    called from is reported once, and all are
+    counted.  File I/O covers the stdio calls,
+    fseeko(), open(), read() and pread(), with their
+    64-bit versions; pthread_mutex_trylock(), which
+    doesn't wait, isn't reported.  Otherwise enter()
+    and leave() do nothing.
+*/
+/***************************************************/
+
+#include "RealtimeCheck.h"
+
+#if defined(__RT_CHECK__) && defined(__linux__)
+
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <time.h>
+#include <atomic>
+
+#define RTCHECK_SITES 256             // places reported, at most
+#define RTCHECK_FRAMES 32             // of each backtrace
+#define RTCHECK_BOOTSTRAP 8192        // bytes for dlsym() to allocate while the allocator is looked up
+
+// What the calling thread is running, if it is marked, and whether it is
+// reporting (when the wrappers just pass calls on).
+static __thread const char *marked = NULL;
+static __thread bool reporting = false;
+
+static std::atomic<unsigned long> violations( 0 );
+static std::atomic<UINT64> sites[RTCHECK_SITES];
+
+// The wrapped functions.
+static void *(*realMalloc)( size_t ) = NULL;
+static void *(*realCalloc)( size_t, size_t ) = NULL;
+static void *(*realRealloc)( void *, size_t ) = NULL;
+static void (*realFree)( void * ) = NULL;
+static int (*realPosixMemalign)( void **, size_t, size_t ) = NULL;
+static void *(*realAlignedAlloc)( size_t, size_t ) = NULL;
+static int (*realMutexLock)( pthread_mutex_t * ) = NULL;
+static int (*realCondWait)( pthread_cond_t *, pthread_mutex_t * ) = NULL;
+static int (*realCondTimedwait)( pthread_cond_t *, pthread_mutex_t *, const struct timespec * ) = NULL;
+static int (*realUsleep)( useconds_t ) = NULL;
+static int (*realNanosleep)( const struct timespec *, struct timespec * ) = NULL;
+static FILE *(*realFopen)( const char *, const char * ) = NULL;
+static int (*realFclose)( FILE * ) = NULL;
+static size_t (*realFread)( void *, size_t, size_t, FILE * ) = NULL;
+static size_t (*realFwrite)( const void *, size_t, size_t, FILE * ) = NULL;
+static int (*realFseek)( FILE *, long, int ) = NULL;
+static int (*realFseeko)( FILE *, off_t, int ) = NULL;
+static int (*realFseeko64)( FILE *, off64_t, int ) = NULL;
+static int (*realOpen)( const char *, int, ... ) = NULL;
+static int (*realOpen64)( const char *, int, ... ) = NULL;
+static ssize_t (*realRead)( int, void *, size_t ) = NULL;
+static ssize_t (*realPread)( int, void *, size_t, off_t ) = NULL;
+static ssize_t (*realPread64)( int, void *, size_t, off64_t ) = NULL;
+static void (*realThrow)( void *, void *, void (*)( void * ) ) = NULL;
+
+// dlsym() can allocate while the allocator itself is being looked up,
+// so until it has been, allocations come from here and are never freed.
+static char bootstrap[RTCHECK_BOOTSTRAP];
+static size_t bootstrapUsed = 0;
+static bool resolving = false;
+
+static void *bootstrapAlloc( size_t size )
+{
+  size = ( size + 15 ) & ~(size_t) 15;
+  if ( bootstrapUsed + size > RTCHECK_BOOTSTRAP ) return NULL;
+  void *ptr = bootstrap + bootstrapUsed;
+  bootstrapUsed += size;
+  return ptr;
+}
+
+static bool isBootstrap( void *ptr )
+{
+  return (char *) ptr >= bootstrap && (char *) ptr < bootstrap + RTCHECK_BOOTSTRAP;
+}
+
+// pthread_cond_wait() has two versions, and plain dlsym() finds the old one.
+static void *lookUp( const char *name, const char *version = NULL )
+{
+  void *ptr = NULL;
+  if ( version ) ptr = dlvsym( RTLD_NEXT, name, version );
+  if ( ptr == NULL ) ptr = dlsym( RTLD_NEXT, name );
+  return ptr;
+}
+
+static void resolve( void )
+{
+  if ( resolving ) return;
+  resolving = true;
+  realMalloc = (void *(*)( size_t )) lookUp( "malloc" );
+  realCalloc = (void *(*)( size_t, size_t )) lookUp( "calloc" );
+  realRealloc = (void *(*)( void *, size_t )) lookUp( "realloc" );
+  realFree = (void (*)( void * )) lookUp( "free" );
+  realPosixMemalign = (int (*)( void **, size_t, size_t )) lookUp( "posix_memalign" );
+  realAlignedAlloc = (void *(*)( size_t, size_t )) lookUp( "aligned_alloc" );
+  realMutexLock = (int (*)( pthread_mutex_t * )) lookUp( "pthread_mutex_lock" );
+  realCondWait = (int (*)( pthread_cond_t *, pthread_mutex_t * )) lookUp( "pthread_cond_wait", "GLIBC_2.3.2" );
+  realCondTimedwait = (int (*)( pthread_cond_t *, pthread_mutex_t *, const struct timespec * ))
+    lookUp( "pthread_cond_timedwait", "GLIBC_2.3.2" );
+  realUsleep = (int (*)( useconds_t )) lookUp( "usleep" );
+  realNanosleep = (int (*)( const struct timespec *, struct timespec * )) lookUp( "nanosleep" );
+  realFopen = (FILE *(*)( const char *, const char * )) lookUp( "fopen" );
+  realFclose = (int (*)( FILE * )) lookUp( "fclose" );
+  realFread = (size_t (*)( void *, size_t, size_t, FILE * )) lookUp( "fread" );
+  realFwrite = (size_t (*)( const void *, size_t, size_t, FILE * )) lookUp( "fwrite" );
+  realFseek = (int (*)( FILE *, long, int )) lookUp( "fseek" );
+  realFseeko = (int (*)( FILE *, off_t, int )) lookUp( "fseeko" );
+  realFseeko64 = (int (*)( FILE *, off64_t, int )) lookUp( "fseeko64" );
+  realOpen = (int (*)( const char *, int, ... )) lookUp( "open" );
+  realOpen64 = (int (*)( const char *, int, ... )) lookUp( "open64" );
+  realRead = (ssize_t (*)( int, void *, size_t )) lookUp( "read" );
+  realPread = (ssize_t (*)( int, void *, size_t, off_t )) lookUp( "pread" );
+  realPread64 = (ssize_t (*)( int, void *, size_t, off64_t )) lookUp( "pread64" );
+  realThrow = (void (*)( void *, void *, void (*)( void * ) )) lookUp( "__cxa_throw" );
+  resolving = false;
+}
+
+// backtrace() loads libgcc, which allocates, the first time it's called,
+// so that is done at startup rather than from the audio thread.
+__attribute__((constructor)) static void startUp( void )
+{
+  resolve();
+  void *frames[RTCHECK_FRAMES];
+  backtrace( frames, RTCHECK_FRAMES );
+}
+
+// Count a call to \e call from a marked thread, and report it with a
+// backtrace unless it has been reported from the same place before.
+static void violation( const char *call )
+{
+  violations++;
+  reporting = true;
+
+  void *frames[RTCHECK_FRAMES];
+  int n = backtrace( frames, RTCHECK_FRAMES );
+  // The place is the backtrace from the wrapper's caller on.
+  UINT64 hash = 14695981039346656037ULL;
+  for (int i=2; i<n; i++) {
+    hash ^= (UINT64) (uintptr_t) frames[i];
+    hash *= 1099511628211ULL;
+  }
+  if ( hash == 0 ) hash = 1;
+
+  bool seen = true;
+  for (unsigned int i=0; i<RTCHECK_SITES; i++) {
+    std::atomic<UINT64> &site = sites[(hash + i) % RTCHECK_SITES];
+    UINT64 found = 0;
+    if ( site.compare_exchange_strong( found, hash ) ) {
+      seen = false;
+      break;
+    }
+    if ( found == hash ) break;
+  }
+
+  if ( !seen ) {
+    char line[256];
+    int length = snprintf( line, sizeof(line), "RealtimeCheck: %s() called by %s:\n", call, marked );
+    if ( length > (int) sizeof(line) - 1 ) length = sizeof(line) - 1;
+    if ( write( 2, line, length ) < 0 ) {}
+    if ( n > 2 ) backtrace_symbols_fd( frames + 2, n - 2, 2 );
+  }
+  reporting = false;
+}
+
+// What the wrapped functions call in turn (fopen() allocates, for one)
+// isn't reported as well.
+struct Quiet {
+  bool was;
+  Quiet() : was(reporting) { reporting = true; }
+  ~Quiet() { reporting = was; }
+};
+
+#define CHECK( call ) \
+  if ( marked && !reporting ) violation( call ); \
+  Quiet quiet
+
+#define REAL( ptr ) \
+  if ( ptr == NULL ) resolve()
+
+extern "C" {
+
+void *malloc( size_t size )
+{
+  REAL( realMalloc );
+  if ( realMalloc == NULL ) return bootstrapAlloc( size );
+  CHECK( "malloc" );
+  return realMalloc( size );
+}
+
+void *calloc( size_t n, size_t size )
+{
+  REAL( realCalloc );
+  if ( realCalloc == NULL ) {
+    // The bootstrap space is zeroed already.
+    return bootstrapAlloc( n * size );
+  }
+  CHECK( "calloc" );
+  return realCalloc( n, size );
+}
+
+void *realloc( void *ptr, size_t size )
+{
+  REAL( realRealloc );
+  CHECK( "realloc" );
+  return realRealloc( ptr, size );
+}
+
+void free( void *ptr )
+{
+  if ( ptr == NULL || isBootstrap( ptr ) ) return;
+  REAL( realFree );
+  CHECK( "free" );
+  realFree( ptr );
+}
+
+int posix_memalign( void **ptr, size_t alignment, size_t size )
+{
+  REAL( realPosixMemalign );
+  CHECK( "posix_memalign" );
+  return realPosixMemalign( ptr, alignment, size );
+}
+
+void *aligned_alloc( size_t alignment, size_t size )
+{
+  REAL( realAlignedAlloc );
+  CHECK( "aligned_alloc" );
+  return realAlignedAlloc( alignment, size );
+}
+
+int pthread_mutex_lock( pthread_mutex_t *mutex )
+{
+  REAL( realMutexLock );
+  CHECK( "pthread_mutex_lock" );
+  return realMutexLock( mutex );
+}
+
+int pthread_cond_wait( pthread_cond_t *cond, pthread_mutex_t *mutex )
+{
+  REAL( realCondWait );
+  CHECK( "pthread_cond_wait" );
+  return realCondWait( cond, mutex );
+}
+
+int pthread_cond_timedwait( pthread_cond_t *cond, pthread_mutex_t *mutex, const struct timespec *time )
+{
+  REAL( realCondTimedwait );
+  CHECK( "pthread_cond_timedwait" );
+  return realCondTimedwait( cond, mutex, time );
+}
+
+int usleep( useconds_t usec )
+{
+  REAL( realUsleep );
+  CHECK( "usleep" );
+  return realUsleep( usec );
+}
+
+int nanosleep( const struct timespec *time, struct timespec *left )
+{
+  REAL( realNanosleep );
+  CHECK( "nanosleep" );
+  return realNanosleep( time, left );
+}
+
+FILE *fopen( const char *path, const char *mode )
+{
+  REAL( realFopen );
+  CHECK( "fopen" );
+  return realFopen( path, mode );
+}
+
+int fclose( FILE *file )
+{
+  REAL( realFclose );
+  CHECK( "fclose" );
+  return realFclose( file );
+}
+
+size_t fread( void *ptr, size_t size, size_t n, FILE *file )
+{
+  REAL( realFread );
+  CHECK( "fread" );
+  return realFread( ptr, size, n, file );
+}
+
+size_t fwrite( const void *ptr, size_t size, size_t n, FILE *file )
+{
+  REAL( realFwrite );
+  CHECK( "fwrite" );
+  return realFwrite( ptr, size, n, file );
+}
+
+int fseek( FILE *file, long offset, int whence )
+{
+  REAL( realFseek );
+  CHECK( "fseek" );
+  return realFseek( file, offset, whence );
+}
+
+// WvIn builds with 64-bit file offsets, so its seek64() calls fseeko64().
+int fseeko( FILE *file, off_t offset, int whence )
+{
+  REAL( realFseeko );
+  CHECK( "fseeko" );
+  return realFseeko( file, offset, whence );
+}
+
+int fseeko64( FILE *file, off64_t offset, int whence )
+{
+  REAL( realFseeko64 );
+  CHECK( "fseeko64" );
+  return realFseeko64( file, offset, whence );
+}
+
+// The mode is only passed on when a file may be created.
+int open( const char *path, int flags, ... )
+{
+  mode_t mode = 0;
+  if ( flags & ( O_CREAT | O_TMPFILE ) ) {
+    va_list args;
+    va_start( args, flags );
+    mode = va_arg( args, mode_t );
+    va_end( args );
+  }
+  REAL( realOpen );
+  CHECK( "open" );
+  return realOpen( path, flags, mode );
+}
+
+int open64( const char *path, int flags, ... )
+{
+  mode_t mode = 0;
+  if ( flags & ( O_CREAT | O_TMPFILE ) ) {
+    va_list args;
+    va_start( args, flags );
+    mode = va_arg( args, mode_t );
+    va_end( args );
+  }
+  REAL( realOpen64 );
+  CHECK( "open64" );
+  return realOpen64( path, flags, mode );
+}
+
+ssize_t read( int fd, void *ptr, size_t n )
+{
+  REAL( realRead );
+  CHECK( "read" );
+  return realRead( fd, ptr, n );
+}
+
+ssize_t pread( int fd, void *ptr, size_t n, off_t offset )
+{
+  REAL( realPread );
+  CHECK( "pread" );
+  return realPread( fd, ptr, n, offset );
+}
+
+ssize_t pread64( int fd, void *ptr, size_t n, off64_t offset )
+{
+  REAL( realPread64 );
+  CHECK( "pread64" );
+  return realPread64( fd, ptr, n, offset );
+}
+
+// The exception has been allocated (and reported) already; unwinding
+// may lock and allocate again.
+void __cxa_throw( void *thrown, void *type, void (*destroy)( void * ) )
+{
+  REAL( realThrow );
+  CHECK( "throw" );
+  realThrow( thrown, type, destroy );
+  __builtin_unreachable();
+}
+
+} // extern "C"
+
+void RealtimeCheck :: enter( const char *name )
+{
+  marked = name;
+}
+
+void RealtimeCheck :: leave( void )
+{
+  marked = NULL;
+}
+
+unsigned long RealtimeCheck :: getViolations( void )
+{
+  return violations;
+}
+
+#else
+
+void RealtimeCheck :: enter( const char * )
+{
+}
+
+void RealtimeCheck :: leave( void )
+{
+}
+
+unsigned long RealtimeCheck :: getViolations( void )
+{
+  return 0;
+}
+
+#endif // defined(__RT_CHECK__) && defined(__linux__)
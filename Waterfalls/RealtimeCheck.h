@@ -0,0 +1,40 @@
+/***************************************************/
+/*! \class RealtimeCheck
+    \brief Reports calls which may block from the audio thread.
+
+    The audio callback is marked with enter() and
+    leave().  When built with __RT_CHECK__ defined
+    (make RTCHECK=1, on Linux), the allocator,
+    pthread mutex locks and condition waits, sleeps,
+    file I/O and C++ throws (such as handleError()'s)
+    are wrapped, and any call to one of them from a
+    thread between enter() and leave() is reported to
+    stderr with a backtrace.  Each place they are
+    called from is reported once, and all are
+    counted.  File I/O covers the stdio calls,
+    fseeko(), open(), read() and pread(), with their
+    64-bit versions; pthread_mutex_trylock(), which
+    doesn't wait, isn't reported.  Otherwise enter()
+    and leave() do nothing.
+*/
+/***************************************************/
+
+#if !defined(__REALTIMECHECK_H)
+#define __REALTIMECHECK_H
+
+#include "Stk.h"
+
+class RealtimeCheck : public Stk
+{
+public:
+  //! Mark the calling thread as running \e name, which mustn't block, until leave().
+  static void enter( const char *name );
+
+  //! Unmark the calling thread.
+  static void leave( void );
+
+  //! Return the number of calls which may block made by marked threads so far.
+  static unsigned long getViolations( void );
+};
+
+#endif // defined(__REALTIMECHECK_H)
@@ -0,0 +1,268 @@
+/***************************************************/
+/*! \class Resampler
+    \brief Polyphase windowed-sinc sample rate converter.
+
+    This class changes the rate of a stream of
+    interleaved sample frames by an arbitrary ratio
+    of input to output frames.  Each output sample is
+    the dot product of RESAMPLE_TAPS input samples
+    (more when the rate is reduced) with a
+    Kaiser-windowed sinc filter.  The filter is
+    precomputed for RESAMPLE_PHASES fractional
+    positions and linearly interpolated in between.
+    The dot products use SSE or AVX on x86 processors.
+
+    Frames are passed in with write() and computed
+    with read(), so the caller can feed input in
+    whatever blocks it has.  No memory is allocated
+    except by the constructor and setRatio().
+*/
+/***************************************************/
+
+#include "Resampler.h"
+#include <math.h>
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && defined(__SSE2__)
+  #define __RESAMPLE_X86__
+  #include <immintrin.h>
+  #define AVX __attribute__((target("avx")))
+#endif
+
+#define RESAMPLE_BETA 8.0       // Kaiser window shape, about 80 dB of stopband rejection
+#define RESAMPLE_CUTOFF 0.92    // passband edge relative to the lower Nyquist frequency
+
+// Dot products.  The filter length is always a multiple of 8.
+
+static MY_FLOAT dotScalar( const MY_FLOAT *a, const MY_FLOAT *b, unsigned int n )
+{
+  MY_FLOAT s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+  for (unsigned int i=0; i<n; i+=4) {
+    s0 += a[i] * b[i];
+    s1 += a[i+1] * b[i+1];
+    s2 += a[i+2] * b[i+2];
+    s3 += a[i+3] * b[i+3];
+  }
+  return (s0 + s1) + (s2 + s3);
+}
+
+#if defined(__RESAMPLE_X86__)
+
+static MY_FLOAT dotSse( const MY_FLOAT *a, const MY_FLOAT *b, unsigned int n )
+{
+  __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+  for (unsigned int i=0; i<n; i+=8) {
+    s0 = _mm_add_ps( s0, _mm_mul_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i)) );
+    s1 = _mm_add_ps( s1, _mm_mul_ps(_mm_loadu_ps(a+i+4), _mm_loadu_ps(b+i+4)) );
+  }
+  s0 = _mm_add_ps( s0, s1 );
+  s0 = _mm_add_ps( s0, _mm_movehl_ps(s0, s0) );
+  s0 = _mm_add_ss( s0, _mm_shuffle_ps(s0, s0, 1) );
+  return _mm_cvtss_f32( s0 );
+}
+
+AVX static MY_FLOAT dotAvx( const MY_FLOAT *a, const MY_FLOAT *b, unsigned int n )
+{
+  __m256 s0 = _mm256_setzero_ps();
+  unsigned int i = 0;
+  if ( n >= 16 ) {
+    __m256 s1 = _mm256_setzero_ps();
+    for ( ; i+16<=n; i+=16) {
+      s0 = _mm256_add_ps( s0, _mm256_mul_ps(_mm256_loadu_ps(a+i), _mm256_loadu_ps(b+i)) );
+      s1 = _mm256_add_ps( s1, _mm256_mul_ps(_mm256_loadu_ps(a+i+8), _mm256_loadu_ps(b+i+8)) );
+    }
+    s0 = _mm256_add_ps( s0, s1 );
+  }
+  if ( i < n )
+    s0 = _mm256_add_ps( s0, _mm256_mul_ps(_mm256_loadu_ps(a+i), _mm256_loadu_ps(b+i)) );
+  __m128 s = _mm_add_ps( _mm256_castps256_ps128(s0), _mm256_extractf128_ps(s0, 1) );
+  s = _mm_add_ps( s, _mm_movehl_ps(s, s) );
+  s = _mm_add_ss( s, _mm_shuffle_ps(s, s, 1) );
+  return _mm_cvtss_f32( s );
+}
+
+#endif // defined(__RESAMPLE_X86__)
+
+// Zeroth-order modified Bessel function of the first kind, for the Kaiser window.
+static double bessel0( double x )
+{
+  double sum = 1.0, term = 1.0;
+  for (int k=1; k<50; k++) {
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    sum += term;
+    if ( term < sum * 1.0e-12 ) break;
+  }
+  return sum;
+}
+
+Resampler :: Resampler( unsigned int nChannels, double aRatio )
+  : channels(nChannels), ratio(0.0), cutoff(0.0), taps(0), half(0),
+    filter(0), history(0), capacity(0), fill(0), position(0.0), dropped(0.0)
+{
+  if ( channels == 0 ) channels = 1;
+
+  dot = dotScalar;
+#if defined(__RESAMPLE_X86__)
+  __builtin_cpu_init();
+  if ( __builtin_cpu_supports("avx") ) dot = dotAvx;
+  else dot = dotSse;
+#endif
+
+  setRatio( aRatio );
+  reset();
+}
+
+Resampler :: ~Resampler()
+{
+  if ( filter ) delete [] filter;
+  if ( history ) delete [] history;
+}
+
+void Resampler :: setRatio( double aRatio )
+{
+  if ( aRatio <= 0.0 ) aRatio = 1.0;
+  ratio = aRatio;
+
+  // When the rate is reduced, the cutoff moves down with the output
+  // Nyquist frequency and the filter gets longer to keep its slope.
+  double scale = (ratio > 1.0) ? ratio : 1.0;
+  if ( scale > RESAMPLE_MAX_RATIO ) scale = RESAMPLE_MAX_RATIO;
+  double newCutoff = RESAMPLE_CUTOFF / ((ratio > 1.0) ? ratio : 1.0);
+  if ( newCutoff == cutoff ) return;
+  cutoff = newCutoff;
+
+  unsigned int newTaps = ((unsigned int) ceil(RESAMPLE_TAPS * scale / 8.0)) * 8;
+  if ( newTaps != taps ) {
+    if ( history ) delete [] history;
+    if ( filter ) delete [] filter;
+    taps = newTaps;
+    half = taps / 2;
+    capacity = taps + RESAMPLE_BLOCK;
+    history = new MY_FLOAT[capacity * channels];
+    filter = new MY_FLOAT[(RESAMPLE_PHASES + 1) * taps];
+    reset();
+  }
+
+  makeFilter();
+}
+
+void Resampler :: makeFilter( void )
+{
+  double norm = bessel0( RESAMPLE_BETA );
+  for (unsigned int phase=0; phase<=RESAMPLE_PHASES; phase++) {
+    MY_FLOAT *row = filter + phase*taps;
+    double sum = 0.0;
+    for (unsigned int k=0; k<taps; k++) {
+      // Offset of tap k from the output position.
+      double t = (double) k - (half - 1) - (double) phase / RESAMPLE_PHASES;
+      double x = t / half;
+      double h = 0.0;
+      if ( x > -1.0 && x < 1.0 ) {
+        double arg = PI * cutoff * t;
+        h = (t == 0.0) ? cutoff : cutoff * sin(arg) / arg;
+        h *= bessel0( RESAMPLE_BETA * sqrt(1.0 - x*x) ) / norm;
+      }
+      row[k] = (MY_FLOAT) h;
+      sum += h;
+    }
+
+    // Unity gain at DC for every phase.
+    for (unsigned int k=0; k<taps; k++)
+      row[k] = (MY_FLOAT) (row[k] / sum);
+  }
+}
+
+void Resampler :: reset( double aPosition )
+{
+  fill = 0;
+  dropped = 0.0;
+  position = aPosition;
+
+  // Without enough input before the first output, the filter starts on silence.
+  if ( position < half - 1 ) {
+    unsigned long zeros = (unsigned long) ceil( (half - 1) - position );
+    for (unsigned int j=0; j<channels; j++)
+      memset( history + j*capacity, 0, zeros * sizeof(MY_FLOAT) );
+    fill = zeros;
+    position += zeros;
+    dropped = -(double) zeros;
+  }
+}
+
+unsigned int Resampler :: getHistory( void ) const
+{
+  return half - 1;
+}
+
+double Resampler :: getPosition( void ) const
+{
+  return dropped + position;
+}
+
+unsigned long Resampler :: getSpace( void ) const
+{
+  return capacity - fill;
+}
+
+unsigned long Resampler :: write( const MY_FLOAT *in, unsigned long frames )
+{
+  unsigned long skip = 0;
+  if ( fill == 0 ) {
+    // Input which lies entirely before the filter of the next output
+    // (possible at large ratios) is not needed.
+    double first = floor( position ) - (half - 1);
+    if ( first > 0.0 ) {
+      skip = (first < frames) ? (unsigned long) first : frames;
+      position -= skip;
+      dropped += skip;
+      in += skip * channels;
+    }
+  }
+
+  unsigned long n = frames - skip;
+  if ( n > capacity - fill ) n = capacity - fill;
+  for (unsigned int j=0; j<channels; j++) {
+    MY_FLOAT *dst = history + j*capacity + fill;
+    const MY_FLOAT *src = in + j;
+    for (unsigned long i=0; i<n; i++, src+=channels)
+      dst[i] = *src;
+  }
+  fill += n;
+
+  return skip + n;
+}
+
+unsigned long Resampler :: read( MY_FLOAT *out, unsigned long frames )
+{
+  unsigned long i;
+  for (i=0; i<frames; i++) {
+    unsigned long index = (unsigned long) position;
+    unsigned long base = index - (half - 1);
+    if ( base + taps > fill ) break;
+
+    double phase = (position - index) * RESAMPLE_PHASES;
+    unsigned int row = (unsigned int) phase;
+    MY_FLOAT alpha = (MY_FLOAT) (phase - row);
+    const MY_FLOAT *h = filter + row*taps;
+    for (unsigned int j=0; j<channels; j++) {
+      const MY_FLOAT *x = history + j*capacity + base;
+      MY_FLOAT a = dot( x, h, taps );
+      MY_FLOAT b = dot( x, h + taps, taps );
+      *out++ = a + alpha * (b - a);
+    }
+    position += ratio;
+  }
+
+  // Drop the input the filter no longer reaches.
+  double first = floor( position ) - (half - 1);
+  if ( first > 0.0 ) {
+    unsigned long drop = (first < fill) ? (unsigned long) first : fill;
+    for (unsigned int j=0; j<channels; j++)
+      memmove( history + j*capacity, history + j*capacity + drop, (fill - drop) * sizeof(MY_FLOAT) );
+    fill -= drop;
+    position -= drop;
+    dropped += drop;
+  }
+
+  return i;
+}
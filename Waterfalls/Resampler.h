@@ -0,0 +1,98 @@
+/***************************************************/
+/*! \class Resampler
+    \brief Polyphase windowed-sinc sample rate converter.
+
+    This class changes the rate of a stream of
+    interleaved sample frames by an arbitrary ratio
+    of input to output frames.  Each output sample is
+    the dot product of RESAMPLE_TAPS input samples
+    (more when the rate is reduced) with a
+    Kaiser-windowed sinc filter.  The filter is
+    precomputed for RESAMPLE_PHASES fractional
+    positions and linearly interpolated in between.
+    The dot products use SSE or AVX on x86 processors.
+
+    Frames are passed in with write() and computed
+    with read(), so the caller can feed input in
+    whatever blocks it has.  No memory is allocated
+    except by the constructor and setRatio().
+*/
+/***************************************************/
+
+#if !defined(__RESAMPLER_H)
+#define __RESAMPLER_H
+
+#define RESAMPLE_TAPS 64        // filter length in input samples, at ratios <= 1
+#define RESAMPLE_PHASES 256     // precomputed fractional positions
+#define RESAMPLE_BLOCK 1024     // input frames buffered beyond the filter length
+#define RESAMPLE_MAX_RATIO 4.0  // largest ratio with full anti-aliasing
+
+#include "Stk.h"
+
+class Resampler : public Stk
+{
+public:
+  //! Class constructor for \e nChannels channels and an input/output frame \e ratio.
+  Resampler( unsigned int nChannels = 1, double ratio = 1.0 );
+
+  //! Class destructor.
+  ~Resampler();
+
+  //! Set the number of input frames per output frame.
+  /*!
+    The filter is recomputed if its cutoff changes.  If its length
+    changes too, it is reallocated and the buffered input is
+    discarded, as by reset().
+  */
+  void setRatio( double ratio );
+
+  //! Discard all buffered input and set the position of the next output.
+  /*!
+    The position is counted in input frames, from the first frame
+    written after the reset.  To start output at input frame \e t
+    (with fraction), write input from frame floor(\e t) -
+    getHistory() and reset to getHistory() + the fraction.
+  */
+  void reset( double position = 0.0 );
+
+  //! Return the number of input frames the filter uses before the output position.
+  unsigned int getHistory( void ) const;
+
+  //! Return the position of the next output, in input frames since the last reset.
+  double getPosition( void ) const;
+
+  //! Return the number of input frames which can be written now.
+  unsigned long getSpace( void ) const;
+
+  //! Buffer up to \e frames interleaved input frames from \e in.  Return the number taken.
+  unsigned long write( const MY_FLOAT *in, unsigned long frames );
+
+  //! Compute up to \e frames interleaved output frames into \e out.
+  /*!
+    Returns the number of frames computed, which is less than
+    \e frames when more input is needed.
+  */
+  unsigned long read( MY_FLOAT *out, unsigned long frames );
+
+protected:
+
+  // Compute the filter table for the current ratio.
+  void makeFilter( void );
+
+  typedef MY_FLOAT (*DOT_KERNEL)( const MY_FLOAT *a, const MY_FLOAT *b, unsigned int n );
+
+  unsigned int channels;
+  double ratio;
+  double cutoff;
+  unsigned int taps;
+  unsigned int half;
+  MY_FLOAT *filter;       // (RESAMPLE_PHASES+1) rows of taps coefficients
+  MY_FLOAT *history;      // one row of capacity frames per channel
+  unsigned long capacity;
+  unsigned long fill;
+  double position;
+  double dropped;
+  DOT_KERNEL dot;
+};
+
+#endif // defined(__RESAMPLER_H)
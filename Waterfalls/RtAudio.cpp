@@ -42,6 +42,7 @@
 
 #include "RtAudio.h"
 #include <iostream>
+#include <fstream>
 #include <cstdlib>
 #include <cstring>
 #include <climits>
@@ -106,6 +107,10 @@ void RtAudio :: getCompiledApi( std::vector<RtAudio::Api> &apis ) throw()
 
 void RtAudio :: openRtApi( RtAudio::Api api )
 {
+  if ( rtapi_ )
+    delete rtapi_;
+  rtapi_ = 0;
+
 #if defined(__UNIX_JACK__)
   if ( api == UNIX_JACK )
     rtapi_ = new RtApiJack();
@@ -201,6 +206,9 @@ RtApi :: RtApi()
   stream_.userBuffer[1] = 0;
   MUTEX_INITIALIZE( &stream_.mutex );
   showWarnings_ = true;
+  cacheValid_ = false;
+  lastDevice_[0] = -1;
+  lastDevice_[1] = -1;
 }
 
 RtApi :: ~RtApi()
@@ -284,6 +292,15 @@ void RtApi :: openStream( RtAudio::StreamParameters *oParams,
 
   if ( options ) options->numberOfBuffers = stream_.nBuffers;
   stream_.state = STREAM_STOPPED;
+
+  // Remember the devices, so that they can be opened straight away next time.
+  int output = ( oChannels > 0 ) ? (int) oParams->deviceId : -1;
+  int input = ( iChannels > 0 ) ? (int) iParams->deviceId : -1;
+  if ( cacheIsCurrent() && ( output != lastDevice_[0] || input != lastDevice_[1] ) ) {
+    lastDevice_[0] = output;
+    lastDevice_[1] = input;
+    writeDeviceCache();
+  }
 }
 
 unsigned int RtApi :: getDefaultInputDevice( void )
@@ -313,6 +330,159 @@ bool RtApi :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigned in
   return FAILURE;
 }
 
+// Hash a device signature, to keep in the cache file in its place.
+static std::string hashSignature( const std::string &signature )
+{
+  // 64-bit FNV-1a.
+  unsigned long long hash = 14695981039346656037ULL;
+  for ( unsigned int i=0; i<signature.size(); i++ ) {
+    hash ^= (unsigned char) signature[i];
+    hash *= 1099511628211ULL;
+  }
+  std::ostringstream text;
+  text << std::hex << hash;
+  return text.str();
+}
+
+void RtApi :: setDeviceCache( const std::string &fileName )
+{
+  cacheFile_ = fileName;
+  cacheValid_ = false;
+  cache_.clear();
+  lastDevice_[0] = -1;
+  lastDevice_[1] = -1;
+
+  std::string signature = deviceSignature();
+  if ( signature.empty() ) return;
+  std::ifstream file( fileName.c_str() );
+  if ( !file ) return;
+
+  // The header lines, then three lines for each device: the name it is
+  // opened by, the numbers of its DeviceInfo, and its descriptive name.
+  std::string line, word;
+  int api = -1;
+  unsigned int nDevices = 0;
+  std::getline( file, line );
+  if ( line != "RtAudio device cache 1" ) return;
+  file >> word >> api >> word >> cacheSignature_ >> word >> lastDevice_[0] >> lastDevice_[1] >> word >> nDevices;
+  std::getline( file, line );
+  if ( !file || api != (int) getCurrentApi() || cacheSignature_ != hashSignature( signature ) ) return;
+
+  cache_.resize( nDevices );
+  for ( unsigned int i=0; i<nDevices && file; i++ ) {
+    RtAudio::DeviceInfo &info = cache_[i].info;
+    unsigned int nRates = 0;
+    std::getline( file, cache_[i].id );
+    std::getline( file, line );
+    std::istringstream numbers( line );
+    numbers >> info.probed >> info.outputChannels >> info.inputChannels >> info.duplexChannels
+            >> info.isDefaultOutput >> info.isDefaultInput >> info.nativeFormats >> nRates;
+    info.sampleRates.resize( nRates );
+    for ( unsigned int j=0; j<nRates; j++ ) numbers >> info.sampleRates[j];
+    if ( !numbers ) file.setstate( std::ios::failbit );
+    std::getline( file, info.name );
+  }
+
+  cacheValid_ = file && lastDevice_[0] < (int) nDevices && lastDevice_[1] < (int) nDevices;
+  if ( !cacheValid_ ) {
+    cache_.clear();
+    lastDevice_[0] = -1;
+    lastDevice_[1] = -1;
+  }
+}
+
+bool RtApi :: getLastDevices( unsigned int *output, unsigned int *input )
+{
+  if ( !cacheIsCurrent() || ( lastDevice_[0] < 0 && lastDevice_[1] < 0 ) ) return false;
+  *output = ( lastDevice_[0] >= 0 ) ? lastDevice_[0] : getDefaultOutputDevice();
+  *input = ( lastDevice_[1] >= 0 ) ? lastDevice_[1] : getDefaultInputDevice();
+  return true;
+}
+
+std::string RtApi :: deviceSignature( void )
+{
+  // Should be implemented in subclasses which keep a device cache.
+  return std::string();
+}
+
+bool RtApi :: cacheIsCurrent( void )
+{
+  if ( !cacheValid_ ) return false;
+  if ( hashSignature( deviceSignature() ) != cacheSignature_ ) {
+    // The devices have changed: probe them again.
+    cacheValid_ = false;
+    cache_.clear();
+    lastDevice_[0] = -1;
+    lastDevice_[1] = -1;
+  }
+  return cacheValid_;
+}
+
+void RtApi :: storeDeviceCache( const std::vector<RtAudio::DeviceInfo> &devices,
+                                const std::vector<std::string> &ids )
+{
+  std::string signature = deviceSignature();
+  if ( cacheFile_.empty() || signature.empty() || devices.size() != ids.size() ) return;
+
+  cache_.resize( devices.size() );
+  for ( unsigned int i=0; i<devices.size(); i++ ) {
+    cache_[i].info = devices[i];
+    cache_[i].id = ids[i];
+  }
+  cacheSignature_ = hashSignature( signature );
+  cacheValid_ = true;
+  lastDevice_[0] = -1;
+  lastDevice_[1] = -1;
+  writeDeviceCache();
+}
+
+void RtApi :: probeDeviceCache( void )
+{
+  if ( cacheFile_.empty() || cacheIsCurrent() ) return;
+
+  // Probe each device once, keeping it under its name.
+  std::vector<RtAudio::DeviceInfo> devices;
+  std::vector<std::string> ids;
+  try {
+    unsigned int nDevices = getDeviceCount();
+    for ( unsigned int i=0; i<nDevices; i++ ) {
+      devices.push_back( getDeviceInfo( i ) );
+      ids.push_back( devices[i].name );
+    }
+  }
+  catch ( RtError & ) {
+    // The devices changed while they were probed: try again next time.
+    return;
+  }
+  storeDeviceCache( devices, ids );
+}
+
+void RtApi :: writeDeviceCache( void )
+{
+  std::ofstream file( cacheFile_.c_str() );
+  file << "RtAudio device cache 1\n";
+  file << "api " << (int) getCurrentApi() << "\n";
+  file << "signature " << cacheSignature_ << "\n";
+  file << "last " << lastDevice_[0] << " " << lastDevice_[1] << "\n";
+  file << "devices " << cache_.size() << "\n";
+  for ( unsigned int i=0; i<cache_.size(); i++ ) {
+    RtAudio::DeviceInfo &info = cache_[i].info;
+    file << cache_[i].id << "\n";
+    file << info.probed << " " << info.outputChannels << " " << info.inputChannels << " "
+         << info.duplexChannels << " " << info.isDefaultOutput << " " << info.isDefaultInput << " "
+         << info.nativeFormats << " " << info.sampleRates.size();
+    for ( unsigned int j=0; j<info.sampleRates.size(); j++ )
+      file << " " << info.sampleRates[j];
+    file << "\n" << info.name << "\n";
+  }
+
+  file.close();
+  if ( !file ) {
+    errorText_ = "RtApi::writeDeviceCache: unable to write the device cache (" + cacheFile_ + ").";
+    error( RtError::WARNING );
+  }
+}
+
 void RtApi :: tickStreamTime( void )
 {
   // Subclasses that do not provide their own implementation of
@@ -339,6 +509,15 @@ long RtApi :: getStreamLatency( void )
   return totalLatency;
 }
 
+long RtApi :: getOutputLatency( void )
+{
+  verifyStream();
+
+  if ( stream_.mode == OUTPUT || stream_.mode == DUPLEX )
+    return stream_.latency[0];
+  return 0;
+}
+
 double RtApi :: getStreamTime( void )
 {
   verifyStream();
@@ -525,6 +704,10 @@ RtAudio::DeviceInfo RtApiCore :: getDeviceInfo( unsigned int device )
   RtAudio::DeviceInfo info;
   info.probed = false;
 
+  // A current cache has what a probe would find, without asking the device.
+  if ( cacheIsCurrent() && device < cache_.size() && cache_[device].info.probed )
+    return cache_[device].info;
+
   // Get device ID
   unsigned int nDevices = getDeviceCount();
   if ( nDevices == 0 ) {
@@ -773,11 +956,54 @@ OSStatus rateListener( AudioObjectID inDevice,
   return kAudioHardwareNoError;
 }
 
+std::string RtApiCore :: deviceSignature( void )
+{
+  // The devices' unique IDs, in the order they are numbered, and the
+  // defaults, none of which needs a device to be asked.
+  UInt32 dataSize = 0;
+  AudioObjectPropertyAddress property = { kAudioHardwarePropertyDevices, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMaster };
+  if ( AudioObjectGetPropertyDataSize( kAudioObjectSystemObject, &property, 0, NULL, &dataSize ) != noErr )
+    return std::string();
+  unsigned int nDevices = dataSize / sizeof( AudioDeviceID );
+  if ( nDevices == 0 ) return std::string();
+  std::vector<AudioDeviceID> deviceList( nDevices );
+  if ( AudioObjectGetPropertyData( kAudioObjectSystemObject, &property, 0, NULL, &dataSize, (void *) &deviceList[0] ) != noErr )
+    return std::string();
+  nDevices = dataSize / sizeof( AudioDeviceID );
+
+  std::ostringstream text;
+  property.mSelector = kAudioDevicePropertyDeviceUID;
+  for ( unsigned int i=0; i<nDevices; i++ ) {
+    CFStringRef uid;
+    char name[256];
+    dataSize = sizeof( CFStringRef );
+    if ( AudioObjectGetPropertyData( deviceList[i], &property, 0, NULL, &dataSize, &uid ) != noErr )
+      return std::string();
+    if ( !CFStringGetCString( uid, name, sizeof(name), kCFStringEncodingUTF8 ) ) name[0] = '\0';
+    CFRelease( uid );
+    text << name << "\n";
+  }
+
+  AudioDeviceID id;
+  dataSize = sizeof( AudioDeviceID );
+  property.mSelector = kAudioHardwarePropertyDefaultOutputDevice;
+  if ( AudioObjectGetPropertyData( kAudioObjectSystemObject, &property, 0, NULL, &dataSize, &id ) == noErr )
+    text << "output " << id << "\n";
+  dataSize = sizeof( AudioDeviceID );
+  property.mSelector = kAudioHardwarePropertyDefaultInputDevice;
+  if ( AudioObjectGetPropertyData( kAudioObjectSystemObject, &property, 0, NULL, &dataSize, &id ) == noErr )
+    text << "input " << id << "\n";
+  return text.str();
+}
+
 bool RtApiCore :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigned int channels,
                                    unsigned int firstChannel, unsigned int sampleRate,
                                    RtAudioFormat format, unsigned int *bufferSize,
                                    RtAudio::StreamOptions *options )
 {
+  // Keep the devices found, so that they needn't be probed next time.
+  probeDeviceCache();
+
   // Get device ID
   unsigned int nDevices = getDeviceCount();
   if ( nDevices == 0 ) {
@@ -1833,6 +2059,8 @@ RtApiJack :: ~RtApiJack()
 
 unsigned int RtApiJack :: getDeviceCount( void )
 {
+  if ( cacheIsCurrent() ) return cache_.size();
+
   // See if we can become a jack client.
   jack_options_t options = (jack_options_t) ( JackNoStartServer ); //JackNullOption;
   jack_status_t *status = NULL;
@@ -1869,6 +2097,10 @@ RtAudio::DeviceInfo RtApiJack :: getDeviceInfo( unsigned int device )
   RtAudio::DeviceInfo info;
   info.probed = false;
 
+  // A current cache has what a probe would find, without asking the server again.
+  if ( cacheIsCurrent() && device < cache_.size() && cache_[device].info.probed )
+    return cache_[device].info;
+
   jack_options_t options = (jack_options_t) ( JackNoStartServer ); //JackNullOption
   jack_status_t *status = NULL;
   jack_client_t *client = jack_client_open( "RtApiJackInfo", options, status );
@@ -1953,6 +2185,28 @@ RtAudio::DeviceInfo RtApiJack :: getDeviceInfo( unsigned int device )
   return info;
 }
 
+std::string RtApiJack :: deviceSignature( void )
+{
+  // The server's sample rate and its ports, which change whenever a
+  // client (device) or its channels do.
+  jack_options_t options = (jack_options_t) ( JackNoStartServer );
+  jack_status_t *status = NULL;
+  jack_client_t *client = jack_client_open( "RtApiJackSignature", options, status );
+  if ( client == 0 ) return std::string();
+
+  std::ostringstream text;
+  text << jack_get_sample_rate( client ) << "\n";
+  const char **ports = jack_get_ports( client, NULL, NULL, 0 );
+  if ( ports ) {
+    for ( unsigned int i=0; ports[i]; i++ )
+      text << ports[i] << " " << jack_port_flags( jack_port_by_name( client, ports[i] ) ) << "\n";
+    free( ports );
+  }
+
+  jack_client_close( client );
+  return text.str();
+}
+
 int jackCallbackHandler( jack_nframes_t nframes, void *infoPointer )
 {
   CallbackInfo *info = (CallbackInfo *) infoPointer;
@@ -2009,6 +2263,9 @@ bool RtApiJack :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
 {
   JackHandle *handle = (JackHandle *) stream_.apiHandle;
 
+  // Keep the devices found, so that they needn't be probed next time.
+  probeDeviceCache();
+
   // Look for jack server and try to become a client (only do once per stream).
   jack_client_t *client = 0;
   if ( mode == OUTPUT || ( mode == INPUT && stream_.mode != OUTPUT ) ) {
@@ -5171,6 +5428,8 @@ RtApiAlsa :: ~RtApiAlsa()
 
 unsigned int RtApiAlsa :: getDeviceCount( void )
 {
+  if ( cacheIsCurrent() ) return cache_.size();
+
   unsigned nDevices = 0;
   int result, subdevice, card;
   char name[64];
@@ -5214,6 +5473,10 @@ RtAudio::DeviceInfo RtApiAlsa :: getDeviceInfo( unsigned int device )
   RtAudio::DeviceInfo info;
   info.probed = false;
 
+  // A current cache has what a probe would find, without opening the device.
+  if ( cacheIsCurrent() && device < cache_.size() && cache_[device].info.probed )
+    return cache_[device].info;
+
   unsigned nDevices = 0;
   int result, subdevice, card;
   char name[64];
@@ -5474,10 +5737,49 @@ void RtApiAlsa :: saveDeviceInfo( void )
 {
   devices_.clear();
 
+  if ( cacheIsCurrent() ) {
+    for ( unsigned int i=0; i<cache_.size(); i++ )
+      devices_.push_back( cache_[i].info );
+    return;
+  }
+
   unsigned int nDevices = getDeviceCount();
   devices_.resize( nDevices );
   for ( unsigned int i=0; i<nDevices; i++ )
     devices_[i] = getDeviceInfo( i );
+
+  if ( cacheFile_.empty() ) return;
+
+  // Keep what was found, with the names the devices are opened by.
+  std::vector<std::string> ids;
+  int result, subdevice, card = -1;
+  char name[64];
+  snd_ctl_t *chandle;
+  snd_card_next( &card );
+  while ( card >= 0 ) {
+    sprintf( name, "hw:%d", card );
+    if ( snd_ctl_open( &chandle, name, SND_CTL_NONBLOCK ) >= 0 ) {
+      subdevice = -1;
+      while ( 1 ) {
+        result = snd_ctl_pcm_next_device( chandle, &subdevice );
+        if ( result < 0 || subdevice < 0 ) break;
+        sprintf( name, "hw:%d,%d", card, subdevice );
+        ids.push_back( name );
+      }
+      snd_ctl_close( chandle );
+    }
+    snd_card_next( &card );
+  }
+  storeDeviceCache( devices_, ids );
+}
+
+std::string RtApiAlsa :: deviceSignature( void )
+{
+  // The kernel's list of cards and their pcm devices, which is cheap to read.
+  std::ifstream file( "/proc/asound/pcm" );
+  std::ostringstream text;
+  if ( !file || !( text << file.rdbuf() ) ) return std::string();
+  return text.str();
 }
 
 bool RtApiAlsa :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigned int channels,
@@ -5500,6 +5802,8 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
 
   if ( options && options->flags & RTAUDIO_ALSA_USE_DEFAULT )
     snprintf(name, sizeof(name), "%s", "default");
+  else if ( cacheIsCurrent() && device < cache_.size() )
+    snprintf(name, sizeof(name), "%s", cache_[device].id.c_str());
   else {
     // Count cards and devices
     card = -1;
@@ -385,6 +385,30 @@ class RtAudio
   */
   unsigned int getDefaultInputDevice( void ) throw();
 
+  //! Keep the device capabilities in the file \e fileName and use them while they are current.
+  /*!
+    Probing every device can take a noticeable time on systems with
+    many cards.  Once a cache file is set, getDeviceCount(),
+    getDeviceInfo() and openStream() take the devices from it for as
+    long as the system's device list is the same as when it was
+    written, which is checked cheaply on each call.  When it is not,
+    the devices are probed once more, as without a cache, and the
+    file is rewritten.  The file also records the devices of the last
+    stream opened (see getLastDevices()).  The ALSA, JACK and
+    CoreAudio APIs keep a cache; with the others, this function does
+    nothing.  A warning is issued if the file cannot be written.
+  */
+  void setDeviceCache( const std::string &fileName );
+
+  //! Find the output and input devices of the last stream opened, from the device cache.
+  /*!
+    Returns false if there is no current cache (see
+    setDeviceCache()), or no stream has been opened with it.  A device
+    which the stream did not use is returned as the default device.
+    Opening these devices needs no probing beyond the devices themselves.
+  */
+  bool getLastDevices( unsigned int *output, unsigned int *input );
+
   //! A public function for opening a stream with the specified parameters.
   /*!
     An RtError (type = SYSTEM_ERROR) is thrown if a stream cannot be
@@ -486,6 +510,16 @@ class RtAudio
   */
   long getStreamLatency( void );
 
+  //! Returns the output latency of the stream in sample frames.
+  /*!
+    This is the delay between a buffer being filled by the callback
+    and it being heard, without the input latency of a duplex stream.
+    If a stream is not open, an RtError (type = INVALID_USE) will be
+    thrown.  If the API does not report latency, or the stream has no
+    output, the return value will be zero.
+  */
+  long getOutputLatency( void );
+
  //! Returns actual sample rate in use by the stream.
  /*!
    On some systems, the sample rate used may be slightly different
@@ -583,11 +617,14 @@ public:
   virtual void stopStream( void ) = 0;
   virtual void abortStream( void ) = 0;
   long getStreamLatency( void );
+  long getOutputLatency( void );
   unsigned int getStreamSampleRate( void );
   virtual double getStreamTime( void );
   bool isStreamOpen( void ) const { return stream_.state != STREAM_CLOSED; };
   bool isStreamRunning( void ) const { return stream_.state == STREAM_RUNNING; };
   void showWarnings( bool value ) { showWarnings_ = value; };
+  void setDeviceCache( const std::string &fileName );
+  bool getLastDevices( unsigned int *output, unsigned int *input );
 
 
 protected:
@@ -658,10 +695,21 @@ protected:
   typedef float Float32;
   typedef double Float64;
 
+  // A protected structure for a device kept in the device cache.
+  struct CachedDevice {
+    RtAudio::DeviceInfo info;
+    std::string id;            // API-specific name the device is opened by
+  };
+
   std::ostringstream errorStream_;
   std::string errorText_;
   bool showWarnings_;
   RtApiStream stream_;
+  std::string cacheFile_;
+  std::string cacheSignature_;    // the device list the cache was made from
+  std::vector<CachedDevice> cache_;
+  bool cacheValid_;
+  int lastDevice_[2];             // of the last stream opened, or -1
 
   /*!
     Protected, api-specific method that attempts to open a device
@@ -675,6 +723,26 @@ protected:
                                 RtAudioFormat format, unsigned int *bufferSize,
                                 RtAudio::StreamOptions *options );
 
+  /*!
+    Protected, api-specific method that returns a summary of the
+    devices present which is cheap to get and changes whenever they
+    do, or an empty string if the api keeps no device cache.
+  */
+  virtual std::string deviceSignature( void );
+
+  //! Protected common method that returns true if the device cache matches the devices present.
+  bool cacheIsCurrent( void );
+
+  //! Protected common method that replaces the device cache with freshly probed devices.
+  void storeDeviceCache( const std::vector<RtAudio::DeviceInfo> &devices,
+                         const std::vector<std::string> &ids );
+
+  //! Protected common method that probes every device into the device cache, unless it is current.
+  void probeDeviceCache( void );
+
+  //! Protected common method that writes the device cache to its file.
+  void writeDeviceCache( void );
+
   //! A protected function used to increment the stream time.
   void tickStreamTime( void );
 
@@ -724,9 +792,12 @@ inline void RtAudio :: abortStream( void ) { return rtapi_->abortStream(); }
 inline bool RtAudio :: isStreamOpen( void ) const throw() { return rtapi_->isStreamOpen(); }
 inline bool RtAudio :: isStreamRunning( void ) const throw() { return rtapi_->isStreamRunning(); }
 inline long RtAudio :: getStreamLatency( void ) { return rtapi_->getStreamLatency(); }
+inline long RtAudio :: getOutputLatency( void ) { return rtapi_->getOutputLatency(); }
 inline unsigned int RtAudio :: getStreamSampleRate( void ) { return rtapi_->getStreamSampleRate(); };
 inline double RtAudio :: getStreamTime( void ) { return rtapi_->getStreamTime(); }
 inline void RtAudio :: showWarnings( bool value ) throw() { rtapi_->showWarnings( value ); }
+inline void RtAudio :: setDeviceCache( const std::string &fileName ) { rtapi_->setDeviceCache( fileName ); }
+inline bool RtAudio :: getLastDevices( unsigned int *output, unsigned int *input ) { return rtapi_->getLastDevices( output, input ); }
 
 // RtApi Subclass prototypes.
 
@@ -761,6 +832,7 @@ public:
 
   private:
 
+  std::string deviceSignature( void );
   bool probeDeviceOpen( unsigned int device, StreamMode mode, unsigned int channels, 
                         unsigned int firstChannel, unsigned int sampleRate,
                         RtAudioFormat format, unsigned int *bufferSize,
@@ -795,6 +867,7 @@ public:
 
   private:
 
+  std::string deviceSignature( void );
   bool probeDeviceOpen( unsigned int device, StreamMode mode, unsigned int channels, 
                         unsigned int firstChannel, unsigned int sampleRate,
                         RtAudioFormat format, unsigned int *bufferSize,
@@ -903,6 +976,7 @@ public:
 
   std::vector<RtAudio::DeviceInfo> devices_;
   void saveDeviceInfo( void );
+  std::string deviceSignature( void );
   bool probeDeviceOpen( unsigned int device, StreamMode mode, unsigned int channels, 
                         unsigned int firstChannel, unsigned int sampleRate,
                         RtAudioFormat format, unsigned int *bufferSize,
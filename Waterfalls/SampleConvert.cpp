@@ -0,0 +1,464 @@
+/***************************************************/
+/*! \class SampleConvert
+    \brief Block sample format conversion kernels.
+
+    This class provides the loops that byte-swap
+    sample data and convert it to MY_FLOAT, scaled
+    by a gain.  On x86 processors, SSE2 or AVX2
+    versions are chosen at runtime depending on what
+    the processor supports; elsewhere plain C++ loops
+    are used.  All versions give the same results.
+
+    8-bit data is taken to be signed.
+*/
+/***************************************************/
+
+#include "SampleConvert.h"
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && defined(__SSE2__)
+  #define __CONVERT_X86__
+  #include <immintrin.h>
+  #define AVX2 __attribute__((target("avx2")))
+#endif
+
+typedef void (*CONVERT_KERNEL)( const void *in, bool doSwap, MY_FLOAT gain, MY_FLOAT *out, unsigned long n );
+typedef void (*SWAP_KERNEL)( void *data, unsigned long n );
+
+struct ConvertKernels {
+  const char *name;
+  CONVERT_KERNEL sint8, sint16, sint24, sint32, float32, float64;
+  SWAP_KERNEL swap16, swap32, swap64;
+};
+
+// Plain loops, also used for the samples left over by the vector loops.
+
+template <class T>
+static void convertScalar( const void *in, bool doSwap, MY_FLOAT gain, MY_FLOAT *out, unsigned long n )
+{
+  const T *src = (const T *) in;
+  for (unsigned long i=0; i<n; i++) {
+    T x = src[i];
+    if ( doSwap ) {
+      if ( sizeof(T) == 2 ) Stk::swap16( (unsigned char *) &x );
+      else if ( sizeof(T) == 4 ) Stk::swap32( (unsigned char *) &x );
+      else if ( sizeof(T) == 8 ) Stk::swap64( (unsigned char *) &x );
+    }
+    out[i] = gain * (MY_FLOAT) x;
+  }
+}
+
+// Packed 24-bit samples are assembled into the top of a 32-bit word,
+// then shifted down to extend the sign.
+static inline SINT32 sint24( const unsigned char *p, bool bigEndian )
+{
+  if ( bigEndian ) return (SINT32) (((UINT32) p[0] << 24) | ((UINT32) p[1] << 16) | ((UINT32) p[2] << 8)) >> 8;
+  return (SINT32) (((UINT32) p[2] << 24) | ((UINT32) p[1] << 16) | ((UINT32) p[0] << 8)) >> 8;
+}
+
+// Whether 24-bit data which is (not) to be swapped is big-endian.
+static inline bool bigEndian24( bool doSwap )
+{
+#ifdef __LITTLE_ENDIAN__
+  return doSwap;
+#else
+  return !doSwap;
+#endif
+}
+
+static void convertSint24Scalar( const void *in, bool doSwap, MY_FLOAT gain, MY_FLOAT *out, unsigned long n )
+{
+  const unsigned char *src = (const unsigned char *) in;
+  bool big = bigEndian24( doSwap );
+  for (unsigned long i=0; i<n; i++, src+=3)
+    out[i] = gain * (MY_FLOAT) sint24( src, big );
+}
+
+static void swap16Scalar( void *data, unsigned long n )
+{
+  unsigned char *ptr = (unsigned char *) data;
+  for (unsigned long i=0; i<n; i++, ptr+=2) Stk::swap16( ptr );
+}
+
+static void swap32Scalar( void *data, unsigned long n )
+{
+  unsigned char *ptr = (unsigned char *) data;
+  for (unsigned long i=0; i<n; i++, ptr+=4) Stk::swap32( ptr );
+}
+
+static void swap64Scalar( void *data, unsigned long n )
+{
+  unsigned char *ptr = (unsigned char *) data;
+  for (unsigned long i=0; i<n; i++, ptr+=8) Stk::swap64( ptr );
+}
+
+static void swap24Scalar( void *data, unsigned long n )
+{
+  unsigned char *ptr = (unsigned char *) data;
+  for (unsigned long i=0; i<n; i++, ptr+=3) {
+    unsigned char x = ptr[0];
+    ptr[0] = ptr[2];
+    ptr[2] = x;
+  }
+}
+
+static const ConvertKernels scalarKernels = {
+  "scalar",
+  convertScalar<signed char>, convertScalar<SINT16>, convertSint24Scalar, convertScalar<SINT32>,
+  convertScalar<FLOAT32>, convertScalar<FLOAT64>,
+  swap16Scalar, swap32Scalar, swap64Scalar
+};
+
+#if defined(__CONVERT_X86__)
+
+// SSE2 versions.  SSE2 has no byte shuffle, so bytes are swapped with
+// shifts and word shuffles.
+
+static inline __m128i swap16Sse2( __m128i v )
+{
+  return _mm_or_si128( _mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8) );
+}
+
+static inline __m128i swap32Sse2( __m128i v )
+{
+  v = swap16Sse2( v );
+  return _mm_shufflehi_epi16( _mm_shufflelo_epi16(v, _MM_SHUFFLE(2,3,0,1)), _MM_SHUFFLE(2,3,0,1) );
+}
+
+static inline __m128i swap64Sse2( __m128i v )
+{
+  return _mm_shuffle_epi32( swap32Sse2(v), _MM_SHUFFLE(2,3,0,1) );
+}
+
+static void convertSint8Sse2( const void *in, bool doSwap, MY_FLOAT gain, MY_FLOAT *out, unsigned long n )
+{
+  const signed char *src = (const signed char *) in;
+  __m128 g = _mm_set1_ps( gain );
+  unsigned long i;
+  for (i=0; i+16<=n; i+=16) {
+    __m128i v = _mm_loadu_si128( (const __m128i *) (src+i) );
+    __m128i lo = _mm_srai_epi16( _mm_unpacklo_epi8(v, v), 8 );
+    __m128i hi = _mm_srai_epi16( _mm_unpackhi_epi8(v, v), 8 );
+    _mm_storeu_ps( out+i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(lo, lo), 16)), g) );
+    _mm_storeu_ps( out+i+4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(lo, lo), 16)), g) );
+    _mm_storeu_ps( out+i+8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(hi, hi), 16)), g) );
+    _mm_storeu_ps( out+i+12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(hi, hi), 16)), g) );
+  }
+  convertScalar<signed char>( src+i, doSwap, gain, out+i, n-i );
+}
+
+static void convertSint16Sse2( const void *in, bool doSwap, MY_FLOAT gain, MY_FLOAT *out, unsigned long n )
+{
+  const SINT16 *src = (const SINT16 *) in;
+  __m128 g = _mm_set1_ps( gain );
+  unsigned long i;
+  for (i=0; i+8<=n; i+=8) {
+    __m128i v = _mm_loadu_si128( (const __m128i *) (src+i) );
+    if ( doSwap ) v = swap16Sse2( v );
+    __m128i lo = _mm_srai_epi32( _mm_unpacklo_epi16(v, v), 16 );
+    __m128i hi = _mm_srai_epi32( _mm_unpackhi_epi16(v, v), 16 );
+    _mm_storeu_ps( out+i, _mm_mul_ps(_mm_cvtepi32_ps(lo), g) );
+    _mm_storeu_ps( out+i+4, _mm_mul_ps(_mm_cvtepi32_ps(hi), g) );
+  }
+  convertScalar<SINT16>( src+i, doSwap, gain, out+i, n-i );
+}
+
+static void convertSint32Sse2( const void *in, bool doSwap, MY_FLOAT gain, MY_FLOAT *out, unsigned long n )
+{
+  const SINT32 *src = (const SINT32 *) in;
+  __m128 g = _mm_set1_ps( gain );
+  unsigned long i;
+  for (i=0; i+4<=n; i+=4) {
+    __m128i v = _mm_loadu_si128( (const __m128i *) (src+i) );
+    if ( doSwap ) v = swap32Sse2( v );
+    _mm_storeu_ps( out+i, _mm_mul_ps(_mm_cvtepi32_ps(v), g) );
+  }
+  convertScalar<SINT32>( src+i, doSwap, gain, out+i, n-i );
+}
+
+static void convertFloat32Sse2( const void *in, bool doSwap, MY_FLOAT gain, MY_FLOAT *out, unsigned long n )
+{
+  const FLOAT32 *src = (const FLOAT32 *) in;
+  __m128 g = _mm_set1_ps( gain );
+  unsigned long i;
+  for (i=0; i+4<=n; i+=4) {
+    __m128i v = _mm_loadu_si128( (const __m128i *) (src+i) );
+    if ( doSwap ) v = swap32Sse2( v );
+    _mm_storeu_ps( out+i, _mm_mul_ps(_mm_castsi128_ps(v), g) );
+  }
+  convertScalar<FLOAT32>( src+i, doSwap, gain, out+i, n-i );
+}
+
+static void convertFloat64Sse2( const void *in, bool doSwap, MY_FLOAT gain, MY_FLOAT *out, unsigned long n )
+{
+  const FLOAT64 *src = (const FLOAT64 *) in;
+  __m128 g = _mm_set1_ps( gain );
+  unsigned long i;
+  for (i=0; i+4<=n; i+=4) {
+    __m128i a = _mm_loadu_si128( (const __m128i *) (src+i) );
+    __m128i b = _mm_loadu_si128( (const __m128i *) (src+i+2) );
+    if ( doSwap ) {
+      a = swap64Sse2( a );
+      b = swap64Sse2( b );
+    }
+    __m128 v = _mm_movelh_ps( _mm_cvtpd_ps(_mm_castsi128_pd(a)), _mm_cvtpd_ps(_mm_castsi128_pd(b)) );
+    _mm_storeu_ps( out+i, _mm_mul_ps(v, g) );
+  }
+  convertScalar<FLOAT64>( src+i, doSwap, gain, out+i, n-i );
+}
+
+static void swap16Sse2( void *data, unsigned long n )
+{
+  SINT16 *ptr = (SINT16 *) data;
+  unsigned long i;
+  for (i=0; i+8<=n; i+=8)
+    _mm_storeu_si128( (__m128i *) (ptr+i), swap16Sse2(_mm_loadu_si128((const __m128i *) (ptr+i))) );
+  swap16Scalar( ptr+i, n-i );
+}
+
+static void swap32Sse2( void *data, unsigned long n )
+{
+  SINT32 *ptr = (SINT32 *) data;
+  unsigned long i;
+  for (i=0; i+4<=n; i+=4)
+    _mm_storeu_si128( (__m128i *) (ptr+i), swap32Sse2(_mm_loadu_si128((const __m128i *) (ptr+i))) );
+  swap32Scalar( ptr+i, n-i );
+}
+
+static void swap64Sse2( void *data, unsigned long n )
+{
+  FLOAT64 *ptr = (FLOAT64 *) data;
+  unsigned long i;
+  for (i=0; i+2<=n; i+=2)
+    _mm_storeu_si128( (__m128i *) (ptr+i), swap64Sse2(_mm_loadu_si128((const __m128i *) (ptr+i))) );
+  swap64Scalar( ptr+i, n-i );
+}
+
+// Four samples are read with 32-bit loads (the fourth byte belongs to
+// the next sample) and moved into place with shifts.
+static void convertSint24Sse2( const void *in, bool doSwap, MY_FLOAT gain, MY_FLOAT *out, unsigned long n )
+{
+  const unsigned char *src = (const unsigned char *) in;
+  bool big = bigEndian24( doSwap );
+  __m128 g = _mm_set1_ps( gain );
+  unsigned long i;
+  for (i=0; i+5<=n; i+=4) {
+    SINT32 w[4];
+    memcpy( w, src+3*i, 4 );
+    memcpy( w+1, src+3*i+3, 4 );
+    memcpy( w+2, src+3*i+6, 4 );
+    memcpy( w+3, src+3*i+9, 4 );
+    __m128i v = _mm_loadu_si128( (const __m128i *) w );
+    if ( big ) v = swap32Sse2( v );
+    else v = _mm_slli_epi32( v, 8 );
+    v = _mm_srai_epi32( v, 8 );
+    _mm_storeu_ps( out+i, _mm_mul_ps(_mm_cvtepi32_ps(v), g) );
+  }
+  convertSint24Scalar( src+3*i, doSwap, gain, out+i, n-i );
+}
+
+static const ConvertKernels sse2Kernels = {
+  "sse2",
+  convertSint8Sse2, convertSint16Sse2, convertSint24Sse2, convertSint32Sse2, convertFloat32Sse2, convertFloat64Sse2,
+  swap16Sse2, swap32Sse2, swap64Sse2
+};
+
+// AVX2 versions, compiled for AVX2 regardless of the compiler flags and
+// only called if the processor has it.
+
+AVX2 static inline __m256i swapMask16( void )
+{
+  return _mm256_setr_epi8( 1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14,
+                           1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14 );
+}
+
+AVX2 static inline __m256i swapMask32( void )
+{
+  return _mm256_setr_epi8( 3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12,
+                           3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12 );
+}
+
+AVX2 static inline __m256i swapMask64( void )
+{
+  return _mm256_setr_epi8( 7,6,5,4,3,2,1,0,15,14,13,12,11,10,9,8,
+                           7,6,5,4,3,2,1,0,15,14,13,12,11,10,9,8 );
+}
+
+AVX2 static void convertSint8Avx2( const void *in, bool doSwap, MY_FLOAT gain, MY_FLOAT *out, unsigned long n )
+{
+  const signed char *src = (const signed char *) in;
+  __m256 g = _mm256_set1_ps( gain );
+  unsigned long i;
+  for (i=0; i+16<=n; i+=16) {
+    __m128i v = _mm_loadu_si128( (const __m128i *) (src+i) );
+    _mm256_storeu_ps( out+i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(v)), g) );
+    _mm256_storeu_ps( out+i+8, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(_mm_srli_si128(v, 8))), g) );
+  }
+  convertScalar<signed char>( src+i, doSwap, gain, out+i, n-i );
+}
+
+AVX2 static void convertSint16Avx2( const void *in, bool doSwap, MY_FLOAT gain, MY_FLOAT *out, unsigned long n )
+{
+  const SINT16 *src = (const SINT16 *) in;
+  __m256 g = _mm256_set1_ps( gain );
+  __m256i mask = swapMask16();
+  unsigned long i;
+  for (i=0; i+16<=n; i+=16) {
+    __m256i v = _mm256_loadu_si256( (const __m256i *) (src+i) );
+    if ( doSwap ) v = _mm256_shuffle_epi8( v, mask );
+    __m256i lo = _mm256_cvtepi16_epi32( _mm256_castsi256_si128(v) );
+    __m256i hi = _mm256_cvtepi16_epi32( _mm256_extracti128_si256(v, 1) );
+    _mm256_storeu_ps( out+i, _mm256_mul_ps(_mm256_cvtepi32_ps(lo), g) );
+    _mm256_storeu_ps( out+i+8, _mm256_mul_ps(_mm256_cvtepi32_ps(hi), g) );
+  }
+  convertScalar<SINT16>( src+i, doSwap, gain, out+i, n-i );
+}
+
+// Each 128-bit lane gets four packed samples (12 of the 16 bytes
+// loaded), which a byte shuffle spreads into the top of four words.
+AVX2 static void convertSint24Avx2( const void *in, bool doSwap, MY_FLOAT gain, MY_FLOAT *out, unsigned long n )
+{
+  const unsigned char *src = (const unsigned char *) in;
+  bool big = bigEndian24( doSwap );
+  __m256 g = _mm256_set1_ps( gain );
+  __m256i mask = big ?
+    _mm256_setr_epi8( -1,2,1,0,-1,5,4,3,-1,8,7,6,-1,11,10,9, -1,2,1,0,-1,5,4,3,-1,8,7,6,-1,11,10,9 ) :
+    _mm256_setr_epi8( -1,0,1,2,-1,3,4,5,-1,6,7,8,-1,9,10,11, -1,0,1,2,-1,3,4,5,-1,6,7,8,-1,9,10,11 );
+  unsigned long i;
+  for (i=0; i+10<=n; i+=8) {
+    __m128i lo = _mm_loadu_si128( (const __m128i *) (src+3*i) );
+    __m128i hi = _mm_loadu_si128( (const __m128i *) (src+3*i+12) );
+    __m256i v = _mm256_inserti128_si256( _mm256_castsi128_si256(lo), hi, 1 );
+    v = _mm256_srai_epi32( _mm256_shuffle_epi8(v, mask), 8 );
+    _mm256_storeu_ps( out+i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), g) );
+  }
+  convertSint24Scalar( src+3*i, doSwap, gain, out+i, n-i );
+}
+
+AVX2 static void convertSint32Avx2( const void *in, bool doSwap, MY_FLOAT gain, MY_FLOAT *out, unsigned long n )
+{
+  const SINT32 *src = (const SINT32 *) in;
+  __m256 g = _mm256_set1_ps( gain );
+  __m256i mask = swapMask32();
+  unsigned long i;
+  for (i=0; i+8<=n; i+=8) {
+    __m256i v = _mm256_loadu_si256( (const __m256i *) (src+i) );
+    if ( doSwap ) v = _mm256_shuffle_epi8( v, mask );
+    _mm256_storeu_ps( out+i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), g) );
+  }
+  convertScalar<SINT32>( src+i, doSwap, gain, out+i, n-i );
+}
+
+AVX2 static void convertFloat32Avx2( const void *in, bool doSwap, MY_FLOAT gain, MY_FLOAT *out, unsigned long n )
+{
+  const FLOAT32 *src = (const FLOAT32 *) in;
+  __m256 g = _mm256_set1_ps( gain );
+  __m256i mask = swapMask32();
+  unsigned long i;
+  for (i=0; i+8<=n; i+=8) {
+    __m256i v = _mm256_loadu_si256( (const __m256i *) (src+i) );
+    if ( doSwap ) v = _mm256_shuffle_epi8( v, mask );
+    _mm256_storeu_ps( out+i, _mm256_mul_ps(_mm256_castsi256_ps(v), g) );
+  }
+  convertScalar<FLOAT32>( src+i, doSwap, gain, out+i, n-i );
+}
+
+AVX2 static void convertFloat64Avx2( const void *in, bool doSwap, MY_FLOAT gain, MY_FLOAT *out, unsigned long n )
+{
+  const FLOAT64 *src = (const FLOAT64 *) in;
+  __m256 g = _mm256_set1_ps( gain );
+  __m256i mask = swapMask64();
+  unsigned long i;
+  for (i=0; i+8<=n; i+=8) {
+    __m256i a = _mm256_loadu_si256( (const __m256i *) (src+i) );
+    __m256i b = _mm256_loadu_si256( (const __m256i *) (src+i+4) );
+    if ( doSwap ) {
+      a = _mm256_shuffle_epi8( a, mask );
+      b = _mm256_shuffle_epi8( b, mask );
+    }
+    __m256 v = _mm256_insertf128_ps( _mm256_castps128_ps256(_mm256_cvtpd_ps(_mm256_castsi256_pd(a))),
+                                     _mm256_cvtpd_ps(_mm256_castsi256_pd(b)), 1 );
+    _mm256_storeu_ps( out+i, _mm256_mul_ps(v, g) );
+  }
+  convertScalar<FLOAT64>( src+i, doSwap, gain, out+i, n-i );
+}
+
+AVX2 static void swapAvx2( void *data, unsigned long bytes, __m256i mask )
+{
+  unsigned char *ptr = (unsigned char *) data;
+  for (unsigned long i=0; i+32<=bytes; i+=32)
+    _mm256_storeu_si256( (__m256i *) (ptr+i), _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *) (ptr+i)), mask) );
+}
+
+AVX2 static void swap16Avx2( void *data, unsigned long n )
+{
+  unsigned long done = n & ~15UL;
+  swapAvx2( data, done*2, swapMask16() );
+  swap16Scalar( (SINT16 *) data + done, n - done );
+}
+
+AVX2 static void swap32Avx2( void *data, unsigned long n )
+{
+  unsigned long done = n & ~7UL;
+  swapAvx2( data, done*4, swapMask32() );
+  swap32Scalar( (SINT32 *) data + done, n - done );
+}
+
+AVX2 static void swap64Avx2( void *data, unsigned long n )
+{
+  unsigned long done = n & ~3UL;
+  swapAvx2( data, done*8, swapMask64() );
+  swap64Scalar( (FLOAT64 *) data + done, n - done );
+}
+
+static const ConvertKernels avx2Kernels = {
+  "avx2",
+  convertSint8Avx2, convertSint16Avx2, convertSint24Avx2, convertSint32Avx2, convertFloat32Avx2, convertFloat64Avx2,
+  swap16Avx2, swap32Avx2, swap64Avx2
+};
+
+#endif // defined(__CONVERT_X86__)
+
+static const ConvertKernels *chooseKernels( void )
+{
+#if defined(__CONVERT_X86__)
+  __builtin_cpu_init();
+  if ( __builtin_cpu_supports("avx2") ) return &avx2Kernels;
+  return &sse2Kernels;
+#else
+  return &scalarKernels;
+#endif
+}
+
+// The kernels are picked once, on first use.
+static const ConvertKernels &convertKernels( void )
+{
+  static const ConvertKernels *kernels = chooseKernels();
+  return *kernels;
+}
+
+void SampleConvert :: convert( const void *in, STK_FORMAT format, bool doSwap, MY_FLOAT gain,
+                               MY_FLOAT *out, unsigned long n )
+{
+  const ConvertKernels &k = convertKernels();
+  if ( format == STK_SINT16 ) k.sint16( in, doSwap, gain, out, n );
+  else if ( format == MY_FLOAT32 ) k.float32( in, doSwap, gain, out, n );
+  else if ( format == STK_SINT32 ) k.sint32( in, doSwap, gain, out, n );
+  else if ( format == MY_FLOAT64 ) k.float64( in, doSwap, gain, out, n );
+  else if ( format == STK_SINT24 ) k.sint24( in, doSwap, gain, out, n );
+  else if ( format == STK_SINT8 ) k.sint8( in, doSwap, gain, out, n );
+}
+
+void SampleConvert :: swap( void *data, unsigned int bytes, unsigned long n )
+{
+  const ConvertKernels &k = convertKernels();
+  if ( bytes == 2 ) k.swap16( data, n );
+  else if ( bytes == 3 ) swap24Scalar( data, n );
+  else if ( bytes == 4 ) k.swap32( data, n );
+  else if ( bytes == 8 ) k.swap64( data, n );
+}
+
+const char *SampleConvert :: kernels( void )
+{
+  return convertKernels().name;
+}
@@ -0,0 +1,40 @@
+/***************************************************/
+/*! \class SampleConvert
+    \brief Block sample format conversion kernels.
+
+    This class provides the loops that byte-swap
+    sample data and convert it to MY_FLOAT, scaled
+    by a gain.  On x86 processors, SSE2 or AVX2
+    versions are chosen at runtime depending on what
+    the processor supports; elsewhere plain C++ loops
+    are used.  All versions give the same results.
+
+    8-bit data is taken to be signed.  24-bit data
+    (STK_SINT24) is packed in 3 bytes per sample.
+*/
+/***************************************************/
+
+#if !defined(__SAMPLECONVERT_H)
+#define __SAMPLECONVERT_H
+
+#include "Stk.h"
+
+class SampleConvert : public Stk
+{
+public:
+  //! Convert \e n samples of type \e format from \e in to MY_FLOAT in \e out, multiplied by \e gain.
+  /*!
+    If \e doSwap is TRUE, the samples are byte-swapped first.  The
+    input and output must not overlap.
+  */
+  static void convert( const void *in, STK_FORMAT format, bool doSwap, MY_FLOAT gain,
+                       MY_FLOAT *out, unsigned long n );
+
+  //! Byte-swap \e n samples of \e bytes bytes each (1, 2, 3, 4 or 8) in place.
+  static void swap( void *data, unsigned int bytes, unsigned long n );
+
+  //! Return the name of the kernels in use: "avx2", "sse2" or "scalar".
+  static const char *kernels( void );
+};
+
+#endif // defined(__SAMPLECONVERT_H)
@@ -0,0 +1,443 @@
+/***************************************************/
+/*! \class Setlist
+    \brief Plays a list of songs back to back.
+
+    Each song is either a .stems bundle (see
+    StemBundle) or a set of separate stem files.
+    While one song plays, a background thread opens
+    the next one into a SetlistSong, with its stems
+    attached or buffered, lined up by a StemAligner
+    and ready to play.  Going on
+    to it with next() only swaps a pointer, so the
+    audio thread can change songs between two sample
+    frames without opening, reading or allocating
+    anything.  A stem of the song playing can be
+    replaced the same way with replaceStem().
+
+    Songs and stems which have been let go of are
+    retired rather than deleted by the audio thread.
+    The background thread closes them once the audio
+    thread has started another buffer with update(),
+    so they are never freed while it is using them.
+    Only the audio thread may call update() and
+    next(), and only it may use a SetlistSong; the
+    other methods don't touch the songs and can be
+    called from any thread.  One other thread, such
+    as a Lookahead, can read a song's cursors while
+    it holds the song with hold().
+*/
+/***************************************************/
+
+#include "Setlist.h"
+#include <string.h>
+
+SetlistSong :: SetlistSong()
+  : index(0), loader(0)
+{
+  for (unsigned int i=0; i<SETLIST_STEMS; i++) {
+    stems[i] = 0;
+    gain[i] = 1.0;
+    job[i] = -1;
+    start[i] = 0.0;
+    levels[i] = 0;
+    cursors[i] = 0;
+  }
+}
+
+SetlistSong :: ~SetlistSong()
+{
+  // The loader may still be reading the stems to find their peaks.
+  delete loader;
+  for (unsigned int i=0; i<SETLIST_STEMS; i++) {
+    // A cursor may read from its stem's memory.
+    delete cursors[i];
+    delete stems[i];
+    delete levels[i];
+  }
+}
+
+const PeakStats *SetlistSong :: getLevels( unsigned int stem ) const
+{
+  if ( job[stem] >= 0 ) return loader->getStats( job[stem] );
+  return levels[stem];
+}
+
+Setlist :: Setlist( unsigned int nStems )
+  : songCount(0), nextSong(0), running(false), stopped(true), playing(0), cued(0),
+    playingIndex(0), position(0.0), cycles(0), swaps(0), held(0), retiredIn(0), retiredOut(0),
+    replaceState(REPLACE_IDLE), replacement(0), replaceLevels(0), replaceCursor(0)
+{
+  if ( nStems == 0 ) nStems = 1;
+  if ( nStems > SETLIST_STEMS ) nStems = SETLIST_STEMS;
+  this->nStems = nStems;
+}
+
+Setlist :: ~Setlist()
+{
+  if ( !stopped ) {
+    // Let the thread finish opening a song rather than cancelling it.
+    running = false;
+    while ( !stopped ) Stk::sleep( SETLIST_POLL );
+    thread.wait();
+  }
+
+  for (unsigned long i=retiredOut; i!=retiredIn; i++) {
+    delete retired[i % SETLIST_RETIRED].cursor;
+    delete retired[i % SETLIST_RETIRED].stem;
+    delete retired[i % SETLIST_RETIRED].levels;
+    delete retired[i % SETLIST_RETIRED].song;
+  }
+  if ( replaceState == REPLACE_READY ) {
+    delete replaceCursor;
+    delete replacement;
+    delete replaceLevels;
+  }
+  delete playing.load();
+  delete cued.load();
+}
+
+void Setlist :: addBundle( const char *fileName )
+{
+  if ( songCount == SETLIST_SONGS ) {
+    sprintf(msg, "Setlist: Too many songs (%d).", SETLIST_SONGS + 1);
+    handleError(msg, StkError::FUNCTION_ARGUMENT);
+  }
+  entries[songCount].bundle = fileName;
+  songCount++;
+}
+
+void Setlist :: addFiles( const char **fileNames )
+{
+  if ( songCount == SETLIST_SONGS ) {
+    sprintf(msg, "Setlist: Too many songs (%d).", SETLIST_SONGS + 1);
+    handleError(msg, StkError::FUNCTION_ARGUMENT);
+  }
+  entries[songCount].bundle = 0;
+  for (unsigned int i=0; i<nStems; i++)
+    entries[songCount].files[i] = fileNames[i];
+  songCount++;
+}
+
+unsigned int Setlist :: getSongCount( void ) const
+{
+  return songCount;
+}
+
+const char *Setlist :: getName( unsigned int index ) const
+{
+  if ( index >= songCount ) return "";
+  if ( entries[index].bundle ) return entries[index].bundle;
+  return entries[index].files[0];
+}
+
+void Setlist :: start( void )
+{
+  SetlistSong *song = 0;
+  while ( !song && nextSong < songCount )
+    song = open( nextSong++ );
+  if ( !song ) {
+    sprintf(msg, "Setlist: None of the %d songs could be opened.", songCount);
+    handleError(msg, StkError::FILE_ERROR);
+  }
+  playing = song;
+  playingIndex = song->index;
+
+  running = true;
+  stopped = false;
+  if ( !thread.start( &cueThread, this ) ) {
+    running = false;
+    stopped = true;
+    sprintf(msg, "Setlist: Unable to start the cueing thread.");
+    handleError(msg, StkError::PROCESS_THREAD);
+  }
+}
+
+SetlistSong *Setlist :: getSong( void ) const
+{
+  return playing;
+}
+
+unsigned int Setlist :: getIndex( void ) const
+{
+  return playingIndex;
+}
+
+double Setlist :: getPosition( void ) const
+{
+  return position;
+}
+
+unsigned long Setlist :: getSwaps( void ) const
+{
+  return swaps;
+}
+
+SetlistSong *Setlist :: hold( void )
+{
+  // Once held, a song isn't closed.  If it was retired before that, it
+  // is no longer playing, so check again.
+  SetlistSong *song;
+  do {
+    song = playing;
+    held = song;
+  } while ( playing != song );
+  return song;
+}
+
+void Setlist :: release( void )
+{
+  held = 0;
+}
+
+void Setlist :: replaceStem( unsigned int stem, const char *fileName )
+{
+  int idle = REPLACE_IDLE;
+  if ( stem >= nStems || !replaceState.compare_exchange_strong( idle, REPLACE_NAMING ) ) {
+    sprintf(msg, "Setlist: Stem %d cannot be replaced now.", stem + 1);
+    handleError(msg, StkError::WARNING);
+    return;
+  }
+
+  replaceIndex = stem;
+  strncpy( replaceFile, fileName, sizeof(replaceFile) - 1 );
+  replaceFile[sizeof(replaceFile) - 1] = '\0';
+  replaceState = REPLACE_REQUESTED;
+}
+
+bool Setlist :: update( void )
+{
+  SetlistSong *song = playing;
+  cycles++;
+  position = ( song->stems[0]->getTime() - song->start[0] ) / song->stems[0]->getFileRate();
+
+  if ( replaceState != REPLACE_READY ) return false;
+  PrefetchWvIn *input = replacement;
+  if ( replaceSong != song->index ) {
+    // The song has changed since the stem was asked for.
+    if ( retire( 0, input, replaceLevels, replaceCursor ) ) replaceState = REPLACE_IDLE;
+    return false;
+  }
+
+  unsigned int i = replaceIndex;
+  PrefetchWvIn *old = song->stems[i];
+  if ( !retire( 0, old, song->levels[i], song->cursors[i],
+                ( song->job[i] >= 0 ) ? song->loader : 0, song->job[i] ) )
+    return false;
+
+  // Pick up where the old stem is, at the new stem's rate.  The new
+  // take is assumed to be lined up with the song as it is.
+  input->seek( ( old->getTime() - song->start[i] ) / old->getFileRate() * input->getFileRate() );
+  song->start[i] = 0.0;
+  song->stems[i] = input;
+  song->levels[i] = replaceLevels;
+  song->cursors[i] = replaceCursor;
+  song->gain[i] = 1.0;
+  song->job[i] = -1;
+  swaps++;
+  replaceState = REPLACE_IDLE;
+  return true;
+}
+
+bool Setlist :: next( void )
+{
+  SetlistSong *song = cued;
+  if ( !song || !retire( playing, 0 ) ) return false;
+
+  playing = song;
+  playingIndex = song->index;
+  cued = 0;
+  return true;
+}
+
+bool Setlist :: retire( SetlistSong *song, PrefetchWvIn *stem, PeakStats *levels, WvIn *cursor,
+                        StemLoader *loader, int job )
+{
+  unsigned long in = retiredIn;
+  if ( in - retiredOut >= SETLIST_RETIRED ) return false;
+
+  Retired &r = retired[in % SETLIST_RETIRED];
+  r.song = song;
+  r.stem = stem;
+  r.levels = levels;
+  r.cursor = cursor;
+  r.loader = loader;
+  r.job = job;
+  r.cycle = cycles;
+  retiredIn = in + 1;
+  return true;
+}
+
+bool Setlist :: reclaim( void )
+{
+  bool any = false;
+  unsigned long out = retiredOut;
+  while ( out != retiredIn ) {
+    Retired &r = retired[out % SETLIST_RETIRED];
+    // The audio thread may use it until it starts another buffer, and the
+    // loader may read the stem until it has found its peak.
+    if ( cycles == r.cycle ) break;
+    if ( r.loader && !r.loader->isLoaded( r.job ) && !r.loader->hasFailed( r.job ) ) break;
+    // A held song, and any stem which might be from it, is still being read.
+    SetlistSong *reader = held;
+    if ( reader && ( r.song == reader || r.stem ) ) break;
+
+    delete r.cursor;
+    delete r.stem;
+    delete r.levels;
+    delete r.song;
+    retiredOut = ++out;
+    any = true;
+  }
+  return any;
+}
+
+PeakStats *Setlist :: findLevels( PrefetchWvIn *input )
+{
+  // A file has its levels cached once it has been normalized; the
+  // stems of a bundle are scanned, which takes little as they are mapped.
+  PeakStats *levels = new PeakStats;
+  if ( input->getStats( levels ) && levels->blocks > 0 ) return levels;
+  delete levels;
+  return 0;
+}
+
+SetlistSong *Setlist :: open( unsigned int index )
+{
+  SetlistSong *song = new SetlistSong;
+  Entry &entry = entries[index];
+  song->index = index;
+  unsigned int i;
+
+  try {
+    if ( entry.bundle ) {
+      // The stems are read straight out of the bundle's mapping, and
+      // the stored peaks normalize them without a pass over the data.
+      song->bundle.openFile( entry.bundle );
+      if ( song->bundle.getStemCount() < nStems ) {
+        sprintf(msg, "Setlist: %s has %d stems, %d are needed.", entry.bundle, song->bundle.getStemCount(), nStems);
+        handleError(msg, StkError::FILE_ERROR);
+      }
+      for (i=0; i<nStems; i++) {
+        song->stems[i] = new PrefetchWvIn();
+        song->stems[i]->setResample( true );
+        song->bundle.attach( i, song->stems[i], TRUE );
+        song->levels[i] = findLevels( song->stems[i] );
+      }
+    }
+    else {
+      // Open all the stems at once.  Each can play as soon as its first
+      // seconds are in memory, and is normalized once its peak is found.
+      song->loader = new StemLoader();
+      for (i=0; i<nStems; i++) {
+        song->stems[i] = new PrefetchWvIn();
+        song->stems[i]->setResample( true );
+        song->job[i] = song->loader->load( entry.files[i], song->stems[i], TRUE );
+      }
+      if ( !song->loader->waitReady() ) {
+        delete song;
+        return 0;
+      }
+
+      // Stems with cached peaks are normalized from the start.  Until
+      // the others' are known, they play at full scale, and are then
+      // brought to their normalized level gradually (see fillStem()).
+      for (i=0; i<nStems; i++) {
+        if ( song->loader->isLoaded( song->job[i] ) && song->loader->getPeak( song->job[i] ) > 0 ) {
+          song->gain[i] = 1.0 / song->loader->getPeak( song->job[i] );
+          continue;
+        }
+        STK_FORMAT type = song->stems[i]->getDataType();
+        if ( type == STK_SINT8 ) song->gain[i] = 1.0 / 128.0;
+        else if ( type == STK_SINT16 ) song->gain[i] = 1.0 / 32768.0;
+        else if ( type == STK_SINT24 ) song->gain[i] = 1.0 / 8388608.0;
+        else if ( type == STK_SINT32 ) song->gain[i] = 1.0 / 2147483648.0;
+      }
+    }
+  }
+  catch ( StkError & ) {
+    // The error has been reported by handleError().
+    delete song;
+    return 0;
+  }
+
+  // Read each stem's data through a cursor of its own as well.
+  try {
+    for (i=0; i<nStems; i++) {
+      song->cursors[i] = new WvIn();
+      song->cursors[i]->setResample( true );
+      song->cursors[i]->openCursor( *song->stems[i] );
+    }
+  }
+  catch ( StkError & ) {
+    delete song;
+    return 0;
+  }
+
+  // Start each stem where it lines up with the first.
+  WvIn *inputs[SETLIST_STEMS];
+  for (i=0; i<nStems; i++) inputs[i] = song->stems[i];
+  StemAligner aligner;
+  if ( aligner.align( inputs, nStems, song->start ) ) {
+    for (i=0; i<nStems; i++) song->stems[i]->seek( song->start[i] );
+  }
+
+  return song;
+}
+
+void Setlist :: openReplacement( void )
+{
+  // Open it for the song playing now; if the song changes in the meantime,
+  // update() drops it.
+  unsigned int index = playingIndex;
+  PrefetchWvIn *input = new PrefetchWvIn();
+  input->setResample( true );
+  try {
+    input->openFile( replaceFile, FALSE, TRUE, TRUE );
+  }
+  catch ( StkError & ) {
+    // The error has been reported by handleError().
+    delete input;
+    replaceState = REPLACE_IDLE;
+    return;
+  }
+
+  WvIn *cursor = new WvIn();
+  cursor->setResample( true );
+  try {
+    cursor->openCursor( *input );
+  }
+  catch ( StkError & ) {
+    delete cursor;
+    delete input;
+    replaceState = REPLACE_IDLE;
+    return;
+  }
+
+  // Start loading near where it will be swapped in.
+  input->seek( position * input->getFileRate() );
+  replaceLevels = findLevels( input );
+  replaceCursor = cursor;
+  replacement = input;
+  replaceSong = index;
+  replaceState = REPLACE_READY;
+}
+
+THREAD_RETURN THREAD_TYPE Setlist :: cueThread( void *ptr )
+{
+  Setlist *setlist = (Setlist *) ptr;
+
+  while ( setlist->running ) {
+    if ( setlist->reclaim() ) continue;
+
+    if ( setlist->replaceState == REPLACE_REQUESTED )
+      setlist->openReplacement();
+    else if ( !setlist->cued.load() && setlist->nextSong < setlist->songCount ) {
+      SetlistSong *song = setlist->open( setlist->nextSong++ );
+      if ( song ) setlist->cued = song;
+    }
+    else Stk::sleep( SETLIST_POLL );
+  }
+
+  setlist->stopped = true;
+  return 0;
+}
@@ -0,0 +1,212 @@
+/***************************************************/
+/*! \class Setlist
+    \brief Plays a list of songs back to back.
+
+    Each song is either a .stems bundle (see
+    StemBundle) or a set of separate stem files.
+    While one song plays, a background thread opens
+    the next one into a SetlistSong, with its stems
+    attached or buffered, lined up by a StemAligner
+    and ready to play.  Going on
+    to it with next() only swaps a pointer, so the
+    audio thread can change songs between two sample
+    frames without opening, reading or allocating
+    anything.  A stem of the song playing can be
+    replaced the same way with replaceStem().
+
+    Songs and stems which have been let go of are
+    retired rather than deleted by the audio thread.
+    The background thread closes them once the audio
+    thread has started another buffer with update(),
+    so they are never freed while it is using them.
+    Only the audio thread may call update() and
+    next(), and only it may use a SetlistSong; the
+    other methods don't touch the songs and can be
+    called from any thread.  One other thread, such
+    as a Lookahead, can read a song's cursors while
+    it holds the song with hold().
+*/
+/***************************************************/
+
+#if !defined(__SETLIST_H)
+#define __SETLIST_H
+
+#define SETLIST_SONGS 64
+#define SETLIST_STEMS 8        // stems per song, at most
+#define SETLIST_RETIRED 16     // songs and stems waiting to be closed, at most
+#define SETLIST_POLL 5         // milliseconds
+
+#include "Stk.h"
+#include "PrefetchWvIn.h"
+#include "StemBundle.h"
+#include "StemLoader.h"
+#include "StemAligner.h"
+#include "Thread.h"
+#include <atomic>
+
+//! One song of a Setlist, open and ready to play.
+struct SetlistSong {
+  unsigned int index;                   // position in the setlist
+  PrefetchWvIn *stems[SETLIST_STEMS];
+  MY_FLOAT gain[SETLIST_STEMS];         // scales a stem to +-1.0 (see job)
+  int job[SETLIST_STEMS];               // loader job finding a stem's peak, or -1 if normalized already
+  double start[SETLIST_STEMS];          // frame a stem starts from, lining it up with the others
+  StemLoader *loader;                   // for separate files, else NULL
+  StemBundle bundle;                    // for a bundle
+  PeakStats *levels[SETLIST_STEMS];     // a stem's block levels if it has no job, or NULL
+  WvIn *cursors[SETLIST_STEMS];         // read the stems' data apart from them (see WvIn::openCursor())
+
+  SetlistSong();
+  ~SetlistSong();
+
+  //! Return the levels of stem \e stem, with its block index, or NULL if they aren't known (yet).
+  const PeakStats *getLevels( unsigned int stem ) const;
+};
+
+class Setlist : public Stk
+{
+public:
+  //! Class constructor for songs of \e nStems stems (at most SETLIST_STEMS).
+  Setlist( unsigned int nStems );
+
+  //! Class destructor, which stops the background thread and closes every song.
+  ~Setlist();
+
+  //! Add the .stems bundle \e fileName, which must stay valid, to the end of the setlist.
+  /*!
+    An StkError will be thrown if the setlist is full.  The bundle
+    is not opened until its song is cued.
+  */
+  void addBundle( const char *fileName );
+
+  //! Add a song of separate stem files, nStems names which must stay valid, to the end.
+  /*!
+    An StkError will be thrown if the setlist is full.
+  */
+  void addFiles( const char **fileNames );
+
+  //! Return the number of songs added.
+  unsigned int getSongCount( void ) const;
+
+  //! Return the name of song \e index: its bundle, or its first stem file.
+  const char *getName( unsigned int index ) const;
+
+  //! Open the first song, wait until it can play and start cueing the songs after it.
+  /*!
+    Songs which cannot be opened are skipped.  An StkError will be
+    thrown if none can be, or if the background thread cannot be started.
+  */
+  void start( void );
+
+  //! Return the song playing, for the audio thread.
+  SetlistSong *getSong( void ) const;
+
+  //! Return the position in the setlist of the song playing.
+  unsigned int getIndex( void ) const;
+
+  //! Return the time into the song playing, in seconds, at the start of the last buffer.
+  double getPosition( void ) const;
+
+  //! Return the number of stems swapped in by update() so far.
+  unsigned long getSwaps( void ) const;
+
+  //! Keep the song playing, with its cursors, from being closed until release(), and return it.
+  /*!
+    Stems retired from it are kept too.  Only one thread besides the
+    audio thread may hold a song, and it should let go of it soon, as
+    nothing is closed meanwhile.  The song may stop playing while it
+    is held.
+  */
+  SetlistSong *hold( void );
+
+  //! Let go of the song returned by hold().
+  void release( void );
+
+  //! Replace stem \e stem of the song playing with the file \e fileName.
+  /*!
+    The file is opened and normalized by the background thread, and
+    swapped in by update() at the same position as the stem it
+    replaces.  If it cannot be opened, the stem is kept.  A warning is
+    given and nothing is done if a replacement is already under way.
+  */
+  void replaceStem( unsigned int stem, const char *fileName );
+
+  //! Start a buffer, letting go of anything retired before.  Called by the audio thread.
+  /*!
+    A replacement stem which is ready is swapped in here.  Returns
+    TRUE if one was, in which case any loop has to be set on it again.
+  */
+  bool update( void );
+
+  //! Go on to the next song if it is ready and return TRUE, or return FALSE.
+  /*!
+    Called by the audio thread after update().  The song which was
+    playing can still be used until the next call to update().
+  */
+  bool next( void );
+
+protected:
+
+  struct Entry {
+    const char *bundle;
+    const char *files[SETLIST_STEMS];
+  };
+
+  struct Retired {
+    SetlistSong *song;
+    PrefetchWvIn *stem;
+    PeakStats *levels;           // the stem's, if it had its own
+    WvIn *cursor;                // the stem's
+    StemLoader *loader;          // still finding the stem's peak, if not NULL
+    int job;
+    unsigned long cycle;         // the value of cycles when it was retired
+  };
+
+  enum { REPLACE_IDLE, REPLACE_NAMING, REPLACE_REQUESTED, REPLACE_READY };
+
+  // Find the block levels of a stem which is not loaded by a StemLoader, or return NULL.
+  PeakStats *findLevels( PrefetchWvIn *input );
+
+  // Open song \e index and wait until its stems can play.  Returns NULL if it fails.
+  SetlistSong *open( unsigned int index );
+
+  // Open the requested replacement stem and hand it to the audio thread.
+  void openReplacement( void );
+
+  // Queue a song or stem to be closed.  Returns FALSE if the queue is full.
+  bool retire( SetlistSong *song, PrefetchWvIn *stem, PeakStats *levels = 0, WvIn *cursor = 0,
+               StemLoader *loader = 0, int job = -1 );
+
+  // Close the songs and stems the audio thread is done with.  Returns TRUE if any were.
+  bool reclaim( void );
+
+  static THREAD_RETURN THREAD_TYPE cueThread( void *ptr );
+
+  unsigned int nStems;
+  Entry entries[SETLIST_SONGS];
+  unsigned int songCount;
+  unsigned int nextSong;
+  Thread thread;
+  std::atomic<bool> running;
+  std::atomic<bool> stopped;
+  std::atomic<SetlistSong *> playing;
+  std::atomic<SetlistSong *> cued;
+  std::atomic<unsigned int> playingIndex;
+  std::atomic<double> position;
+  std::atomic<unsigned long> cycles;
+  std::atomic<unsigned long> swaps;
+  std::atomic<SetlistSong *> held;
+  Retired retired[SETLIST_RETIRED];
+  std::atomic<unsigned long> retiredIn;     // written by the audio thread
+  std::atomic<unsigned long> retiredOut;    // written by the background thread
+  std::atomic<int> replaceState;
+  unsigned int replaceIndex;
+  char replaceFile[256];
+  PrefetchWvIn *replacement;
+  PeakStats *replaceLevels;
+  WvIn *replaceCursor;
+  unsigned int replaceSong;      // index of the song it was opened for
+  char msg[256];
+};
+
+#endif // defined(__SETLIST_H)
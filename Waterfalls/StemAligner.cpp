@@ -0,0 +1,235 @@
+/***************************************************/
+/*! \class StemAligner
+    \brief Lines up stems by their onsets.
+
+    Stems exported from different sessions can be
+    offset from each other by a few hundred sample
+    frames.  This class finds the offsets by
+    cross-correlating the onset envelope of each
+    stem, over its first ALIGN_SECONDS, with that of
+    the first stem, the reference.  The envelopes are
+    the rise in RMS level every ALIGN_HOP seconds, so
+    stems of any rates can be compared, and they are
+    correlated with rfft().  Each stem is analysed on
+    a thread of its own.
+
+    Only offsets of up to ALIGN_MAX_LAG seconds are
+    looked for.  A stem whose onsets don't match the
+    reference's well enough, such as a pad with none
+    to speak of, is left where it is.
+*/
+/***************************************************/
+
+#include "StemAligner.h"
+#include "chuck_fft.h"
+#include <math.h>
+#include <string.h>
+
+StemAligner :: StemAligner()
+  : nStems(0)
+{
+  for (unsigned int i=0; i<ALIGN_STEMS; i++) {
+    stems[i].envelope = new float[ALIGN_FFT_SIZE];
+    stems[i].spectrum = new float[ALIGN_FFT_SIZE];
+    stems[i].match = 0.0;
+  }
+}
+
+StemAligner :: ~StemAligner()
+{
+  for (unsigned int i=0; i<ALIGN_STEMS; i++) {
+    delete [] stems[i].envelope;
+    delete [] stems[i].spectrum;
+  }
+}
+
+bool StemAligner :: align( WvIn **inputs, unsigned int nStems, double *starts )
+{
+  if ( nStems > ALIGN_STEMS ) {
+    sprintf(msg, "StemAligner: Too many stems (%d) to align.", nStems);
+    handleError(msg, StkError::FUNCTION_ARGUMENT);
+  }
+
+  unsigned int i;
+  this->nStems = nStems;
+  for (i=0; i<nStems; i++) {
+    stems[i].input = inputs[i];
+    stems[i].reference = &stems[0];
+    stems[i].lag = 0.0;
+    stems[i].match = 0.0;
+    starts[i] = 0.0;
+  }
+  if ( nStems == 0 ) return false;
+
+  runAll( &analyseThread, 0 );
+  if ( stems[0].energy <= 0.0 ) return false;
+  stems[0].match = 1.0;
+  runAll( &correlateThread, 1 );
+
+  // Start the stems which are behind later, and if any are ahead,
+  // start the others later still.
+  double earliest = 0.0;
+  for (i=1; i<nStems; i++)
+    if ( stems[i].lag < earliest ) earliest = stems[i].lag;
+  for (i=0; i<nStems; i++)
+    starts[i] = ( stems[i].lag - earliest ) * inputs[i]->getFileRate();
+
+  return true;
+}
+
+double StemAligner :: getMatch( unsigned int stem ) const
+{
+  if ( stem >= nStems ) return 0.0;
+  return stems[stem].match;
+}
+
+void StemAligner :: runAll( THREAD_FUNCTION function, unsigned int first )
+{
+  Thread threads[ALIGN_STEMS];
+  bool started[ALIGN_STEMS];
+  unsigned int i;
+
+  for (i=first; i<nStems; i++) {
+    stems[i].done = false;
+    started[i] = threads[i].start( function, &stems[i] );
+    // Do without a thread rather than not at all.
+    if ( !started[i] ) function( &stems[i] );
+  }
+
+  // Let each thread return before it is joined.
+  for (i=first; i<nStems; i++) {
+    if ( !started[i] ) continue;
+    while ( !stems[i].done ) Stk::sleep( ALIGN_POLL );
+    threads[i].wait();
+  }
+}
+
+void StemAligner :: analyse( Stem *stem )
+{
+  WvIn *input = stem->input;
+  unsigned int channels = input->getChannels();
+  double hop = ALIGN_HOP * input->getFileRate();
+  unsigned long frames = (unsigned long) (ALIGN_SECONDS * input->getFileRate());
+  if ( frames > input->getSize() ) frames = input->getSize();
+  // Half the transform is left as zeros, so the correlation doesn't wrap around.
+  if ( frames > hop * (ALIGN_FFT_SIZE/2 - 1) ) frames = (unsigned long) (hop * (ALIGN_FFT_SIZE/2 - 1));
+
+  // The RMS level of the channels' average over each hop.  A file
+  // read in chunks is opened once, in the reader, for all the blocks.
+  const unsigned long block = 4096;
+  WvIn reader;
+  MY_FLOAT *buffer = new MY_FLOAT[block * channels];
+  float *level = stem->envelope;
+  unsigned long length = 0, count = 0;
+  double squares = 0.0, next = hop;
+  for (unsigned long start=0; start<frames; start+=block) {
+    unsigned long n = ( frames - start < block ) ? frames - start : block;
+    n = input->peekFrames( start, n, buffer, &reader );
+    if ( n == 0 ) break;
+    for (unsigned long i=0; i<n; i++) {
+      double sum = 0.0;
+      for (unsigned int j=0; j<channels; j++) sum += buffer[i*channels+j];
+      sum /= channels;
+      squares += sum * sum;
+      count++;
+      if ( start + i + 1 >= next ) {
+        level[length++] = (float) sqrt( squares / count );
+        squares = 0.0;
+        count = 0;
+        next += hop;
+      }
+    }
+  }
+  delete [] buffer;
+
+  // The envelope is the rise in level, less its mean so that a
+  // steady level doesn't correlate with anything.
+  unsigned long i;
+  double mean = 0.0;
+  for (i=length-1; i>0 && i<length; i--) {
+    float rise = level[i] - level[i-1];
+    level[i] = ( rise > 0.0 ) ? rise : 0.0;
+    mean += level[i];
+  }
+  if ( length > 0 ) {
+    level[0] = 0.0;
+    mean /= length;
+  }
+
+  stem->energy = 0.0;
+  for (i=0; i<length; i++) {
+    level[i] -= (float) mean;
+    stem->energy += (double) level[i] * level[i];
+  }
+  memset( level + length, 0, (ALIGN_FFT_SIZE - length) * sizeof(float) );
+  stem->length = length;
+
+  memcpy( stem->spectrum, stem->envelope, ALIGN_FFT_SIZE * sizeof(float) );
+  rfft( stem->spectrum, ALIGN_FFT_SIZE/2, FFT_FORWARD );
+}
+
+void StemAligner :: correlate( Stem *stem )
+{
+  const Stem *reference = stem->reference;
+  if ( stem->energy <= 0.0 ) return;
+
+  // Multiply by the conjugate of the reference's transform.  rfft()
+  // packs the (real) Nyquist bin next to DC.
+  const float *r = reference->spectrum;
+  float *x = stem->spectrum;
+  x[0] *= r[0];
+  x[1] *= r[1];
+  for (unsigned long k=2; k<ALIGN_FFT_SIZE; k+=2) {
+    float re = r[k] * x[k] + r[k+1] * x[k+1];
+    float im = r[k] * x[k+1] - r[k+1] * x[k];
+    x[k] = re;
+    x[k+1] = im;
+  }
+  rfft( x, ALIGN_FFT_SIZE/2, FFT_INVERSE );
+
+  // The correlation at lag l is in x[l], and at lag -l in x[N-l].
+  long maxLag = (long) (ALIGN_MAX_LAG / ALIGN_HOP);
+  long best = 0;
+  for (long l=-maxLag; l<=maxLag; l++) {
+    if ( x[(l + ALIGN_FFT_SIZE) % ALIGN_FFT_SIZE] > x[(best + ALIGN_FFT_SIZE) % ALIGN_FFT_SIZE] )
+      best = l;
+  }
+
+  // How alike the envelopes are at that lag.
+  const float *a = reference->envelope;
+  const float *b = stem->envelope;
+  double sum = 0.0;
+  for (long k=0; k<(long) reference->length; k++) {
+    if ( k + best >= 0 && k + best < (long) stem->length )
+      sum += (double) a[k] * b[k + best];
+  }
+  stem->match = sum / sqrt( reference->energy * stem->energy );
+  if ( stem->match < ALIGN_MIN_MATCH ) return;
+
+  // Fit a parabola through the peak to place it between envelope values.
+  double offset = 0.0;
+  if ( best > -maxLag && best < maxLag ) {
+    double before = x[(best - 1 + ALIGN_FFT_SIZE) % ALIGN_FFT_SIZE];
+    double peak = x[(best + ALIGN_FFT_SIZE) % ALIGN_FFT_SIZE];
+    double after = x[(best + 1 + ALIGN_FFT_SIZE) % ALIGN_FFT_SIZE];
+    double curve = before - 2.0 * peak + after;
+    if ( curve < 0.0 ) offset = 0.5 * (before - after) / curve;
+  }
+  stem->lag = (best + offset) * ALIGN_HOP;
+}
+
+THREAD_RETURN THREAD_TYPE StemAligner :: analyseThread( void *ptr )
+{
+  Stem *stem = (Stem *) ptr;
+  analyse( stem );
+  stem->done = true;
+  return 0;
+}
+
+THREAD_RETURN THREAD_TYPE StemAligner :: correlateThread( void *ptr )
+{
+  Stem *stem = (Stem *) ptr;
+  correlate( stem );
+  stem->done = true;
+  return 0;
+}
@@ -0,0 +1,95 @@
+/***************************************************/
+/*! \class StemAligner
+    \brief Lines up stems by their onsets.
+
+    Stems exported from different sessions can be
+    offset from each other by a few hundred sample
+    frames.  This class finds the offsets by
+    cross-correlating the onset envelope of each
+    stem, over its first ALIGN_SECONDS, with that of
+    the first stem, the reference.  The envelopes are
+    the rise in RMS level every ALIGN_HOP seconds, so
+    stems of any rates can be compared, and they are
+    correlated with rfft().  Each stem is analysed on
+    a thread of its own.
+
+    Only offsets of up to ALIGN_MAX_LAG seconds are
+    looked for.  A stem whose onsets don't match the
+    reference's well enough, such as a pad with none
+    to speak of, is left where it is.
+*/
+/***************************************************/
+
+#if !defined(__STEMALIGNER_H)
+#define __STEMALIGNER_H
+
+#define ALIGN_STEMS 8           // stems aligned at once, at most
+#define ALIGN_SECONDS 20.0      // analysed from the start of each stem
+#define ALIGN_HOP 0.0005        // seconds per envelope value
+#define ALIGN_MAX_LAG 0.05      // seconds a stem is looked for either side of the reference
+#define ALIGN_MIN_MATCH 0.2     // normalized correlation needed to move a stem
+#define ALIGN_FFT_SIZE 65536    // envelope values per transform (a power of 2)
+#define ALIGN_POLL 1            // milliseconds
+
+#include "Stk.h"
+#include "WvIn.h"
+#include "Thread.h"
+#include <atomic>
+
+class StemAligner : public Stk
+{
+public:
+  //! Class constructor.
+  StemAligner();
+
+  //! Class destructor.
+  ~StemAligner();
+
+  //! Find the sample frame each of \e nStems stems should start from to line up with the first.
+  /*!
+    \e starts receives a frame for each stem, at the stem's file
+    rate.  The stem which starts latest starts from frame 0, so
+    the starts are never negative, and the reference may start
+    later than 0 itself.  The stems are read with
+    WvIn::peekFrames() and can be ticked meanwhile.  Returns FALSE,
+    with every start 0, if the reference has no onsets to line the
+    others up with.  An StkError will be thrown if more than
+    ALIGN_STEMS stems are given.
+  */
+  bool align( WvIn **stems, unsigned int nStems, double *starts );
+
+  //! Return how well stem \e stem matched the reference in the last align(), from -1.0 to 1.0.
+  double getMatch( unsigned int stem ) const;
+
+protected:
+
+  struct Stem {
+    WvIn *input;
+    const Stem *reference;
+    float *envelope;              // ALIGN_FFT_SIZE values, zero padded
+    float *spectrum;              // its transform, then the correlation
+    unsigned long length;         // envelope values
+    double energy;                // sum of squares of the envelope
+    double lag;                   // seconds behind the reference
+    double match;
+    std::atomic<bool> done;
+  };
+
+  // Run \e function on a thread for each of the stems, and wait for them all.
+  void runAll( THREAD_FUNCTION function, unsigned int first );
+
+  // Compute the onset envelope of a stem and its transform.
+  static void analyse( Stem *stem );
+
+  // Find the lag of a stem by correlating it with the reference.
+  static void correlate( Stem *stem );
+
+  static THREAD_RETURN THREAD_TYPE analyseThread( void *ptr );
+  static THREAD_RETURN THREAD_TYPE correlateThread( void *ptr );
+
+  Stem stems[ALIGN_STEMS];
+  unsigned int nStems;
+  char msg[256];
+};
+
+#endif // defined(__STEMALIGNER_H)
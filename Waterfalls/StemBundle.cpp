@@ -0,0 +1,205 @@
+/***************************************************/
+/*! \class StemBundle
+    \brief Reader for packed multi-stem ".stems" files.
+
+    A stem bundle holds all the stems of one song in
+    a single file: a header, an index with one entry
+    per stem, and the sample data of each stem in its
+    own block.  Every block starts on a
+    STEMS_ALIGNMENT boundary, so the whole file is
+    opened and memory-mapped once and each stem can
+    be handed to a WvIn without copying (see attach()).
+
+    The index gives the name, sample rate, peak and
+    icon (an image file name) of each stem.  Sample
+    data is stored as 16-bit integers or 32-bit floats
+    with the channels of a stem interleaved.  All
+    values are little-endian.
+
+    Bundles are written by the stemspack tool.
+
+    The bundle must stay open as long as any WvIn it
+    was attached to is in use.
+*/
+/***************************************************/
+
+#include "StemBundle.h"
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <string.h>
+
+#if !defined(__OS_WINDOWS__)
+  #include <sys/mman.h>
+  #include <unistd.h>
+#endif
+
+StemBundle :: StemBundle()
+  : mapBase(0), mapLength(0), entries(0), stemCount(0)
+{
+}
+
+StemBundle :: StemBundle( const char *fileName )
+  : mapBase(0), mapLength(0), entries(0), stemCount(0)
+{
+  openFile( fileName );
+}
+
+StemBundle :: ~StemBundle()
+{
+  closeFile();
+}
+
+void StemBundle :: openFile( const char *fileName )
+{
+  closeFile();
+
+#if !defined(__OS_WINDOWS__)
+  // The data is used in place, so it has to be in our byte order.
+  UINT32 one = 1;
+  if ( *(unsigned char *) &one != 1 ) {
+    sprintf(msg, "StemBundle: Bundles can't be read on big-endian hosts (%s).", fileName);
+    handleError(msg, StkError::FILE_ERROR);
+  }
+
+  int fd = open( fileName, O_RDONLY );
+  if ( fd == -1 ) {
+    sprintf(msg, "StemBundle: Could not open or find file (%s).", fileName);
+    handleError(msg, StkError::FILE_NOT_FOUND);
+  }
+
+  struct stat filestat;
+  if ( fstat(fd, &filestat) == -1 || (size_t) filestat.st_size < sizeof(StemsHeader) ) {
+    close( fd );
+    sprintf(msg, "StemBundle: File (%s) is not a stem bundle.", fileName);
+    handleError(msg, StkError::FILE_UNKNOWN_FORMAT);
+  }
+
+  // One mapping for the index and all the stems.
+  size_t length = filestat.st_size;
+  void *base = mmap(0, length, PROT_READ, MAP_SHARED, fd, 0);
+  close( fd );
+  if ( base == MAP_FAILED ) {
+    sprintf(msg, "StemBundle: Could not map file (%s).", fileName);
+    handleError(msg, StkError::FILE_ERROR);
+  }
+  mapBase = base;
+  mapLength = length;
+
+  const StemsHeader *header = (const StemsHeader *) base;
+  if ( strncmp(header->magic, STEMS_MAGIC, 8) ) {
+    closeFile();
+    sprintf(msg, "StemBundle: File (%s) is not a stem bundle.", fileName);
+    handleError(msg, StkError::FILE_UNKNOWN_FORMAT);
+  }
+  if ( header->version != STEMS_VERSION ) {
+    closeFile();
+    sprintf(msg, "StemBundle: File (%s) has unsupported version %d.", fileName, header->version);
+    handleError(msg, StkError::FILE_UNKNOWN_FORMAT);
+  }
+  if ( header->stems == 0 ||
+       sizeof(StemsHeader) + (size_t) header->stems * sizeof(StemsEntry) > length )
+    goto error;
+
+  entries = (const StemsEntry *) (header + 1);
+  stemCount = header->stems;
+
+  // Check that every block lies within the file before anyone reads it.
+  for (unsigned int i=0; i<stemCount; i++) {
+    const StemsEntry *e = &entries[i];
+    UINT64 bytes;
+    if ( e->format == STK_SINT16 ) bytes = 2;
+    else if ( e->format == MY_FLOAT32 ) bytes = 4;
+    else goto error;
+    if ( e->channels == 0 || e->frames == 0 || e->sampleRate <= 0.0 ) goto error;
+    if ( e->offset % STEMS_ALIGNMENT || e->frames > length ) goto error;
+    // (frames is at most length, so only the channels can overflow this)
+    bytes *= e->frames;
+    if ( e->channels > length / bytes ) goto error;
+    bytes *= e->channels;
+    if ( e->offset > length || bytes > length - e->offset ) goto error;
+    if ( e->name[STEMS_NAME_LENGTH-1] || e->icon[STEMS_ICON_LENGTH-1] ) goto error;
+
+    // Each stem is read front to back, independently of the others.
+#if defined(MADV_SEQUENTIAL)
+    madvise( (char *) base + e->offset, (size_t) bytes, MADV_SEQUENTIAL );
+#endif
+  }
+  return;
+
+ error:
+  closeFile();
+  sprintf(msg, "StemBundle: Invalid stem index in file (%s).", fileName);
+  handleError(msg, StkError::FILE_ERROR);
+#else
+  sprintf(msg, "StemBundle: Stem bundles are not supported on this platform (%s).", fileName);
+  handleError(msg, StkError::FILE_ERROR);
+#endif
+}
+
+void StemBundle :: closeFile( void )
+{
+#if !defined(__OS_WINDOWS__)
+  if ( mapBase ) munmap(mapBase, mapLength);
+#endif
+  mapBase = 0;
+  mapLength = 0;
+  entries = 0;
+  stemCount = 0;
+}
+
+const StemsEntry *StemBundle :: entry( unsigned int stem ) const
+{
+  if ( stem >= stemCount ) {
+    sprintf(msg, "StemBundle: Stem index %d is out of range.", stem);
+    handleError(msg, StkError::FUNCTION_ARGUMENT);
+  }
+  return &entries[stem];
+}
+
+unsigned int StemBundle :: getStemCount( void ) const
+{
+  return stemCount;
+}
+
+const char *StemBundle :: getName( unsigned int stem ) const
+{
+  return entry(stem)->name;
+}
+
+const char *StemBundle :: getIcon( unsigned int stem ) const
+{
+  return entry(stem)->icon;
+}
+
+MY_FLOAT StemBundle :: getFileRate( unsigned int stem ) const
+{
+  return (MY_FLOAT) entry(stem)->sampleRate;
+}
+
+unsigned long StemBundle :: getSize( unsigned int stem ) const
+{
+  return (unsigned long) entry(stem)->frames;
+}
+
+unsigned int StemBundle :: getChannels( unsigned int stem ) const
+{
+  return entry(stem)->channels;
+}
+
+MY_FLOAT StemBundle :: getPeak( unsigned int stem ) const
+{
+  return entry(stem)->peak;
+}
+
+void StemBundle :: attach( unsigned int stem, WvIn *input, bool doNormalize ) const
+{
+  const StemsEntry *e = entry(stem);
+
+  // WvIn wants the peak in sample units.
+  MY_FLOAT peak = e->peak;
+  if ( e->format == STK_SINT16 ) peak *= 32768.0;
+
+  input->attachData( (const char *) mapBase + e->offset, (unsigned long) e->frames, e->channels,
+                     e->format, (MY_FLOAT) e->sampleRate, peak, doNormalize );
+}
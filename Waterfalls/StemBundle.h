@@ -0,0 +1,128 @@
+/***************************************************/
+/*! \class StemBundle
+    \brief Reader for packed multi-stem ".stems" files.
+
+    A stem bundle holds all the stems of one song in
+    a single file: a header, an index with one entry
+    per stem, and the sample data of each stem in its
+    own block.  Every block starts on a
+    STEMS_ALIGNMENT boundary, so the whole file is
+    opened and memory-mapped once and each stem can
+    be handed to a WvIn without copying (see attach()).
+
+    The index gives the name, sample rate, peak and
+    icon (an image file name) of each stem.  Sample
+    data is stored as 16-bit integers or 32-bit floats
+    with the channels of a stem interleaved.  All
+    values are little-endian.
+
+    Bundles are written by the stemspack tool.
+
+    The bundle must stay open as long as any WvIn it
+    was attached to is in use.
+*/
+/***************************************************/
+
+#if !defined(__STEMBUNDLE_H)
+#define __STEMBUNDLE_H
+
+#include "Stk.h"
+#include "WvIn.h"
+#include <stddef.h>
+
+#define STEMS_MAGIC "STEMBNDL"
+#define STEMS_VERSION 1
+#define STEMS_ALIGNMENT 4096     // bytes, a multiple of the page size
+#define STEMS_NAME_LENGTH 32
+#define STEMS_ICON_LENGTH 64
+
+// File header, at offset zero.
+struct StemsHeader {
+  char magic[8];
+  UINT32 version;
+  UINT32 stems;        // number of StemsEntry records following the header
+  UINT32 alignment;    // alignment of the stem data blocks
+  UINT32 reserved;
+};
+
+// Index entry, one per stem.
+struct StemsEntry {
+  char name[STEMS_NAME_LENGTH];
+  char icon[STEMS_ICON_LENGTH];
+  FLOAT64 sampleRate;
+  UINT64 offset;       // byte offset of the data block
+  UINT64 frames;
+  UINT32 channels;
+  UINT32 format;       // Stk::STK_SINT16 or Stk::MY_FLOAT32
+  FLOAT32 peak;        // maximum magnitude, full scale is 1.0
+  UINT32 reserved;
+};
+
+class StemBundle : public Stk
+{
+public:
+  //! Default constructor.
+  StemBundle();
+
+  //! Overloaded constructor which opens a bundle.
+  /*!
+    An StkError will be thrown if the file is not found or is not a
+    valid stem bundle.
+  */
+  StemBundle( const char *fileName );
+
+  //! Class destructor.
+  ~StemBundle();
+
+  //! Open and map the specified bundle.
+  /*!
+    An StkError will be thrown if the file is not found or is not a
+    valid stem bundle.
+  */
+  void openFile( const char *fileName );
+
+  //! If a bundle is open, unmap and close it.
+  void closeFile( void );
+
+  //! Return the number of stems in the bundle.
+  unsigned int getStemCount( void ) const;
+
+  //! Return the name of stem \e stem.
+  const char *getName( unsigned int stem ) const;
+
+  //! Return the icon file name of stem \e stem, which may be empty.
+  const char *getIcon( unsigned int stem ) const;
+
+  //! Return the sample rate of stem \e stem in Hz.
+  MY_FLOAT getFileRate( unsigned int stem ) const;
+
+  //! Return the size of stem \e stem in sample frames.
+  unsigned long getSize( unsigned int stem ) const;
+
+  //! Return the number of channels of stem \e stem.
+  unsigned int getChannels( unsigned int stem ) const;
+
+  //! Return the peak magnitude of stem \e stem, relative to full scale.
+  MY_FLOAT getPeak( unsigned int stem ) const;
+
+  //! Point \e input at the data of stem \e stem.
+  /*!
+    If \e doNormalize is TRUE, the stored peak is used to normalize
+    the output to +-1.0 without scanning the data.  An StkError will
+    be thrown if \e stem is out of range.
+  */
+  void attach( unsigned int stem, WvIn *input, bool doNormalize = TRUE ) const;
+
+protected:
+
+  // Return the index entry of stem \e stem, or throw an StkError.
+  const StemsEntry *entry( unsigned int stem ) const;
+
+  mutable char msg[256];
+  void *mapBase;
+  size_t mapLength;
+  const StemsEntry *entries;
+  unsigned int stemCount;
+};
+
+#endif // defined(__STEMBUNDLE_H)
@@ -0,0 +1,178 @@
+/***************************************************/
+/*! \class StemLoader
+    \brief Opens audio files in parallel on a pool of threads.
+
+    Each file queued with load() is opened into a
+    WvIn by one of LOADER_THREADS worker threads,
+    without normalization.  Once its first
+    LOADER_PRELOAD seconds are in memory the stem is
+    "ready" and can be played.  The worker then
+    finds the peak of the rest of the data in the
+    background, after which the stem is "loaded" and
+    getPeak() returns the normalization peak, and
+    getStats() the levels of its blocks.  Files
+    opened before are loaded at once, with the
+    levels from their PeakCache.
+
+    isReady(), isLoaded(), getPeak() and getStats()
+    don't lock and can be called from the audio
+    thread.  A WvIn must not be ticked before its
+    stem is ready.
+*/
+/***************************************************/
+
+#include "StemLoader.h"
+
+StemLoader :: StemLoader( unsigned int nThreads )
+  : jobCount(0), nextJob(0), workers(0), nWorkers(0), running(true), active(0)
+{
+  if ( nThreads == 0 ) nThreads = 1;
+  workers = new Thread[nThreads];
+  for (nWorkers=0; nWorkers<nThreads; nWorkers++) {
+    active++;
+    if ( !workers[nWorkers].start( &workerThread, this ) ) {
+      active--;
+      break;
+    }
+  }
+
+  if ( nWorkers < nThreads ) {
+    stop();
+    sprintf(msg, "StemLoader: Unable to start a worker thread.");
+    handleError(msg, StkError::PROCESS_THREAD);
+  }
+}
+
+StemLoader :: ~StemLoader()
+{
+  stop();
+}
+
+void StemLoader :: stop( void )
+{
+  // Let the workers finish what they are doing rather than cancelling them.
+  running = false;
+  while ( active > 0 ) Stk::sleep( LOADER_POLL );
+  for (unsigned int i=0; i<nWorkers; i++)
+    workers[i].wait();
+  delete [] workers;
+  workers = 0;
+  nWorkers = 0;
+}
+
+unsigned int StemLoader :: load( const char *fileName, WvIn *input, bool doMap )
+{
+  mutex.lock();
+  unsigned int n = jobCount;
+  if ( n == LOADER_JOBS ) {
+    mutex.unlock();
+    sprintf(msg, "StemLoader: Too many files (%d) queued.", LOADER_JOBS + 1);
+    handleError(msg, StkError::FUNCTION_ARGUMENT);
+  }
+  jobs[n].fileName = fileName;
+  jobs[n].input = input;
+  jobs[n].doMap = doMap;
+  jobs[n].peak = 0.0;
+  jobs[n].state = JOB_QUEUED;
+  jobCount = n + 1;
+  mutex.unlock();
+
+  return n;
+}
+
+bool StemLoader :: waitReady( void )
+{
+  bool ok = true;
+  unsigned int count = jobCount;
+  for (unsigned int i=0; i<count; i++) {
+    while ( jobs[i].state < JOB_READY ) Stk::sleep( LOADER_POLL );
+    if ( jobs[i].state == JOB_FAILED ) ok = false;
+  }
+  return ok;
+}
+
+bool StemLoader :: isReady( unsigned int job ) const
+{
+  if ( job >= jobCount ) return false;
+  int state = jobs[job].state;
+  return state == JOB_READY || state == JOB_LOADED;
+}
+
+bool StemLoader :: isLoaded( unsigned int job ) const
+{
+  if ( job >= jobCount ) return false;
+  return jobs[job].state == JOB_LOADED;
+}
+
+bool StemLoader :: hasFailed( unsigned int job ) const
+{
+  if ( job >= jobCount ) return false;
+  return jobs[job].state == JOB_FAILED;
+}
+
+MY_FLOAT StemLoader :: getPeak( unsigned int job ) const
+{
+  if ( !isLoaded( job ) ) return 0.0;
+  return jobs[job].peak;
+}
+
+const PeakStats *StemLoader :: getStats( unsigned int job ) const
+{
+  if ( !isLoaded( job ) || jobs[job].stats.blocks == 0 ) return 0;
+  return &jobs[job].stats;
+}
+
+void StemLoader :: run( Job *job )
+{
+  WvIn *input = job->input;
+  try {
+    input->openFile( job->fileName, FALSE, FALSE, job->doMap );
+  }
+  catch ( StkError & ) {
+    // The error has been reported by handleError().
+    job->state = JOB_FAILED;
+    return;
+  }
+
+  // Bring the beginning into memory so playback can start right away.
+  unsigned long frames = (unsigned long) (LOADER_PRELOAD * input->getFileRate());
+  input->getPeak( 0, frames );
+
+  // A file which has been opened before has its peak cached.
+  PeakStats &stats = job->stats;
+  if ( input->getStats( &stats, FALSE ) ) {
+    job->peak = stats.peak;
+    job->state = JOB_LOADED;
+    return;
+  }
+  job->state = JOB_READY;
+
+  // Otherwise the whole file is read to find it, while the stem plays.
+  // If that fails, the stem is left as it is.
+  if ( input->getStats( &stats ) ) job->peak = stats.peak;
+  else {
+    job->peak = 0.0;
+    stats.resize( 0 );
+  }
+  job->state = JOB_LOADED;
+}
+
+THREAD_RETURN THREAD_TYPE StemLoader :: workerThread( void *ptr )
+{
+  StemLoader *loader = (StemLoader *) ptr;
+
+  while ( loader->running ) {
+    Job *job = 0;
+    loader->mutex.lock();
+    if ( loader->nextJob < loader->jobCount )
+      job = &loader->jobs[loader->nextJob++];
+    if ( job ) job->state = JOB_OPENING;
+    loader->mutex.unlock();
+
+    if ( job ) loader->run( job );
+    else Stk::sleep( LOADER_POLL );
+  }
+
+  loader->active--;
+  return 0;
+}
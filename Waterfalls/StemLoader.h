@@ -0,0 +1,108 @@
+/***************************************************/
+/*! \class StemLoader
+    \brief Opens audio files in parallel on a pool of threads.
+
+    Each file queued with load() is opened into a
+    WvIn by one of LOADER_THREADS worker threads,
+    without normalization.  Once its first
+    LOADER_PRELOAD seconds are in memory the stem is
+    "ready" and can be played.  The worker then
+    finds the peak of the rest of the data in the
+    background, after which the stem is "loaded" and
+    getPeak() returns the normalization peak, and
+    getStats() the levels of its blocks.  Files
+    opened before are loaded at once, with the
+    levels from their PeakCache.
+
+    isReady(), isLoaded(), getPeak() and getStats()
+    don't lock and can be called from the audio
+    thread.  A WvIn must not be ticked before its
+    stem is ready.
+*/
+/***************************************************/
+
+#if !defined(__STEMLOADER_H)
+#define __STEMLOADER_H
+
+#define LOADER_THREADS 4
+#define LOADER_JOBS 16
+#define LOADER_PRELOAD 3.0     // seconds
+#define LOADER_POLL 2          // milliseconds
+
+#include "Stk.h"
+#include "WvIn.h"
+#include "Thread.h"
+#include <atomic>
+
+class StemLoader : public Stk
+{
+public:
+  //! Class constructor, which starts \e nThreads worker threads.
+  /*!
+    An StkError will be thrown if a thread cannot be started.
+  */
+  StemLoader( unsigned int nThreads = LOADER_THREADS );
+
+  //! Class destructor, which stops the workers once their current files are open.
+  ~StemLoader();
+
+  //! Queue \e fileName to be opened into \e input and return its job number.
+  /*!
+    The file is opened with doNormalize FALSE and the given \e doMap
+    argument (see WvIn::openFile()).  \e fileName must stay valid until
+    the job is ready.  An StkError will be thrown if more than
+    LOADER_JOBS files are queued.
+  */
+  unsigned int load( const char *fileName, WvIn *input, bool doMap = TRUE );
+
+  //! Wait until every queued file is ready or has failed.  Return FALSE if any failed.
+  bool waitReady( void );
+
+  //! Query whether the file of job \e job is open and its first seconds are in memory.
+  bool isReady( unsigned int job ) const;
+
+  //! Query whether the peak of job \e job has been found.
+  bool isLoaded( unsigned int job ) const;
+
+  //! Query whether the file of job \e job could not be opened.
+  bool hasFailed( unsigned int job ) const;
+
+  //! Return the peak of job \e job in the units of its data, or zero before it is loaded.
+  MY_FLOAT getPeak( unsigned int job ) const;
+
+  //! Return the levels of job \e job, with its block index, or NULL before it is loaded or if they could not be found.
+  const PeakStats *getStats( unsigned int job ) const;
+
+protected:
+
+  enum { JOB_QUEUED, JOB_OPENING, JOB_READY, JOB_LOADED, JOB_FAILED };
+
+  struct Job {
+    const char *fileName;
+    WvIn *input;
+    bool doMap;
+    MY_FLOAT peak;
+    PeakStats stats;
+    std::atomic<int> state;
+  };
+
+  // Open the file of \e job and find its peak.
+  void run( Job *job );
+
+  // Stop and join the worker threads.
+  void stop( void );
+
+  static THREAD_RETURN THREAD_TYPE workerThread( void *ptr );
+
+  Job jobs[LOADER_JOBS];
+  std::atomic<unsigned int> jobCount;
+  Mutex mutex;
+  unsigned int nextJob;
+  Thread *workers;
+  unsigned int nWorkers;
+  std::atomic<bool> running;
+  std::atomic<unsigned int> active;
+  char msg[256];
+};
+
+#endif // defined(__STEMLOADER_H)
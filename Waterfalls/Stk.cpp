@@ -6,7 +6,9 @@
     The global sample rate can be queried and
     modified via Stk.  In addition, this class
     provides error handling and byte-swapping
-    functions.
+    functions.  The StkFrames class, which holds
+    blocks of interleaved audio data, is also
+    implemented here.
 
     by Perry R. Cook and Gary P. Scavone, 1995 - 2002.
 */
@@ -20,6 +22,7 @@ MY_FLOAT Stk :: srate = (MY_FLOAT) SRATE;
 std::string Stk :: rawwavepath = RAWWAVE_PATH;
 const Stk::STK_FORMAT Stk :: STK_SINT8 = 1;
 const Stk::STK_FORMAT Stk :: STK_SINT16 = 2;
+const Stk::STK_FORMAT Stk :: STK_SINT24 = 4;
 const Stk::STK_FORMAT Stk :: STK_SINT32 = 8;
 const Stk::STK_FORMAT Stk :: MY_FLOAT32 = 16;
 const Stk::STK_FORMAT Stk :: MY_FLOAT64 = 32;
@@ -156,4 +159,28 @@ StkError :: ~StkError(void)
 void StkError :: printMessage(void)
 {
   printf("\n%s\n\n", message);
+}
+
+StkFrames :: StkFrames( unsigned int nFrames, unsigned int nChannels )
+  : buffer(0), bufferSize(0), frameCount(0), channelCount(0)
+{
+  resize( nFrames, nChannels );
+}
+
+StkFrames :: ~StkFrames()
+{
+  if ( buffer ) delete [] buffer;
+}
+
+void StkFrames :: resize( unsigned int nFrames, unsigned int nChannels )
+{
+  size_t samples = (size_t) nFrames * nChannels;
+  if ( samples > bufferSize ) {
+    if ( buffer ) delete [] buffer;
+    buffer = new MY_FLOAT[samples];
+    bufferSize = samples;
+  }
+  if ( samples ) memset( buffer, 0, samples * sizeof(MY_FLOAT) );
+  frameCount = nFrames;
+  channelCount = nChannels;
 }
\ No newline at end of file
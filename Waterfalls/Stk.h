@@ -80,6 +80,53 @@ public:
 };
 
 
+//! An STK class to handle blocks of audio data.
+/*!
+  This class holds single- or multi-channel audio data in
+  interleaved format.  The samples are stored contiguously, so
+  that a whole block can be computed in one call and processed
+  with simple loops rather than one sample at a time.
+*/
+class StkFrames
+{
+public:
+  //! The default constructor initializes the frame data structure to size zero.
+  StkFrames( unsigned int nFrames = 0, unsigned int nChannels = 1 );
+
+  //! The destructor.
+  ~StkFrames();
+
+  //! Subscript operator which returns a reference to element \e n of self.
+  MY_FLOAT& operator[] ( size_t n ) { return buffer[n]; };
+
+  //! Subscript operator which returns the value at element \e n of self.
+  MY_FLOAT operator[] ( size_t n ) const { return buffer[n]; };
+
+  //! Return a reference to the sample of \e channel in \e frame.
+  MY_FLOAT& operator() ( size_t frame, unsigned int channel ) { return buffer[frame * channelCount + channel]; };
+
+  //! Resize self to hold \e nFrames of \e nChannels.  Existing data is not preserved.
+  void resize( unsigned int nFrames, unsigned int nChannels = 1 );
+
+  //! Return the total number of samples (frames * channels).
+  size_t size( void ) const { return frameCount * channelCount; };
+
+  //! Return the number of sample frames.
+  unsigned int frames( void ) const { return frameCount; };
+
+  //! Return the number of channels.
+  unsigned int channels( void ) const { return channelCount; };
+
+private:
+  StkFrames( const StkFrames& );
+  StkFrames& operator= ( const StkFrames& );
+
+  MY_FLOAT *buffer;
+  size_t bufferSize;
+  unsigned int frameCount;
+  unsigned int channelCount;
+};
+
 class Stk
 {
 public:
@@ -87,6 +134,7 @@ public:
   typedef unsigned long STK_FORMAT;
   static const STK_FORMAT STK_SINT8;   /*!< -128 to +127 */
   static const STK_FORMAT STK_SINT16;  /*!< -32768 to +32767 */
+  static const STK_FORMAT STK_SINT24;  /*!< -8388608 to +8388607, packed in 3 bytes. */
   static const STK_FORMAT STK_SINT32;  /*!< -2147483648 to +2147483647. */
   static const STK_FORMAT MY_FLOAT32; /*!< Normalized between plus/minus 1.0. */
   static const STK_FORMAT MY_FLOAT64; /*!< Normalized between plus/minus 1.0. */
@@ -142,7 +190,10 @@ protected:
 
 // Here are a few other useful typedefs.
 typedef signed short SINT16;
+typedef unsigned short UINT16;
 typedef signed int SINT32;
+typedef unsigned int UINT32;
+typedef unsigned long long UINT64;
 typedef float FLOAT32;
 typedef double FLOAT64;
 
@@ -22,8 +22,10 @@ Thread :: ~Thread()
 {
 #if (defined(__OS_IRIX__) || defined(__OS_LINUX__) || defined(__OS_MACOSX__)) || defined(__WINDOWS_PTHREAD__)
 
-  pthread_cancel(thread);
-  pthread_join(thread, NULL);
+  if ( thread ) {
+    pthread_cancel(thread);
+    pthread_join(thread, NULL);
+  }
 
 #elif defined(__OS_WINDOWS__)
 
@@ -55,8 +57,12 @@ bool Thread :: wait( long milliseconds )
   bool result = false;
 #if (defined(__OS_IRIX__) || defined(__OS_LINUX__) || defined(__OS_MACOSX__)) || defined(__WINDOWS_PTHREAD__)
 
-  pthread_cancel(thread);
-  pthread_join(thread, NULL);
+  if ( thread ) {
+    pthread_cancel(thread);
+    pthread_join(thread, NULL);
+    thread = 0;
+  }
+  result = true;
 
 #elif defined(__OS_WINDOWS__)
 
@@ -0,0 +1,248 @@
+/***************************************************/
+/*! \class TimeStretch
+    \brief Phase-vocoder time stretcher.
+
+    This class changes the speed of a stream of
+    interleaved sample frames without changing its
+    pitch.  Overlapping Hann-windowed frames of
+    STRETCH_FFT_SIZE input samples are taken every
+    speed * STRETCH_HOP input frames, transformed with
+    rfft(), and resynthesized every STRETCH_HOP output
+    frames with their phases advanced to match.  The
+    phases of the bins around each spectral peak are
+    locked to the peak, which keeps transients and
+    chords from sounding smeared.  At a speed of 1.0
+    the input is reconstructed exactly.
+
+    Frames are passed in with write() and computed
+    with read(), as with a Resampler.  No memory is
+    allocated except by the constructor.
+*/
+/***************************************************/
+
+#include "TimeStretch.h"
+#include "chuck_fft.h"
+#include <math.h>
+#include <string.h>
+
+#define STRETCH_BINS (STRETCH_FFT_SIZE/2 + 1)
+
+// Overlap-add gain: the squared Hann windows of frames STRETCH_HOP apart sum to 1.5.
+#define STRETCH_NORM (1.0 / 1.5)
+
+TimeStretch :: TimeStretch( unsigned int nChannels )
+  : channels(nChannels), speed(1.0)
+{
+  if ( channels == 0 ) channels = 1;
+
+  // Room for a frame and the input consumed by a hop at the highest speed.
+  capacity = STRETCH_FFT_SIZE + (unsigned long) ceil( STRETCH_MAX_SPEED * STRETCH_HOP ) + 1;
+  input = new MY_FLOAT[capacity * channels];
+  window = new float[STRETCH_FFT_SIZE];
+  frame = new float[STRETCH_FFT_SIZE];
+  magnitude = new MY_FLOAT[STRETCH_BINS];
+  phase = new MY_FLOAT[STRETCH_BINS];
+  lastPhase = new MY_FLOAT[STRETCH_BINS * channels];
+  synthPhase = new double[STRETCH_BINS * channels];
+  peaks = new unsigned int[STRETCH_BINS];
+  overlap = new MY_FLOAT[STRETCH_FFT_SIZE * channels];
+
+  make_window( window, STRETCH_FFT_SIZE );
+
+  reset();
+}
+
+TimeStretch :: ~TimeStretch()
+{
+  delete [] input;
+  delete [] window;
+  delete [] frame;
+  delete [] magnitude;
+  delete [] phase;
+  delete [] lastPhase;
+  delete [] synthPhase;
+  delete [] peaks;
+  delete [] overlap;
+}
+
+void TimeStretch :: setSpeed( double aSpeed )
+{
+  if ( aSpeed < STRETCH_MIN_SPEED ) aSpeed = STRETCH_MIN_SPEED;
+  if ( aSpeed > STRETCH_MAX_SPEED ) aSpeed = STRETCH_MAX_SPEED;
+  speed = aSpeed;
+}
+
+double TimeStretch :: getSpeed( void ) const
+{
+  return speed;
+}
+
+void TimeStretch :: reset( void )
+{
+  fill = 0;
+  position = 0.0;
+  lastStart = 0;
+  first = true;
+  available = 0;
+  offset = 0;
+  memset( overlap, 0, STRETCH_FFT_SIZE * channels * sizeof(MY_FLOAT) );
+}
+
+unsigned long TimeStretch :: getSpace( void ) const
+{
+  return capacity - fill;
+}
+
+unsigned long TimeStretch :: write( const MY_FLOAT *in, unsigned long frames )
+{
+  unsigned long n = frames;
+  if ( n > capacity - fill ) n = capacity - fill;
+  for (unsigned int j=0; j<channels; j++) {
+    MY_FLOAT *dst = input + j*capacity + fill;
+    const MY_FLOAT *src = in + j;
+    for (unsigned long i=0; i<n; i++, src+=channels)
+      dst[i] = *src;
+  }
+  fill += n;
+  return n;
+}
+
+unsigned long TimeStretch :: read( MY_FLOAT *out, unsigned long frames )
+{
+  unsigned long i = 0, k;
+  unsigned int j;
+  while ( i < frames ) {
+    if ( available == 0 && !analyze() ) break;
+
+    unsigned long n = frames - i;
+    if ( n > available ) n = available;
+    for (j=0; j<channels; j++) {
+      const MY_FLOAT *src = overlap + j*STRETCH_FFT_SIZE + offset;
+      for (k=0; k<n; k++)
+        out[(i+k)*channels+j] = src[k];
+    }
+    offset += n;
+    available -= n;
+    i += n;
+
+    // The first hop of the overlap is complete once read; move on to the next.
+    if ( available == 0 ) {
+      for (j=0; j<channels; j++) {
+        MY_FLOAT *row = overlap + j*STRETCH_FFT_SIZE;
+        memmove( row, row + STRETCH_HOP, (STRETCH_FFT_SIZE - STRETCH_HOP) * sizeof(MY_FLOAT) );
+        memset( row + STRETCH_FFT_SIZE - STRETCH_HOP, 0, STRETCH_HOP * sizeof(MY_FLOAT) );
+      }
+    }
+  }
+
+  return i;
+}
+
+bool TimeStretch :: analyze( void )
+{
+  long start = (long) position;
+  if ( start + STRETCH_FFT_SIZE > (long) fill ) return false;
+
+  // The actual hop, with the fraction of speed * STRETCH_HOP carried over.
+  long hop = ( first ) ? -1 : start - lastStart;
+
+  for (unsigned int j=0; j<channels; j++) {
+    const MY_FLOAT *in = input + j*capacity + start;
+    unsigned int i;
+    for (i=0; i<STRETCH_FFT_SIZE; i++)
+      frame[i] = window[i] * (float) in[i];
+
+    rfft( frame, STRETCH_FFT_SIZE/2, FFT_FORWARD );
+    adjustPhases( j, frame, hop );
+    rfft( frame, STRETCH_FFT_SIZE/2, FFT_INVERSE );
+
+    MY_FLOAT *out = overlap + j*STRETCH_FFT_SIZE;
+    for (i=0; i<STRETCH_FFT_SIZE; i++)
+      out[i] += (MY_FLOAT) (STRETCH_NORM * window[i] * frame[i]);
+  }
+
+  lastStart = start;
+  first = false;
+  position += speed * STRETCH_HOP;
+  available = STRETCH_HOP;
+  offset = 0;
+
+  // Drop the input before the next frame.
+  unsigned long drop = (unsigned long) position;
+  if ( drop > fill ) drop = fill;
+  for (unsigned int j=0; j<channels; j++)
+    memmove( input + j*capacity, input + j*capacity + drop, (fill - drop) * sizeof(MY_FLOAT) );
+  fill -= drop;
+  position -= drop;
+  lastStart -= drop;
+
+  return true;
+}
+
+void TimeStretch :: adjustPhases( unsigned int channel, float *x, long hop )
+{
+  MY_FLOAT *last = lastPhase + channel*STRETCH_BINS;
+  double *synth = synthPhase + channel*STRETCH_BINS;
+  const double twoPi = 2.0 * PI;
+  unsigned int k, n = STRETCH_BINS - 1;
+
+  // rfft() packs the (real) Nyquist bin next to DC, and its phases
+  // run the other way, so they are negated here and on the way back.
+  magnitude[0] = (MY_FLOAT) fabs( x[0] );
+  phase[0] = (MY_FLOAT) (( x[0] < 0.0 ) ? PI : 0.0);
+  magnitude[n] = (MY_FLOAT) fabs( x[1] );
+  phase[n] = (MY_FLOAT) (( x[1] < 0.0 ) ? PI : 0.0);
+  for (k=1; k<n; k++) {
+    float re = x[2*k], im = -x[2*k+1];
+    magnitude[k] = (MY_FLOAT) sqrt( re*re + im*im );
+    phase[k] = (MY_FLOAT) atan2( im, re );
+  }
+
+  unsigned int count = 0;
+  if ( hop >= 0 ) {
+    for (k=1; k<n; k++)
+      if ( magnitude[k] > magnitude[k-1] && magnitude[k] >= magnitude[k+1] )
+        peaks[count++] = k;
+  }
+
+  if ( count == 0 ) {
+    // First frame (or silence): start from the analysis phases.
+    for (k=0; k<=n; k++)
+      synth[k] = phase[k];
+  }
+  else {
+    // Advance each peak by its measured frequency over the synthesis hop.
+    unsigned int p;
+    for (p=0; p<count; p++) {
+      k = peaks[p];
+      double omega = twoPi * k / STRETCH_FFT_SIZE;
+      double frequency = omega;
+      if ( hop > 0 ) {
+        double delta = phase[k] - last[k] - omega * hop;
+        delta -= twoPi * floor( (delta + PI) / twoPi );
+        frequency += delta / hop;
+      }
+      double s = synth[k] + frequency * STRETCH_HOP;
+      synth[k] = s - twoPi * floor( s / twoPi );
+    }
+
+    // Lock the bins around each peak, up to halfway to the next, to its phase.
+    for (p=0; p<count; p++) {
+      unsigned int peak = peaks[p];
+      unsigned int lo = ( p == 0 ) ? 0 : (peaks[p-1] + peak) / 2 + 1;
+      unsigned int hi = ( p == count-1 ) ? n : (peak + peaks[p+1]) / 2;
+      for (k=lo; k<=hi; k++)
+        if ( k != peak ) synth[k] = synth[peak] + (phase[k] - phase[peak]);
+    }
+  }
+
+  for (k=0; k<=n; k++)
+    last[k] = phase[k];
+
+  x[0] = (float) (magnitude[0] * cos( synth[0] ));
+  x[1] = (float) (magnitude[n] * cos( synth[n] ));
+  for (k=1; k<n; k++) {
+    x[2*k] = (float) (magnitude[k] * cos( synth[k] ));
+    x[2*k+1] = (float) -(magnitude[k] * sin( synth[k] ));
+  }
+}
@@ -0,0 +1,96 @@
+/***************************************************/
+/*! \class TimeStretch
+    \brief Phase-vocoder time stretcher.
+
+    This class changes the speed of a stream of
+    interleaved sample frames without changing its
+    pitch.  Overlapping Hann-windowed frames of
+    STRETCH_FFT_SIZE input samples are taken every
+    speed * STRETCH_HOP input frames, transformed with
+    rfft(), and resynthesized every STRETCH_HOP output
+    frames with their phases advanced to match.  The
+    phases of the bins around each spectral peak are
+    locked to the peak, which keeps transients and
+    chords from sounding smeared.  At a speed of 1.0
+    the input is reconstructed exactly.
+
+    Frames are passed in with write() and computed
+    with read(), as with a Resampler.  No memory is
+    allocated except by the constructor.
+*/
+/***************************************************/
+
+#if !defined(__TIMESTRETCH_H)
+#define __TIMESTRETCH_H
+
+#define STRETCH_FFT_SIZE 2048   // analysis frame length in sample frames (a power of 2)
+#define STRETCH_HOP 512         // output frames per analysis frame
+#define STRETCH_MIN_SPEED 0.25
+#define STRETCH_MAX_SPEED 2.0
+
+#include "Stk.h"
+
+class TimeStretch : public Stk
+{
+public:
+  //! Class constructor for \e nChannels channels.
+  TimeStretch( unsigned int nChannels = 1 );
+
+  //! Class destructor.
+  ~TimeStretch();
+
+  //! Set the number of input frames per output frame (0.8 plays at 80% speed).
+  /*!
+    The speed is clamped to STRETCH_MIN_SPEED - STRETCH_MAX_SPEED.
+    It can be changed at any time without a discontinuity.
+  */
+  void setSpeed( double speed );
+
+  //! Return the current speed.
+  double getSpeed( void ) const;
+
+  //! Discard all buffered input and output.
+  void reset( void );
+
+  //! Return the number of input frames which can be written now.
+  unsigned long getSpace( void ) const;
+
+  //! Buffer up to \e frames interleaved input frames from \e in.  Return the number taken.
+  unsigned long write( const MY_FLOAT *in, unsigned long frames );
+
+  //! Compute up to \e frames interleaved output frames into \e out.
+  /*!
+    Returns the number of frames computed, which is less than
+    \e frames when more input is needed.
+  */
+  unsigned long read( MY_FLOAT *out, unsigned long frames );
+
+protected:
+
+  // Analyze the next frame of input and add its resynthesis to the output.  Returns FALSE if more input is needed.
+  bool analyze( void );
+
+  // Set the phases of one channel's spectrum in \e x for an analysis hop of \e hop frames.
+  void adjustPhases( unsigned int channel, float *x, long hop );
+
+  unsigned int channels;
+  double speed;
+  float *window;
+  MY_FLOAT *input;        // one row of capacity frames per channel
+  unsigned long capacity;
+  unsigned long fill;
+  double position;        // start of the next analysis frame in the input
+  long lastStart;         // start of the previous analysis frame
+  bool first;             // no frame analyzed since the last reset
+  float *frame;           // rfft() works on floats
+  MY_FLOAT *magnitude;
+  MY_FLOAT *phase;
+  MY_FLOAT *lastPhase;    // one row of bins per channel
+  double *synthPhase;     // one row of bins per channel
+  unsigned int *peaks;
+  MY_FLOAT *overlap;      // one row of STRETCH_FFT_SIZE frames per channel
+  unsigned long available;
+  unsigned long offset;
+};
+
+#endif // defined(__TIMESTRETCH_H)
@@ -76,7 +76,7 @@ void Waterfall::init( int buffer_size, int fft_size, int srate, int num_channels
 }
 
 // draw a waterfall!
-void Waterfall::drawWaterfall( float * buffer, int buffer_size, int fft_size, int window_type, int index, int num_soundfiles, bool put_a_donk_on_it, float alphas, float fft_gain ) // + vector for color
+void Waterfall::drawWaterfall( float * buffer, int buffer_size, int fft_size, int window_type, int index, int num_soundfiles, bool put_a_donk_on_it, float alphas, float fft_gain, bool silent, bool transformed ) // + vector for color
 {
     // indices
     int i;
@@ -102,15 +102,16 @@ void Waterfall::drawWaterfall( float * buffer, int buffer_size, int fft_size, in
     // w_num_channels = num_channels;
     
     
-    if( window_type ) // i.e., set window_type to 0 to not use a window
+    if( window_type && !silent && !transformed ) // i.e., set window_type to 0 to not use a window
     {
         // make the transform window (hanning)
         make_window( w_window, (unsigned long)buffer_size );
         apply_window((float *)buffer, w_window, buffer_size);
     }
     
-    // take the fft of the buffer
-    rfft( (float *)buffer, fft_size/2, FFT_FORWARD );
+    // take the fft of the buffer (all zeros if it's silent)
+    if( !silent && !transformed )
+        rfft( (float *)buffer, fft_size/2, FFT_FORWARD );
     // cast to complex type
     complex * cbuffer = (complex *)buffer;
 	
@@ -127,8 +128,11 @@ void Waterfall::drawWaterfall( float * buffer, int buffer_size, int fft_size, in
         // copy x coordinate
         w_spectrums[w_wf_id][i].x = x;
         // scaled to fft_gain
-        w_spectrums[w_wf_id][i].y = w_gain * w_freq_scale * 1.8f * 
-			::pow( w_fft_gain * cmp_abs( cbuffer[i] ), 0.5f ) + y;
+        if( silent )
+            w_spectrums[w_wf_id][i].y = y;
+        else
+            w_spectrums[w_wf_id][i].y = w_gain * w_freq_scale * 1.8f * 
+                ::pow( w_fft_gain * cmp_abs( cbuffer[i] ), 0.5f ) + y;
         
         // increment x
         x += inc * w_freq_view;
@@ -58,8 +58,9 @@ public:
 public:
     // initialize... necessary?
     void init( int buffer_size, int fft_size, int srate, int num_channels );
-    // draw a waterfall!
-    void drawWaterfall( float * buffer, int buffer_size, int fft_size, int window_type, int index, int num_soundfiles, bool put_a_donk_on_it, float alphas, float fft_gain );
+    // draw a waterfall! (a silent buffer adds a flat spectrum, without an fft,
+    // and a transformed one holds the fft already, as from a Lookahead)
+    void drawWaterfall( float * buffer, int buffer_size, int fft_size, int window_type, int index, int num_soundfiles, bool put_a_donk_on_it, float alphas, float fft_gain, bool silent = false, bool transformed = false );
 	double compute_log_spacing( int fft_size, double power );
 
 private:
@@ -3,7 +3,9 @@
 //   desc: Multiple waterfalls to visualize multiple WAVE ins (stems).
 // 	   	   Modeled after Beatles Rock Band, sort of.
 //  usage: Modify filenameArray, mus_file_array, and g_num_soundfiles to play
-//         something other than "And Your Bird Can Sing".
+//         something other than "And Your Bird Can Sing", or pack the stems
+//         with stemspack and run "Waterfalls song.stems". Given several
+//         .stems files, it plays them back to back as a setlist.
 //
 // author: Regina Collecchia 
 //   date: 11/4/13
@@ -21,6 +23,15 @@
 #include "chuck_fft.h"
 #include "Waterfall.h"
 #include "WvIn.h"
+#include "PrefetchWvIn.h"
+#include "Setlist.h"
+#include "Lookahead.h"
+#include "Mixer.h"
+#include "BlockRing.h"
+#include "ControlQueue.h"
+#include "CallbackProfiler.h"
+#include "RealtimeCheck.h"
+#include "TimeStretch.h"
 #include "RgbImage.h"
 // #include "MFCC.h"
 
@@ -45,6 +56,10 @@
 #define MY_SRATE 48000
 // number of channels
 #define MY_CHANNELS 2
+// sound device cache, in the home directory
+#define DEVICE_CACHE ".waterfalls-devices"
+// dB per second a stem's gain moves by, once its peak is found
+#define GAIN_RAMP 4.0
 // zero-padding factor
 #define ZPF 1
 // for convenience
@@ -122,24 +137,35 @@ double g_thresh = 5.0;
 float g_fall = 0.1f;
 double g_log_factor = 1;
 const float deg2rad = MY_PIE / 180;
-bool play_all = true;
-bool play_drums = false;
-bool play_guitar = false;
-bool play_vocals = false;
-bool play_bass = false;
-bool play_tamb = false;
 
 // number of input soundfiles: could make this more scalable, but meh
 const int g_num_soundfiles = 5;
 // and the appropriate number of waterfalls to represent the soundfiles
 Waterfall g_wf[g_num_soundfiles];
 double g_log_space[g_num_soundfiles];
+// the last buffer played, as the display last took it from g_blocks: each
+// stem's power, whether it had nothing to hear (and gets a flat spectrum),
+// and its samples
 double g_avg_pow[g_num_soundfiles];
-// when soloed, don't show other tracks
-float alphas[g_num_soundfiles];
+bool g_silent[g_num_soundfiles];
+// blocks below this fraction of a stem's peak count as silent (-70 dB)
+const MY_FLOAT g_silence = 0.0003f;
+// the stems' gains to each output channel, solos and mutes
+Mixer * g_mixer = NULL;
 float g_fft_gain = 2.0f;
 
 float g_soundfile_buffer[g_num_soundfiles][SND_BUFFER_SIZE*2];
+// the buffers played, on their way from the audio callback to the display
+BlockRing * g_blocks = NULL;
+// how long the audio callback takes to fill each buffer, against how long it has
+CallbackProfiler g_profiler;
+// transforms the stems through their cursors ahead of the output, so each
+// spectrum is drawn when its audio reaches the speakers, not when it's played
+Lookahead * g_lookahead = NULL;
+// the spectrum of one stem, as drawn
+float g_spectrum[SND_FFT_SIZE];
+// one buffer's worth of each stem, filled by the audio callback
+StkFrames g_stem_frames[g_num_soundfiles];
 
 static GLuint textureName[g_num_soundfiles];
 const char * filenameArray[g_num_soundfiles] = {
@@ -156,7 +182,34 @@ const char * mus_file_array[g_num_soundfiles] = {
 	"/Users/probraino/Desktop/bird-bass.wav",
 	"/Users/probraino/Desktop/bird-tamb.wav"
 };
-WvIn * g_input_music[g_num_soundfiles];
+// the songs to play: the packed songs given on the command line, or the stem files above.
+// the next song is opened while one plays, and the callback goes on to it without a gap
+Setlist * g_setlist = NULL;
+// the song last announced on the console
+unsigned int g_shown_song = 0;
+// reads replacement takes typed into the terminal
+Thread g_console;
+// changes from the keyboard, applied by the audio callback between buffers
+// so the stems stay in step and nothing changes part way through a buffer
+ControlQueue g_controls;
+// loop region in seconds (none if empty), marked from the keyboard...
+double g_loop_in = 0.0;
+double g_loop_out = 0.0;
+// ...and as the callback plays it
+double g_play_loop_in = 0.0;
+double g_play_loop_out = 0.0;
+// go on to the next song now (the callback's)
+bool g_skip = false;
+// practice speed, as chosen and as played: once it is changed from 1.0,
+// the stems are time-stretched (same pitch)
+double g_speed = 1.0;
+double g_play_speed = 1.0;
+bool g_stretching = false;
+// stems muted from the keyboard
+bool g_muted[g_num_soundfiles];
+TimeStretch * g_stretch[g_num_soundfiles];
+// stem frames on their way into the stretcher
+MY_FLOAT g_stretch_input[STRETCH_HOP];
 
 
 
@@ -174,7 +227,14 @@ void changeLookAt( pt3d look_from, pt3d look_to, pt3d head_up );
 void drawTambourine( float scale, float x, float y, float tempo, float inst_total );
 void loadTextureFromFile( char * filename );
 void initFiveImages( const char * filenames[] );
-void initAudioFiles( const char * filenames[] );
+bool fillStem( SetlistSong * song, int f, MY_FLOAT * out, unsigned int frames );
+bool isSilent( SetlistSong * song, int f, unsigned int frames );
+bool indexedPower( SetlistSong * song, int f, unsigned int frames, double * power );
+void stretchStem( SetlistSong * song, int f, MY_FLOAT * out, unsigned int frames );
+unsigned long framesLeft( SetlistSong * song );
+bool applyControls( SetlistSong * song );
+void sendControl( Control::TYPE type, unsigned int stem, double value = 0.0, double end = 0.0 );
+THREAD_RETURN THREAD_TYPE consoleThread( void * ptr );
 void drawTextureQuad( int i );
 
 
@@ -200,6 +260,16 @@ void help()
     fprintf( stderr, "'4' - solo track 4 (bass) \n" );
     fprintf( stderr, "'5' - solo track 5 (tambourine and the rest) \n" );
     fprintf( stderr, "'0' - play all tracks (default) \n" );
+    fprintf( stderr, "'!', '@', '#', '$', '%%' (shift 1-5) - mute or unmute track 1-5 \n" );
+    fprintf( stderr, "'[' - mark the start of a loop here \n" );
+    fprintf( stderr, "']' - mark the end of the loop here and start looping \n" );
+    fprintf( stderr, "'\\' - stop looping \n" );
+    fprintf( stderr, "'r' - rewind to the start of the song \n" );
+    fprintf( stderr, "'-' - slow down by 5%% without changing the pitch \n" );
+    fprintf( stderr, "'=' - speed up by 5%% without changing the pitch \n" );
+    fprintf( stderr, "'.' - skip to the next song in the setlist \n" );
+    fprintf( stderr, "'p' - print how long the audio callback takes to fill each buffer \n" );
+    fprintf( stderr, "type '3 take2.wav' and return in the terminal to replace stem 3 live \n" );
     fprintf( stderr, "'j', mousedown - spin left around the waterfall, increasingly \n" );
     fprintf( stderr, "'i' - increase the gain of the FFT by 1.0 \n" );
     fprintf( stderr, "'l' - spin right around the waterfall, increasingly \n" );
@@ -219,79 +289,108 @@ int audio_callback( void * outputBuffer, void * inputBuffer, unsigned int numFra
     // unused mic input
     // SAMPLE * input = (SAMPLE *)inputBuffer;
     SAMPLE * output = (SAMPLE *)outputBuffer;
-		
+    UINT64 started = g_profiler.start();
+    // nothing from here on should allocate, lock or wait (checked when built with RTCHECK=1)
+    RealtimeCheck::enter( "audio_callback" );
+    // each stem's block, its power and whether it's silent, for the
+    // mixer and the display
+    const MY_FLOAT * blocks[g_num_soundfiles];
+    double stem_power[g_num_soundfiles];
+    bool stem_silent[g_num_soundfiles];
+
 	memset( g_audio_buffer, 0, numFrames * sizeof(float) );
-    for( int f = 0; f < g_num_soundfiles; f++ )
-    {
-        g_avg_pow[f] = 0.0f;
-    }
-    
+
+	// swap in a replaced stem, if one is ready, and free what we were done with
+	bool replaced = g_setlist->update();
+	SetlistSong * song = g_setlist->getSong();
+
+	// take the changes sent since the last buffer
+	bool loop_changed = applyControls( song );
+	// (a replaced stem has to be looped like the others)
+	if( loop_changed || replaced )
+	{
+		for( int f = 0; f < g_num_soundfiles; f++ )
+		{
+			// the loop is in seconds, the stems may differ in rate, length and start
+			MY_FLOAT rate = song->stems[f]->getFileRate();
+			unsigned long start = (unsigned long)( song->start[f] + g_play_loop_in * rate );
+			unsigned long end = (unsigned long)( song->start[f] + g_play_loop_out * rate );
+			if( end > song->stems[f]->getSize() ) end = song->stems[f]->getSize();
+			if( end > start )
+				song->stems[f]->setLoop( start, end );
+			else
+				song->stems[f]->clearLoop();
+		}
+	}
+
+	// the stems are where this buffer starts: have it analysed
+	if( g_lookahead ) g_lookahead->mark( streamTime * MY_SRATE, numFrames );
+
+	// play up to the end of the song and go on to the next one from the
+	// following frame, if it's ready (a loop keeps the song from ending)
+	unsigned int split = numFrames;
+	// (a skip waits, buffer after buffer, until the next song is cued)
+	if( g_skip )
+		split = 0;
+	else if( !song->stems[0]->isLooping() )
+	{
+		unsigned long left = framesLeft( song );
+		if( left < split ) split = (unsigned int)left;
+	}
+	SetlistSong * following = song;
+	if( split < numFrames && g_setlist->next() )
+	{
+		following = g_setlist->getSong();
+		g_skip = false;
+	}
+	else
+		split = numFrames;
+
 	// fill
-	for( size_t i = 0; i < numFrames; i++ )
+	for( int f = 0; f < g_num_soundfiles; f++ )
 	{
-		output[i*2] = 0;
-		output[i*2+1] = 0;
-		// for mono input
-		// g_audio_buffer[i] = (input[i*2] + input[i*2+1])/2;
-		
-		for(int f = 0; f < g_num_soundfiles; f++)
+		// the whole buffer for this stem in one go
+		MY_FLOAT * block = &g_stem_frames[f][0];
+		// the power is read off the stems' level index before they move on
+		double power = 0.0;
+		bool indexed = true;
+		bool silent = true;
+		if( split > 0 )
 		{
-			g_soundfile_buffer[f][i] = g_input_music[f]->tick();
-            if ( play_all == true )
-            {
-                output[i*2] += g_soundfile_buffer[f][i];
-                output[i*2+1] += g_soundfile_buffer[f][i];
-                alphas[f] = 1.0f;
-            } else if ( play_drums == true )
-            {
-                output[i*2] = g_soundfile_buffer[0][i];
-                output[i*2+1] = g_soundfile_buffer[0][i];
-                alphas[f] = 0.2f;
-                alphas[0] = 1.0f;
-            } else if ( play_guitar == true )
-            {
-                output[i*2] = g_soundfile_buffer[1][i];
-                output[i*2+1] = g_soundfile_buffer[1][i];
-                alphas[f] = 0.2f;
-                alphas[1] = 1.0f;
-            } else if ( play_vocals == true )
-            {
-                output[i*2] = g_soundfile_buffer[2][i];
-                output[i*2+1] = g_soundfile_buffer[2][i];
-                alphas[f] = 0.2f;
-                alphas[2] = 1.0f;
-            } else if ( play_bass == true )
-            {
-                output[i*2] = g_soundfile_buffer[3][i];
-                output[i*2+1] = g_soundfile_buffer[3][i];
-                alphas[f] = 0.2f;
-                alphas[3] = 1.0f;
-            } else if ( play_tamb == true )
-            {
-                output[i*2] = g_soundfile_buffer[4][i];
-                output[i*2+1] = g_soundfile_buffer[4][i];
-                alphas[f] = 0.2f;
-                alphas[4] = 1.0f;
-            } else { // just in case :)
-                output[i*2] += g_soundfile_buffer[f][i];
-                output[i*2+1] += g_soundfile_buffer[f][i];
-                alphas[f] = 1.0f;
-            }
-			
-            // get average power for entire buffer, use it to pulse the size of the waterfall
-            g_avg_pow[f] += pow(g_soundfile_buffer[f][i], 2)/(0.5f*(float)numFrames);
-            
-            /* if (i > 4)
-            {
-                g_avg_pow[f] += pow(g_soundfile_buffer[f][i], 2) + pow(g_soundfile_buffer[f][i-1], 2) + pow(g_soundfile_buffer[f][i-2], 2) + pow(g_soundfile_buffer[f][i-3], 2) + pow(g_soundfile_buffer[f][i-4], 2);
-            } else {
-                g_avg_pow[f] = 0.0f;
-            } */
-			// loop it...something like this
-			// if(g_soundfile_buffer[f].isFinished())
-			// 	g_soundfile_buffer[f].reset();
+			indexed = indexedPower( song, f, split, &power );
+			silent = fillStem( song, f, block, split );
+		}
+		if( following != song )
+		{
+			// the new song starts with an empty stretcher
+			g_stretch[f]->reset();
+			indexed = indexedPower( following, f, numFrames - split, &power ) && indexed;
+			silent = fillStem( following, f, block + split, numFrames - split ) && silent;
 		}
+		blocks[f] = block;
+
+		// a stem without an index yet is measured as it plays
+		if( !indexed )
+		{
+			power = 0.0;
+			for( size_t i = 0; i < numFrames; i++ )
+				power += block[i] * block[i];
+		}
+
+		// get average power for entire buffer, use it to pulse the size of the waterfall
+		stem_power[f] = power / (0.5f*(float)numFrames);
+		stem_silent[f] = silent;
 	}
+
+	// mix them all down at once; silent stems aren't read
+	g_mixer->tick( blocks, stem_silent, output, numFrames );
+
+	// and show them (unless the display is behind, when they're dropped)
+	g_blocks->write( streamTime * MY_SRATE, numFrames, blocks, stem_power, stem_silent );
+
+	RealtimeCheck::leave();
+	g_profiler.stop( started, numFrames, MY_SRATE, ( status & RTAUDIO_OUTPUT_UNDERFLOW ) != 0,
+	                 ( status & RTAUDIO_INPUT_OVERFLOW ) != 0 );
 	
 	// g_ready = TRUE:
     
@@ -300,6 +399,239 @@ int audio_callback( void * outputBuffer, void * inputBuffer, unsigned int numFra
 
 
 
+
+//-----------------------------------------------------------------------------
+// name: fillStem()
+// desc: fill frames of stem f of a song, normalized; returns true if its
+//       level index says they are silent, in which case they are zeroed
+//       and the stem is moved on without being read
+//-----------------------------------------------------------------------------
+bool fillStem( SetlistSong * song, int f, MY_FLOAT * out, unsigned int frames )
+{
+	// normalize once the loader has found the peak: the stem has played
+	// at full scale till then, so move to it GAIN_RAMP dB a second, in
+	// a ramp over the frames, rather than jump
+	StemLoader * loader = song->loader;
+	int job = song->job[f];
+	float level = song->gain[f];
+	float target = level;
+	if( job >= 0 && loader->isLoaded( job ) && loader->getPeak( job ) > 0 )
+	{
+		float ratio = (float)pow( 10.0, GAIN_RAMP / 20.0 * frames / Stk::sampleRate() );
+		target = 1.0f / loader->getPeak( job );
+		if( target > level * ratio ) target = level * ratio;
+		else if( target < level / ratio ) target = level / ratio;
+	}
+	song->gain[f] = target;
+
+	if( isSilent( song, f, frames ) )
+	{
+		PrefetchWvIn * stem = song->stems[f];
+		stem->seek( stem->getTime() + frames * stem->getFileRate() / Stk::sampleRate() );
+		memset( out, 0, frames * sizeof(MY_FLOAT) );
+		return true;
+	}
+
+	if( g_stretching )
+		stretchStem( song, f, out, frames );
+	else
+		song->stems[f]->tick( out, frames );
+
+	float step = ( target - level ) / frames;
+	for( size_t i = 0; i < frames; i++, level += step )
+		out[i] *= level;
+	return false;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: isSilent()
+// desc: whether the next frames of stem f of a song are silent, by its level
+//       index (the stretcher and loops read unevenly, so they're not skipped)
+//-----------------------------------------------------------------------------
+bool isSilent( SetlistSong * song, int f, unsigned int frames )
+{
+	PrefetchWvIn * stem = song->stems[f];
+	const PeakStats * levels = song->getLevels( f );
+	if( levels == NULL || g_stretching || stem->isLooping() )
+		return false;
+
+	// a block either side, for the resampler's reach
+	MY_FLOAT peak, square;
+	double span = frames * stem->getFileRate() / Stk::sampleRate();
+	levels->getLevels( stem->getTime() - PEAKCACHE_BLOCK, span + 2 * PEAKCACHE_BLOCK, &peak, &square );
+	return peak <= g_silence * levels->peak;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: indexedPower()
+// desc: add the sum of squares of the next frames of stem f of a song,
+//       normalized, from its level index; false if it has none yet
+//-----------------------------------------------------------------------------
+bool indexedPower( SetlistSong * song, int f, unsigned int frames, double * power )
+{
+	const PeakStats * levels = song->getLevels( f );
+	if( levels == NULL || levels->peak <= 0 )
+		return false;
+
+	PrefetchWvIn * stem = song->stems[f];
+	MY_FLOAT peak, square;
+	double span = frames * stem->getFileRate() / Stk::sampleRate();
+	if( g_stretching ) span *= g_play_speed;
+	levels->getLevels( stem->getTime(), span, &peak, &square );
+	*power += frames * square / ( levels->peak * levels->peak );
+	return true;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: stretchStem()
+// desc: fill frames of stem f at the practice speed, ticking the stem
+//       into its time stretcher as it needs more
+//-----------------------------------------------------------------------------
+void stretchStem( SetlistSong * song, int f, MY_FLOAT * out, unsigned int frames )
+{
+	g_stretch[f]->setSpeed( g_play_speed );
+	unsigned long done = g_stretch[f]->read( out, frames );
+	while( done < frames )
+	{
+		unsigned long n = g_stretch[f]->getSpace();
+		if( n > STRETCH_HOP ) n = STRETCH_HOP;
+		song->stems[f]->tick( g_stretch_input, n );
+		g_stretch[f]->write( g_stretch_input, n );
+		done += g_stretch[f]->read( out + done, frames - done );
+	}
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: framesLeft()
+// desc: output frames until the longest stem of a song runs out
+//-----------------------------------------------------------------------------
+unsigned long framesLeft( SetlistSong * song )
+{
+	double left = 0.0;
+	for( int f = 0; f < g_num_soundfiles; f++ )
+	{
+		// the stems are read at the file rate and resampled to ours
+		PrefetchWvIn * stem = song->stems[f];
+		double frames = ( stem->getSize() - stem->getTime() ) * Stk::sampleRate() / stem->getFileRate();
+		if( frames > left ) left = frames;
+	}
+	// roughly, as the stretcher holds some of the input back
+	if( g_stretching ) left /= g_play_speed;
+	return (unsigned long)ceil( left );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: applyControls()
+// desc: apply the controls sent to the audio callback since the last buffer
+//       to a song; returns true if the loop changed
+//-----------------------------------------------------------------------------
+bool applyControls( SetlistSong * song )
+{
+	bool loop_changed = false;
+	Control control;
+	while( g_controls.pop( &control ) )
+	{
+		switch( control.type )
+		{
+			case Control::GAIN:
+				if( control.stem < g_num_soundfiles && control.channel < MY_CHANNELS )
+					g_mixer->setGain( control.stem, control.channel, control.value );
+				break;
+			case Control::MUTE:
+				g_mixer->setMute( control.stem, control.value != 0.0 );
+				break;
+			case Control::SOLO:
+				g_mixer->setSolo( control.stem, control.value != 0.0 );
+				break;
+			case Control::SOLO_ONLY:
+				g_mixer->setSoloOnly( control.stem );
+				break;
+			case Control::CLEAR_SOLO:
+				g_mixer->clearSolo();
+				break;
+			case Control::SEEK:
+				// move all the stems at once (the seek is in seconds, the
+				// stems may differ in rate and start)
+				for( int f = 0; f < g_num_soundfiles; f++ )
+					song->stems[f]->seek( song->start[f] + control.value * song->stems[f]->getFileRate() );
+				break;
+			case Control::LOOP:
+				g_play_loop_in = control.value;
+				g_play_loop_out = control.end;
+				loop_changed = true;
+				break;
+			case Control::SKIP:
+				g_skip = true;
+				break;
+			case Control::SPEED:
+				g_play_speed = control.value;
+				g_stretching = true;
+				break;
+		}
+	}
+	return loop_changed;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: sendControl()
+// desc: send a control from the keyboard to the audio callback
+//-----------------------------------------------------------------------------
+void sendControl( Control::TYPE type, unsigned int stem, double value, double end )
+{
+	Control control;
+	control.type = type;
+	control.stem = stem;
+	control.channel = 0;
+	control.value = value;
+	control.end = end;
+	if( !g_controls.push( control ) )
+		fprintf( stderr, "too many changes at once, try again \n" );
+}
+
+
+
+//-----------------------------------------------------------------------------
+// name: consoleThread()
+// desc: reads "<stem> <file>" lines from the terminal and swaps that stem of
+//       the song playing for the file, without stopping the audio
+//-----------------------------------------------------------------------------
+THREAD_RETURN THREAD_TYPE consoleThread( void * )
+{
+	char line[512], path[512];
+	int stem;
+	while( fgets( line, sizeof(line), stdin ) )
+	{
+		if( sscanf( line, "%d %511[^\n]", &stem, path ) == 2 && stem >= 1 && stem <= g_num_soundfiles )
+		{
+			fprintf( stderr, "replacing stem %d with %s \n", stem, path );
+			g_setlist->replaceStem( stem - 1, path );
+		}
+		else
+			fprintf( stderr, "to replace a stem, type its number and a file: 3 take2.wav \n" );
+	}
+	return 0;
+}
+
+
+
 //-----------------------------------------------------------------------------
 // name: main()
 // desc: entry point
@@ -307,9 +639,15 @@ int audio_callback( void * outputBuffer, void * inputBuffer, unsigned int numFra
 int main( int argc, char ** argv )
 {
     Stk::setSampleRate(MY_SRATE);
+    // before any of the threads below can call rfft()
+    init_fft();
     
 	RtAudio g_audio;
 	// unsigned int bufferFrames = 512;
+
+    // remember the sound devices, so they're probed again only when they change
+    const char * home = getenv( "HOME" );
+    if( home ) g_audio.setDeviceCache( string( home ) + "/" + DEVICE_CACHE );
 		    
     // check if audio devices exist
     if ( g_audio.getDeviceCount() < 1 ) {
@@ -323,17 +661,42 @@ int main( int argc, char ** argv )
 	
     // set input and output params
     RtAudio::StreamParameters inParams, outParams;
-    inParams.deviceId = g_audio.getDefaultInputDevice(); // mic
+    // the devices played through last time, if nothing has changed since
+    if( !g_audio.getLastDevices( &outParams.deviceId, &inParams.deviceId ) )
+    {
+        inParams.deviceId = g_audio.getDefaultInputDevice(); // mic
+        outParams.deviceId = g_audio.getDefaultOutputDevice(); // speakers
+    }
     inParams.nChannels = 2;
     inParams.firstChannel = 0;
-    outParams.deviceId = g_audio.getDefaultOutputDevice(); // speakers
     outParams.nChannels = 2;
     outParams.firstChannel = 0;
 
     // create stream options
     RtAudio::StreamOptions options;
     
-    initAudioFiles( mus_file_array );
+    try
+    {
+        // the packed songs, or the separate stem files
+        g_setlist = new Setlist( g_num_soundfiles );
+        for( int i = 1; i < argc; i++ ) g_setlist->addBundle( argv[i] );
+        if( argc == 1 ) g_setlist->addFiles( mus_file_array );
+        g_setlist->start();
+
+        // use the first song's icons, if it has them
+        SetlistSong * song = g_setlist->getSong();
+        g_shown_song = song->index;
+        for( int f = 0; f < g_num_soundfiles; f++ )
+        {
+            if( !song->loader ) fprintf( stderr, "stem %d: %s \n", f+1, song->bundle.getName( f ) );
+            if( !song->loader && song->bundle.getIcon( f )[0] ) filenameArray[f] = song->bundle.getIcon( f );
+        }
+    }
+    catch( StkError & e )
+    {
+        // the message has been printed already
+        exit( 1 );
+    }
 			
     // initialize rtaudio & set the audio callback
     try
@@ -357,8 +720,22 @@ int main( int argc, char ** argv )
         // open the audio device for capture and playback
         g_audio.openStream( &outParams, &inParams, MY_FORMAT, MY_SRATE, &g_buffer_size, &audio_callback, NULL, &options );
 
+        // the stems are ticked a whole buffer at a time
+        for( int i = 0; i < g_num_soundfiles; i++ ) g_stem_frames[i].resize( g_buffer_size, 1 );
+        // every stem to both speakers (the mixer starts that way)
+        g_mixer = new Mixer( g_num_soundfiles, MY_CHANNELS, g_buffer_size );
+        g_blocks = new BlockRing( g_num_soundfiles, g_buffer_size );
+
+        // what's played is heard the output latency later
+        g_lookahead = new Lookahead( g_setlist, g_num_soundfiles, g_buffer_size, g_fft_size );
+        g_lookahead->setLatency( g_audio.getOutputLatency() );
+        for( int i = 0; i < g_num_soundfiles; i++ ) g_stretch[i] = new TimeStretch( 1 );
+
 		// start the audio stream
 		g_audio.startStream();
+
+		// new takes can be swapped in from the terminal while it plays
+		g_console.start( &consoleThread, NULL );
     }
     catch( RtError& e ) {
         // error!
@@ -366,6 +743,11 @@ int main( int argc, char ** argv )
 		exit( 1 );
         // goto cleanup;
     }
+    catch( StkError & e )
+    {
+        // the message has been printed already
+        exit( 1 );
+    }
 	
     // initialize GLUT
     glutInit( &argc, argv );
@@ -493,6 +875,16 @@ void keyboardFunc( unsigned char key, int x, int y )
     {
         case 'Q':
         case 'q':
+            for( int f = 0; f < g_num_soundfiles; f++ )
+            {
+                PrefetchWvIn * stem = g_setlist->getSong()->stems[f];
+                if( stem->getUnderruns() )
+                    fprintf( stderr, "stem %d: %lu chunk underruns \n", f+1, stem->getUnderruns() );
+            }
+            if( RealtimeCheck::getViolations() )
+                fprintf( stderr, "%lu calls from the audio callback which may block \n", RealtimeCheck::getViolations() );
+            if( g_blocks->getDropped() )
+                fprintf( stderr, "%lu buffers not shown \n", g_blocks->getDropped() );
             fprintf( stderr, "goodbyeeeee...i love youuuu... \n");
             exit( 1 );
             break;
@@ -522,58 +914,41 @@ void keyboardFunc( unsigned char key, int x, int y )
             break;
         case '1':
             // solo track 1
-            play_all = false;
-            play_guitar = false;
-            play_bass = false;
-            play_tamb = false;
-            play_vocals = false;
-            play_drums = true;
+            sendControl( Control::SOLO_ONLY, 0 );
             break;
         case '2':
             // solo track 2
-            play_all = false;
-            play_bass = false;
-            play_tamb = false;
-            play_vocals = false;
-            play_drums = false;
-            play_guitar = true;
+            sendControl( Control::SOLO_ONLY, 1 );
             break;
         case '3':
             // solo track 3
-            play_all = false;
-            play_guitar = false;
-            play_bass = false;
-            play_tamb = false;
-            play_drums = false;
-            play_vocals = true;
+            sendControl( Control::SOLO_ONLY, 2 );
             break;
         case '4':
             // solo track 4
-            play_all = false;
-            play_guitar = false;
-            play_tamb = false;
-            play_vocals = false;
-            play_drums = false;
-            play_bass = true;
+            sendControl( Control::SOLO_ONLY, 3 );
             break;
         case '5':
             // solo track 5
-            play_all = false;
-            play_guitar = false;
-            play_bass = false;
-            play_vocals = false;
-            play_drums = false;
-            play_tamb = true;
+            sendControl( Control::SOLO_ONLY, 4 );
             break;
         case '0':
             // play and show all tracks
-            play_guitar = false;
-            play_bass = false;
-            play_tamb = false;
-            play_vocals = false;
-            play_drums = false;
-            play_all = true;
+            sendControl( Control::CLEAR_SOLO, 0 );
             break;
+        case '!':
+        case '@':
+        case '#':
+        case '$':
+        case '%':
+        {
+            // mute or unmute a track (shift and its number)
+            static const char mute_keys[] = "!@#$%";
+            int f = (int)( strchr( mute_keys, key ) - mute_keys );
+            g_muted[f] = !g_muted[f];
+            sendControl( Control::MUTE, f, g_muted[f] );
+            break;
+        }
         case 'j':
             // spin left
             g_inc += g_inc_val_mouse;
@@ -590,6 +965,53 @@ void keyboardFunc( unsigned char key, int x, int y )
             // increase gain of FFT
             if( g_fft_gain < 20.0f ) g_fft_gain += 1.0f;
             break;
+        case '[':
+            // loop from here... (the end is set with ']')
+            g_loop_in = g_setlist->getPosition();
+            break;
+        case ']':
+            // ...to here
+            g_loop_out = g_setlist->getPosition();
+            if( g_loop_out <= g_loop_in )
+                fprintf( stderr, "the loop has to end after it starts ('[' first) \n" );
+            else
+                sendControl( Control::LOOP, 0, g_loop_in, g_loop_out );
+            break;
+        case '\\':
+            // stop looping
+            g_loop_in = g_loop_out = 0.0;
+            sendControl( Control::LOOP, 0, 0.0, 0.0 );
+            break;
+        case 'r':
+        case 'R':
+            // back to the top
+            sendControl( Control::SEEK, 0, 0.0 );
+            break;
+        case '-':
+        case '_':
+            // practice slower...
+            if( g_speed > 0.51 ) g_speed -= 0.05;
+            sendControl( Control::SPEED, 0, g_speed );
+            fprintf( stderr, "speed %.0f%% \n", g_speed * 100.0 );
+            break;
+        case '=':
+        case '+':
+            // ...or faster
+            if( g_speed < 1.49 ) g_speed += 0.05;
+            sendControl( Control::SPEED, 0, g_speed );
+            fprintf( stderr, "speed %.0f%% \n", g_speed * 100.0 );
+            break;
+        case 'p':
+        case 'P':
+            // how the audio callback is keeping up
+            g_profiler.print();
+            break;
+        case '.':
+        case '>':
+            // on to the next song
+            if( g_setlist->getIndex() + 1 < g_setlist->getSongCount() )
+                sendControl( Control::SKIP, 0 );
+            break;
     }
     
     // mark for rendering
@@ -636,6 +1058,14 @@ void mouseFunc( int button, int state, int x, int y )
 //-----------------------------------------------------------------------------
 void idleFunc( )
 {
+    // say so when the setlist goes on to the next song
+    unsigned int index = g_setlist->getIndex();
+    if( index != g_shown_song )
+    {
+        g_shown_song = index;
+        fprintf( stderr, "song %u of %u: %s \n", index+1, g_setlist->getSongCount(), g_setlist->getName( index ) );
+    }
+
     // render the scene
     glutPostRedisplay( );
 }
@@ -649,6 +1079,12 @@ void idleFunc( )
 // Clear, Flush, and SwapBuffer are essential calls
 void displayFunc( ) 
 {
+	// take the newest buffer played, if there's been one since the last frame
+	double block_frame;
+	unsigned int block_frames;
+	MY_FLOAT * buffers[g_num_soundfiles];
+	for( int f = 0; f < g_num_soundfiles; f++ ) buffers[f] = g_soundfile_buffer[f];
+	g_blocks->read( &block_frame, &block_frames, buffers, g_avg_pow, g_silent );
 	
     glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
     glEnable( GL_TEXTURE_2D );
@@ -708,11 +1144,25 @@ void displayFunc( )
 	// essential for displaying wutrfall correctly
 	glDisable(GL_TEXTURE_2D);
 	
-	// plot the waterfalls
+	// plot the waterfalls: what's being heard now, analysed ahead of time,
+	// or else (until it has been) the last buffer played
+	double heard = g_lookahead->getHeardFrame();
     for( int f = 0; f < g_num_soundfiles; f++ )
 	{
+        // when soloed, don't show other tracks
+        float alpha = g_mixer->isHeard( f ) ? 1.0f : 0.2f;
         // yeeeuh chase em down
-        g_wf[f].drawWaterfall( g_soundfile_buffer[f], g_buffer_size, g_fft_size, 1, f, g_num_soundfiles, g_put_a_donk_on_it, alphas[f], g_fft_gain );
+        bool silent;
+        if( heard >= 0 && g_lookahead->getSpectrum( f, heard, g_spectrum, &silent ) )
+            g_wf[f].drawWaterfall( g_spectrum, g_buffer_size, g_fft_size, 1, f, g_num_soundfiles, g_put_a_donk_on_it, alpha, g_fft_gain, silent, true );
+        else
+        {
+            // the waterfall windows and transforms its buffer in place, so
+            // it gets a copy, padded out, to draw the same buffer next frame
+            memcpy( g_spectrum, g_soundfile_buffer[f], g_buffer_size * sizeof(float) );
+            memset( g_spectrum + g_buffer_size, 0, (g_fft_size - g_buffer_size) * sizeof(float) );
+            g_wf[f].drawWaterfall( g_spectrum, g_buffer_size, g_fft_size, 1, f, g_num_soundfiles, g_put_a_donk_on_it, alpha, g_fft_gain, g_silent[f] );
+        }
     }
 
     glPopMatrix();
@@ -781,20 +1231,6 @@ void initFiveImages( const char * filenames[] )
 }
 
 
-//-----------------------------------------------------------------------------
-// name: initAudioFiles
-//-----------------------------------------------------------------------------
-
-void initAudioFiles( const char * mus_file_names[] )
-{
-	for( int f = 0; f < g_num_soundfiles; f++ )
-	{
-		g_input_music[f] = new WvIn(mus_file_names[f], 0, 0);
-        g_input_music[f]->normalize(1);
-	}
-}
-
-
 //-----------------------------------------------------------------------------
 // name: drawTextureQuad(i) (from FourTextures.cpp / RgbImage.cpp by Samuel R. Buss)
 // desc: display the ith texture
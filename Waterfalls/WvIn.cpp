@@ -8,7 +8,11 @@
 
     WvIn loads the contents of an audio file for
     subsequent output.  Linear interpolation is
-    used for fractional "read rates".
+    used for fractional "read rates".  For better
+    quality, the vector and StkFrames tick methods
+    can instead use a windowed-sinc Resampler (see
+    setResample()), or the data can be converted to
+    the output rate once, with resampleData().
 
     WvIn supports multi-channel data in interleaved
     format.  It is important to distinguish the
@@ -17,18 +21,39 @@
     tickFrame() methods, which return pointers to
     multi-channel sample frames.  For single-channel
     data, these methods return equivalent values.
+    The vector and StkFrames versions compute a
+    whole block of frames per call.
 
     Small files are completely read into local memory
-    during instantiation.  Large files are read
-    incrementally from disk.  The file size threshold
+    during instantiation, keeping the samples at their
+    native width (16-bit data takes 2 bytes per
+    sample); the normalization gain is applied when
+    reading.  Large files are read incrementally from
+    disk.  The file size threshold
     and the increment size values are defined in
     WvIn.h.
 
-    WvIn currently supports WAV, AIFF, SND (AU),
-    MAT-file (Matlab), and STK RAW file formats.
-    Signed integer (8-, 16-, and 32-bit) and floating-
-    point (32- and 64-bit) data types are supported.
-    Uncompressed data types are not supported.  If
+    Uncompressed files in the host byte order can
+    instead be memory-mapped (see the \e doMap
+    argument).  Sample frames are then read directly
+    from the mapped data region and scaled by the
+    normalization gain in tickFrame(), so neither a
+    full copy nor a chunk buffer is needed.  Files
+    that require conversion (byte-swapped or 8-bit
+    data) are loaded as described above.  Data which
+    is already in memory, such as a stem of a mapped
+    StemBundle, can be read in place with attachData().
+
+    WvIn currently supports WAV (including
+    WAVE_FORMAT_EXTENSIBLE and RF64), AIFF, SND (AU),
+    FLAC, MAT-file (Matlab), and STK RAW file formats.
+    Signed integer (8-, 16-, packed 24-, and 32-bit)
+    and floating-point (32- and 64-bit) data types are
+    supported.  File offsets are 64-bit, so data over
+    4 GB streams through the chunked path.
+    FLAC data (up to 24 bits) is decoded by a
+    FlacDecoder, a block at a time as it is read.
+    Other compressed data types are not supported.  If
     using MAT-files, data should be saved in an array
     with each data channel filling a matrix row.
 
@@ -36,23 +61,52 @@
 */
 /***************************************************/
 
+// Large file support for multi-gigabyte sessions on 32-bit systems.
+#if !defined(_FILE_OFFSET_BITS)
+  #define _FILE_OFFSET_BITS 64
+#endif
+
 #include "WvIn.h"
+#include "SampleConvert.h"
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <math.h>
 #include <string.h>
 
+#if !defined(__OS_WINDOWS__)
+  #include <sys/mman.h>
+#endif
+
 #include <iostream>
 
+// File positions beyond 2 GB need 64-bit offsets even where long is 32 bits.
+static int seek64( FILE *file, long long offset, int whence )
+{
+#if defined(__OS_WINDOWS__)
+  return _fseeki64( file, offset, whence );
+#else
+  return fseeko( file, (off_t) offset, whence );
+#endif
+}
+
+static long long tell64( FILE *file )
+{
+#if defined(__OS_WINDOWS__)
+  return _ftelli64( file );
+#else
+  return (long long) ftello( file );
+#endif
+}
+
 WvIn :: WvIn()
 {
   init();
 }
 
-WvIn :: WvIn( const char *fileName, bool raw, bool doNormalize )
+WvIn :: WvIn( const char *fileName, bool raw, bool doNormalize, bool doMap )
 {
   init();
-  openFile( fileName, raw, doNormalize );
+  openFile( fileName, raw, doNormalize, doMap );
 }
 
 WvIn :: ~WvIn()
@@ -60,35 +114,162 @@ WvIn :: ~WvIn()
   if (fd)
     fclose(fd);
 
+  releaseData();
+
+  if (flac)
+    delete flac;
+
   if (data)
     delete [] data;
 
   if (lastOutput)
     delete [] lastOutput;
+
+  if (resampler)
+    delete resampler;
+
+  if (resampleBuffer)
+    delete [] resampleBuffer;
+
+  if (path)
+    delete [] path;
 }
 
 void WvIn :: init( void )
 {
+  path = 0;
+  rawFile = false;
   fd = 0;
+  flac = 0;
+  flacSource = 0;
   data = 0;
   lastOutput = 0;
+  mapBase = 0;
+  mapLength = 0;
+  nativeData = 0;
+  rawData = 0;
   chunking = false;
   finished = true;
   interpolate = false;
   bufferSize = 0;
   channels = 0;
+  gain = 1.0;
+  dataPeak = 0.0;
   time = 0.0;
+  resampling = false;
+  resampler = 0;
+  resampleBuffer = 0;
+  resampleFrame = 0;
+  resampleOrigin = 0;
+  resampleTime = -1.0;
+  resampleLoop = false;
+  looping = false;
+  loopStart = 0;
+  loopEnd = 0;
 }
 
 void WvIn :: closeFile( void )
 {
   if ( fd ) fclose( fd );
+  fd = 0;
+  if ( flac ) delete flac;
+  flac = 0;
+  releaseData();
+  looping = false;
   finished = true;
+  if ( path ) delete [] path;
+  path = 0;
 }
 
-void WvIn :: openFile( const char *fileName, bool raw, bool doNormalize )
+void WvIn :: openFile( const char *fileName, bool raw, bool doNormalize, bool doMap )
 {
+  unsigned long lastChannels = channels;
+  unsigned long samples, lastSamples = (data) ? (bufferSize+1)*channels : 0;
   closeFile();
+  readHeader( fileName, raw );
+  gain = 1.0;
+  dataPeak = 0.0;
+
+  if ( lastChannels < channels ) {
+    if ( lastOutput ) delete [] lastOutput;
+    lastOutput = (MY_FLOAT *) new MY_FLOAT[channels];
+  }
+
+  if ( fmod((double)rate, (double)1.0) != 0.0 ) interpolate = true;
+  chunkPointer = 0;
+  reset();
+  if ( resampling ) initResampler();
+
+  // Mapped data stays valid after the file is closed.  Other files
+  // that fit in memory are kept at their native sample width.
+  if ( (doMap && mapData()) || (!chunking && loadData()) ) {
+    if ( data ) delete [] data;
+    data = 0;
+    chunking = false;
+    bufferSize = fileSize;
+    fclose(fd);
+    fd = 0;
+    if ( doNormalize ) normalize();
+    finished = false;
+    return;
+  }
+
+  // Allocate new memory if necessary.
+  samples = (bufferSize+1)*channels;
+  if ( lastSamples < samples ) {
+    if ( data ) delete [] data;
+    data = (MY_FLOAT *) new MY_FLOAT[samples];
+  }
+
+  readData( 0 );  // Load file data.
+  if ( doNormalize ) normalize();
+  finished = false;
+}
+
+void WvIn :: openInfo( const char *fileName, bool raw )
+{
+  unsigned long lastChannels = channels;
+  closeFile();
+  readHeader( fileName, raw );
+  if ( lastChannels < channels ) {
+    if ( lastOutput ) delete [] lastOutput;
+    lastOutput = (MY_FLOAT *) new MY_FLOAT[channels];
+  }
+
+  // Nothing is read, so the chunk buffer of an earlier file can go.
+  if ( data ) delete [] data;
+  data = 0;
+  if ( fd ) fclose( fd );
+  fd = 0;
+  if ( flac ) delete flac;
+  flac = 0;
+  // getStats() and peekFrames() then open the file again, as when chunking.
+  chunking = true;
+}
+
+void WvIn :: openCursor( const WvIn &source )
+{
+  // attachData() doesn't take 8-bit data, which is kept unsigned, and
+  // other data isn't shared, so those files are opened again.
+  if ( source.rawData && source.dataType != STK_SINT8 )
+    attachData( source.rawData, source.fileSize, source.channels, source.dataType,
+                source.fileRate, source.dataPeak, FALSE );
+  else if ( source.path )
+    source.openReader( this );
+  else {
+    sprintf(msg, "WvIn: No data to open a cursor on.");
+    handleError(msg, StkError::FUNCTION_ARGUMENT);
+  }
+
+  gain = source.gain;
+  dataPeak = source.dataPeak;
+}
+
+void WvIn :: readHeader( const char *fileName, bool raw )
+{
+  path = new char[strlen(fileName) + 1];
+  strcpy( path, fileName );
+  rawFile = raw;
 
   // Try to open the file.
   fd = fopen(fileName, "rb");
@@ -97,15 +278,14 @@ void WvIn :: openFile( const char *fileName, bool raw, bool doNormalize )
     handleError(msg, StkError::FILE_NOT_FOUND);
   }
 
-  unsigned long lastChannels = channels;
-  unsigned long samples, lastSamples = (bufferSize+1)*channels;
   bool result = false;
+  chunking = false;
   if ( raw )
     result = getRawInfo( fileName );
   else {
     char header[12];
     if ( fread(&header, 4, 3, fd) != 3 ) goto error;
-    if ( !strncmp(header, "RIFF", 4) &&
+    if ( (!strncmp(header, "RIFF", 4) || !strncmp(header, "RF64", 4)) &&
          !strncmp(&header[8], "WAVE", 4) )
       result = getWavInfo( fileName );
     else if ( !strncmp(header, ".snd", 4) )
@@ -113,6 +293,15 @@ void WvIn :: openFile( const char *fileName, bool raw, bool doNormalize )
     else if ( !strncmp(header, "FORM", 4) &&
               (!strncmp(&header[8], "AIFF", 4) || !strncmp(&header[8], "AIFC", 4) ) )
       result = getAifInfo( fileName );
+    else if ( !strncmp(header, "fLaC", 4) )
+      result = getFlacInfo( fileName, 0 );
+    else if ( !strncmp(header, "ID3", 3) ) {
+      // FLAC file with an ID3v2 tag in front (the size is "syncsafe").
+      long size = ((header[6] & 0x7F) << 21) | ((header[7] & 0x7F) << 14) |
+        ((header[8] & 0x7F) << 7) | (header[9] & 0x7F);
+      if ( header[5] & 0x10 ) size += 10;  // footer
+      result = getFlacInfo( fileName, size + 10 );
+    }
     else {
       if ( fseek(fd, 126, SEEK_SET) == -1 ) goto error;
       if ( fread(&header, 2, 1, fd) != 1 ) goto error;
@@ -133,29 +322,54 @@ void WvIn :: openFile( const char *fileName, bool raw, bool doNormalize )
     sprintf(msg, "WvIn: File (%s) data size is zero!", fileName);
     handleError(msg, StkError::FILE_ERROR);
   }
+  return;
 
-  // Allocate new memory if necessary.
-  samples = (bufferSize+1)*channels;
-  if ( lastSamples < samples ) {
-    if ( data ) delete [] data;
-    data = (MY_FLOAT *) new MY_FLOAT[samples];
+ error:
+  sprintf(msg, "WvIn: Error reading file (%s).", fileName);
+  handleError(msg, StkError::FILE_ERROR);
+}
+
+void WvIn :: attachData( const void *samples, unsigned long frames, unsigned int nChannels,
+                         STK_FORMAT format, MY_FLOAT aFileRate, MY_FLOAT peak, bool doNormalize )
+{
+  if ( format != STK_SINT16 && format != STK_SINT24 && format != STK_SINT32 &&
+       format != MY_FLOAT32 && format != MY_FLOAT64 ) {
+    sprintf(msg, "WvIn: Unsupported data format for attached data.");
+    handleError(msg, StkError::FUNCTION_ARGUMENT);
   }
-  if ( lastChannels < channels ) {
+  if ( !samples || frames == 0 || nChannels == 0 ) {
+    sprintf(msg, "WvIn: Attached data size is zero!");
+    handleError(msg, StkError::FUNCTION_ARGUMENT);
+  }
+
+  closeFile();
+
+  if ( channels < nChannels ) {
     if ( lastOutput ) delete [] lastOutput;
-    lastOutput = (MY_FLOAT *) new MY_FLOAT[channels];
+    lastOutput = (MY_FLOAT *) new MY_FLOAT[nChannels];
   }
+  if ( data ) delete [] data;
+  data = 0;
 
-  if ( fmod((double)rate, (double)1.0) != 0.0 ) interpolate = true;
+  // Read in place, like a mapped file which we don't own.
+  rawData = samples;
+  dataType = format;
+  channels = nChannels;
+  fileSize = frames;
+  bufferSize = frames;
+  dataOffset = 0;
+  byteswap = false;
+  chunking = false;
   chunkPointer = 0;
+  gain = 1.0;
+  dataPeak = peak;
+  fileRate = aFileRate;
+  rate = (MY_FLOAT) ( fileRate / Stk::sampleRate() );
+  interpolate = ( fmod((double)rate, (double)1.0) != 0.0 );
+
   reset();
-  readData( 0 );  // Load file data.
+  if ( resampling ) initResampler();
   if ( doNormalize ) normalize();
-  finished = false;
-  return;
-
- error:
-  sprintf(msg, "WvIn: Error reading file (%s).", fileName);
-  handleError(msg, StkError::FILE_ERROR);
 }
 
 bool WvIn :: getRawInfo( const char *fileName )
@@ -194,28 +408,46 @@ bool WvIn :: getRawInfo( const char *fileName )
 
 bool WvIn :: getWavInfo( const char *fileName )
 {
-  // Find "format" chunk ... it must come before the "data" chunk.
+  // RF64 files (for data over 4 GB) have the same layout, but their
+  // sizes are 0xFFFFFFFF, with the real values in a "ds64" chunk.
+  UINT64 dataBytes = 0;
+  bool rf64 = false;
+  if ( fseek(fd, 0, SEEK_SET) == -1 ) goto error;
   char id[4];
-  SINT32 chunkSize;
+  if ( fread(&id, 4, 1, fd) != 1 ) goto error;
+  rf64 = !strncmp(id, "RF64", 4);
+  if ( fseek(fd, 12, SEEK_SET) == -1 ) goto error;
+
+  // Find "format" chunk ... it must come before the "data" chunk.
+  UINT32 chunkSize;
   if ( fread(&id, 4, 1, fd) != 1 ) goto error;
   while ( strncmp(id, "fmt ", 4) ) {
     if ( fread(&chunkSize, 4, 1, fd) != 1 ) goto error;
 #ifndef __LITTLE_ENDIAN__
     swap32((unsigned char *)&chunkSize);
 #endif
-    if ( fseek(fd, chunkSize, SEEK_CUR) == -1 ) goto error;
+    if ( rf64 && !strncmp(id, "ds64", 4) && chunkSize >= 16 ) {
+      // Skip the RIFF size to get the data size.
+      if ( fseek(fd, 8, SEEK_CUR) == -1 ) goto error;
+      if ( fread(&dataBytes, 8, 1, fd) != 1 ) goto error;
+#ifndef __LITTLE_ENDIAN__
+      swap64((unsigned char *)&dataBytes);
+#endif
+      chunkSize -= 16;
+    }
+    if ( seek64(fd, chunkSize + (chunkSize & 1), SEEK_CUR) == -1 ) goto error;
     if ( fread(&id, 4, 1, fd) != 1 ) goto error;
   }
 
   // Check that the data is not compressed.
-  SINT16 format_tag;
+  UINT16 format_tag;
   if ( fread(&chunkSize, 4, 1, fd) != 1 ) goto error; // Read fmt chunk size.
   if ( fread(&format_tag, 2, 1, fd) != 1 ) goto error;
 #ifndef __LITTLE_ENDIAN__
   swap16((unsigned char *)&format_tag);
   swap32((unsigned char *)&chunkSize);
 #endif
-  if (format_tag != 1 && format_tag != 3 ) { // PCM = 1, FLOAT = 3
+  if (format_tag != 1 && format_tag != 3 && format_tag != 0xFFFE ) { // PCM = 1, FLOAT = 3, EXTENSIBLE
     sprintf(msg, "WvIn: %s contains an unsupported data format type (%d).", fileName, format_tag);
     return false;
   }
@@ -246,11 +478,25 @@ bool WvIn :: getWavInfo( const char *fileName )
 #ifndef __LITTLE_ENDIAN__
   swap16((unsigned char *)&temp);
 #endif
+  if ( format_tag == 0xFFFE ) {
+    // WAVE_FORMAT_EXTENSIBLE: the real format tag is the first two
+    // bytes of the subformat GUID, after the extension size, valid
+    // bits and channel mask.
+    if ( chunkSize < 40 ) goto error;
+    if ( fseek(fd, 8, SEEK_CUR) == -1 ) goto error;
+    if ( fread(&format_tag, 2, 1, fd) != 1 ) goto error;
+#ifndef __LITTLE_ENDIAN__
+    swap16((unsigned char *)&format_tag);
+#endif
+    chunkSize -= 10;
+  }
   if ( format_tag == 1 ) {
     if (temp == 8)
       dataType = STK_SINT8;
     else if (temp == 16)
       dataType = STK_SINT16;
+    else if (temp == 24)
+      dataType = STK_SINT24;
     else if (temp == 32)
       dataType = STK_SINT32;
   }
@@ -266,7 +512,7 @@ bool WvIn :: getWavInfo( const char *fileName )
   }
 
   // Jump over any remaining part of the "fmt" chunk.
-  if ( fseek(fd, chunkSize-16, SEEK_CUR) == -1 ) goto error;
+  if ( seek64(fd, (long long) chunkSize - 16 + (chunkSize & 1), SEEK_CUR) == -1 ) goto error;
 
   // Find "data" chunk ... it must come after the "fmt" chunk.
   if ( fread(&id, 4, 1, fd) != 1 ) goto error;
@@ -276,24 +522,33 @@ bool WvIn :: getWavInfo( const char *fileName )
 #ifndef __LITTLE_ENDIAN__
     swap32((unsigned char *)&chunkSize);
 #endif
-    if ( fseek(fd, chunkSize, SEEK_CUR) == -1 ) goto error;
+    if ( seek64(fd, chunkSize + (chunkSize & 1), SEEK_CUR) == -1 ) goto error;
     if ( fread(&id, 4, 1, fd) != 1 ) goto error;
   }
 
   // Get length of data from the header.
-  SINT32 bytes;
+  UINT32 bytes;
   if ( fread(&bytes, 4, 1, fd) != 1 ) goto error;
 #ifndef __LITTLE_ENDIAN__
   swap32((unsigned char *)&bytes);
 #endif
-  fileSize = 8 * bytes / temp / channels;  // sample frames
+  if ( !rf64 || bytes != 0xFFFFFFFF ) dataBytes = bytes;
+
+  // Trust the file length over the header, which is often left
+  // unfinished by recorders that stopped unexpectedly.
+  dataOffset = tell64(fd);
+  struct stat filestat;
+  if ( fstat(fileno(fd), &filestat) == 0 && (UINT64) filestat.st_size >= dataOffset &&
+       dataBytes > (UINT64) filestat.st_size - dataOffset )
+    dataBytes = (UINT64) filestat.st_size - dataOffset;
+
+  fileSize = (unsigned long) (dataBytes / ((temp / 8) * channels));  // sample frames
   bufferSize = fileSize;
   if (fileSize > CHUNK_THRESHOLD) {
     chunking = true;
     bufferSize = CHUNK_SIZE;
   }
 
-  dataOffset = ftell(fd);
   byteswap = false;
 #ifndef __LITTLE_ENDIAN__
   byteswap = true;
@@ -345,10 +600,12 @@ bool WvIn :: getSndInfo( const char *fileName )
   channels = chans;
 
   if ( fseek(fd, 4, SEEK_SET) == -1 ) goto error;
-  if ( fread(&dataOffset, 4, 1, fd) != 1 ) goto error;
+  UINT32 offset;
+  if ( fread(&offset, 4, 1, fd) != 1 ) goto error;
 #ifdef __LITTLE_ENDIAN__
-  swap32((unsigned char *)&dataOffset);
+  swap32((unsigned char *)&offset);
 #endif
+  dataOffset = offset;
 
   // Get length of data from the header.
   if ( fread(&fileSize, 4, 1, fd) != 1 ) goto error;
@@ -453,6 +710,7 @@ bool WvIn :: getAifInfo( const char *fileName )
   if ( aifc == false ) {
     if ( temp == 8 ) dataType = STK_SINT8;
     else if ( temp == 16 ) dataType = STK_SINT16;
+    else if ( temp == 24 ) dataType = STK_SINT24;
     else if ( temp == 32 ) dataType = STK_SINT32;
   }
   else {
@@ -482,7 +740,7 @@ bool WvIn :: getAifInfo( const char *fileName )
   // Skip over chunk size, offset, and blocksize fields
   if ( fseek(fd, 12, SEEK_CUR) == -1 ) goto error;
 
-  dataOffset = ftell(fd);
+  dataOffset = tell64(fd);
   byteswap = false;
 #ifdef __LITTLE_ENDIAN__
   byteswap = true;
@@ -594,7 +852,7 @@ bool WvIn :: getMatInfo( const char *fileName )
   if (byteswap) swap32((unsigned char *)&headsize);
   headsize -= fileSize * 8 * channels;
   if ( fseek(fd, headsize, SEEK_CUR) == -1 ) goto error;
-  dataOffset = ftell(fd);
+  dataOffset = tell64(fd);
 
   // Assume MAT-files have 44100 Hz sample rate.
   fileRate = 44100.0;
@@ -609,86 +867,109 @@ bool WvIn :: getMatInfo( const char *fileName )
   return false;
 }
 
-void WvIn :: readData( unsigned long index )
+bool WvIn :: getFlacInfo( const char *fileName, long offset )
 {
-  while (index < (unsigned long)chunkPointer) {
-    // Negative rate.
-    chunkPointer -= CHUNK_SIZE;
-    bufferSize = CHUNK_SIZE;
-    if (chunkPointer < 0) {
-      bufferSize += chunkPointer;
-      chunkPointer = 0;
-    }
+  flac = new FlacDecoder();
+  if ( fseek(fd, offset, SEEK_SET) == -1 || !flac->open( fd ) ) {
+    sprintf(msg, "WvIn: %s (%s).", flac->getMessage(), fileName);
+    return false;
   }
-  while (index >= chunkPointer+bufferSize) {
-    // Positive rate.
-    chunkPointer += CHUNK_SIZE;
+
+  if ( flacSource ) flac->shareBlocks( *flacSource );
+  channels = flac->getChannels();
+  fileRate = (MY_FLOAT) flac->getSampleRate();
+  rate = (MY_FLOAT) ( fileRate / Stk::sampleRate() );
+  dataType = flac->getFormat();
+  fileSize = flac->getFrames();
+  bufferSize = fileSize;
+  if (fileSize > CHUNK_THRESHOLD) {
+    chunking = true;
     bufferSize = CHUNK_SIZE;
-    if ( (unsigned long)chunkPointer+CHUNK_SIZE >= fileSize) {
-      bufferSize = fileSize - chunkPointer;
-    }
   }
 
-  long i, length = bufferSize;
+  // The decoder returns samples in the host byte order.
+  dataOffset = 0;
+  byteswap = false;
+  return true;
+}
+
+bool WvIn :: mapData( void )
+{
+#if !defined(__OS_WINDOWS__)
+  // Only data that can be read without conversion is mapped.
+  // 8-bit data is stored unsigned.
+  unsigned long bytes = sampleBytes();
+  if ( flac || byteswap || dataType == STK_SINT8 ) return false;
+  // Packed 24-bit samples are read a byte at a time, so need no alignment.
+  if ( bytes != 3 && dataOffset % bytes ) return false;
+
+  // Make sure the file really contains the data the header claims,
+  // and that it fits in the address space.
+  struct stat filestat;
+  UINT64 length = dataOffset + (UINT64) fileSize * channels * bytes;
+  if ( (UINT64) (size_t) length != length ) return false;
+  if ( fstat(fileno(fd), &filestat) == -1 ) return false;
+  if ( (UINT64) filestat.st_size < length ) return false;
+
+  void *base = mmap(0, length, PROT_READ, MAP_SHARED, fileno(fd), 0);
+  if ( base == MAP_FAILED ) return false;
+#if defined(MADV_SEQUENTIAL)
+  madvise(base, length, MADV_SEQUENTIAL);
+#endif
+
+  mapBase = base;
+  mapLength = length;
+  rawData = (const char *) base + dataOffset;
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool WvIn :: loadData( void )
+{
+  size_t samples = (size_t) fileSize * channels;
+  char *buffer = new char[samples * sampleBytes()];
+  if ( !readSamples( fd, 0, samples, buffer ) ) {
+    delete [] buffer;
+    return false;
+  }
+
+  nativeData = buffer;
+  rawData = buffer;
+  return true;
+}
+
+void WvIn :: releaseData( void )
+{
+#if !defined(__OS_WINDOWS__)
+  if ( mapBase ) munmap(mapBase, mapLength);
+#endif
+  if ( nativeData ) delete [] nativeData;
+  nativeData = 0;
+  mapBase = 0;
+  mapLength = 0;
+  rawData = 0;
+}
+
+void WvIn :: readData( unsigned long index )
+{
+  // Chunks start at multiples of CHUNK_SIZE, so the one holding index
+  // is found directly, in either direction and however far away.
+  if (index >= fileSize) index = fileSize - 1;
+  chunkPointer = (index / CHUNK_SIZE) * CHUNK_SIZE;
+  bufferSize = CHUNK_SIZE;
+  if ( (unsigned long)chunkPointer+CHUNK_SIZE >= fileSize) {
+    bufferSize = fileSize - chunkPointer;
+  }
+
+  long length = bufferSize;
   bool endfile = (chunkPointer+bufferSize == fileSize);
   if ( !endfile ) length += 1;
 
-  // Read samples into data[].  Use MY_FLOAT data structure
-  // to store samples.
-  if ( dataType == STK_SINT16 ) {
-    SINT16 *buf = (SINT16 *)data;
-    if (fseek(fd, dataOffset+(long)(chunkPointer*channels*2), SEEK_SET) == -1) goto error;
-    if (fread(buf, length*channels, 2, fd) != 2 ) goto error;
-    if ( byteswap ) {
-      SINT16 *ptr = buf;
-      for (i=length*channels-1; i>=0; i--)
-        swap16((unsigned char *)(ptr++));
-    }
-    for (i=length*channels-1; i>=0; i--)
-      data[i] = buf[i];
-  }
-  else if ( dataType == STK_SINT32 ) {
-    SINT32 *buf = (SINT32 *)data;
-    if (fseek(fd, dataOffset+(long)(chunkPointer*channels*4), SEEK_SET) == -1) goto error;
-    if (fread(buf, length*channels, 4, fd) != 4 ) goto error;
-    if ( byteswap ) {
-      SINT32 *ptr = buf;
-      for (i=length*channels-1; i>=0; i--)
-        swap32((unsigned char *)(ptr++));
-    }
-    for (i=length*channels-1; i>=0; i--)
-      data[i] = buf[i];
-  }
-  else if ( dataType == MY_FLOAT32 ) {
-    FLOAT32 *buf = (FLOAT32 *)data;
-    if (fseek(fd, dataOffset+(long)(chunkPointer*channels*4), SEEK_SET) == -1) goto error;
-    if (fread(buf, length*channels, 4, fd) != 4 ) goto error;
-    if ( byteswap ) {
-      FLOAT32 *ptr = buf;
-      for (i=length*channels-1; i>=0; i--)
-        swap32((unsigned char *)(ptr++));
-    }
-    for (i=length*channels-1; i>=0; i--)
-      data[i] = buf[i];
-  }
-  else if ( dataType == MY_FLOAT64 ) {
-    FLOAT64 *buf = (FLOAT64 *)data;
-    if (fseek(fd, dataOffset+(long)(chunkPointer*channels*8), SEEK_SET) == -1) goto error;
-    if (fread(buf, length*channels, 8, fd) != 8 ) goto error;
-    if ( byteswap ) {
-      FLOAT64 *ptr = buf;
-      for (i=length*channels-1; i>=0; i--)
-        swap64((unsigned char *)(ptr++));
-    }
-    for (i=length*channels-1; i>=0; i--)
-      data[i] = buf[i];
-  }
-  else if ( dataType == STK_SINT8 ) {
-    unsigned char *buf = (unsigned char *)data;
-    if (fseek(fd, dataOffset+(long)(chunkPointer*channels), SEEK_SET) == -1) goto error;
-    if (fread(buf, length*channels, 1, fd) != 1 ) goto error;
-    for (i=length*channels-1; i>=0; i--)
-      data[i] = buf[i] - 128.0;  // 8-bit WAV data is unsigned!
+  if ( !readFrames( fd, chunkPointer, length, data ) ) {
+    sprintf(msg, "WvIn: Error reading file data.");
+    handleError(msg, StkError::FILE_ERROR);
   }
 
   // If at end of file, repeat last sample frame for interpolation.
@@ -701,17 +982,89 @@ void WvIn :: readData( unsigned long index )
     fclose(fd);
     fd = 0;
   }
+}
 
-  return;
+unsigned int WvIn :: sampleBytes( void ) const
+{
+  if ( dataType == STK_SINT8 ) return 1;
+  else if ( dataType == STK_SINT16 ) return 2;
+  else if ( dataType == STK_SINT24 ) return 3;
+  else if ( dataType == MY_FLOAT64 ) return 8;
+  return 4;
+}
 
- error:
-  sprintf(msg, "WvIn: Error reading file data.");
-  handleError(msg, StkError::FILE_ERROR);
+MY_FLOAT WvIn :: fullScale( void ) const
+{
+  if ( dataType == STK_SINT8 ) return 128.0;
+  else if ( dataType == STK_SINT16 ) return 32768.0;
+  else if ( dataType == STK_SINT24 ) return 8388608.0;
+  else if ( dataType == STK_SINT32 ) return 2147483648.0;
+  return 1.0;
+}
+
+bool WvIn :: readSamples( FILE *file, unsigned long first, unsigned long samples, void *buffer ) const
+{
+  unsigned long i, bytes = sampleBytes();
+
+  if ( flac )
+    return flac->read( file, first / channels, samples / channels, buffer );
+
+  if (seek64(file, dataOffset + (long long) first * bytes, SEEK_SET) == -1) return false;
+  if (fread(buffer, bytes, samples, file) != samples) return false;
+
+  if ( dataType == STK_SINT8 ) {
+    // 8-bit WAV data is unsigned!
+    unsigned char *ptr = (unsigned char *)buffer;
+    for (i=0; i<samples; i++)
+      ptr[i] ^= 0x80;
+  }
+  else if ( byteswap )
+    SampleConvert::swap( buffer, bytes, samples );
+
+  return true;
+}
+
+bool WvIn :: readFrames( FILE *file, unsigned long frame, unsigned long frames, MY_FLOAT *buffer ) const
+{
+  unsigned long i, j, bytes = sampleBytes();
+  unsigned long samples = frames*channels;
+
+  // Samples are read a block at a time into a staging area, then
+  // byte-swapped and converted from there in one pass.
+  FLOAT64 staging[2048];
+  unsigned long block = sizeof(staging) / bytes;
+
+  if ( flac ) {
+    // Whole sample frames are decoded into the staging area.
+    block = sizeof(staging) / bytes / channels;
+    for (j=0; j<frames; j+=block) {
+      unsigned long n = (frames-j < block) ? frames-j : block;
+      if ( !flac->read( file, frame+j, n, staging ) ) return false;
+      SampleConvert::convert( staging, dataType, false, 1.0, buffer+j*channels, n*channels );
+    }
+    return true;
+  }
+
+  if (seek64(file, dataOffset + (long long) frame * channels * bytes, SEEK_SET) == -1) return false;
+  for (j=0; j<samples; j+=block) {
+    unsigned long n = (samples-j < block) ? samples-j : block;
+    if (fread(staging, bytes, n, file) != n) return false;
+    if ( dataType == STK_SINT8 ) {
+      // 8-bit WAV data is unsigned!
+      unsigned char *ptr = (unsigned char *)staging;
+      for (i=0; i<n; i++)
+        ptr[i] ^= 0x80;
+    }
+    SampleConvert::convert( staging, dataType, byteswap, 1.0, buffer+j, n );
+  }
+
+  return true;
 }
 
 void WvIn :: reset(void)
 {
-  time = (MY_FLOAT) 0.0;
+  time = 0.0;
+  resampleTime = -1.0;
   for (unsigned int i=0; i<channels; i++)
     lastOutput[i] = (MY_FLOAT) 0.0;
   finished = false;
@@ -725,29 +1078,193 @@ void WvIn :: normalize(void)
 // Normalize all channels equally by the greatest magnitude in all of the data.
 void WvIn :: normalize(MY_FLOAT peak)
 {
-  if (chunking) {
-    if ( dataType == STK_SINT8 ) gain = peak / 128.0;
-    else if ( dataType == STK_SINT16 ) gain = peak / 32768.0;
-    else if ( dataType == STK_SINT32 ) gain = peak / 2147483648.0;
-    else if ( dataType == MY_FLOAT32 || dataType == MY_FLOAT64 ) gain = peak;
+  if (dataPeak <= 0.0) {
+    PeakStats stats;
+    if ( getStats( &stats ) ) dataPeak = stats.peak;
+  }
 
-    return;
+  if (dataPeak > 0.0) gain = peak / dataPeak;
+  else if (chunking) gain = peak / fullScale();
+}
+
+bool WvIn :: getStats( PeakStats *stats, bool doScan ) const
+{
+  if ( path && PeakCache::find( path, stats ) &&
+       stats->frames == fileSize && stats->channels == channels )
+    return true;
+  if ( !doScan || fileSize == 0 ) return false;
+
+  if ( chunking ) {
+    // Read the file through a second WvIn, so as not to disturb this one.
+    if ( !path ) return false;
+    try {
+      WvIn scanner;
+      openReader( &scanner );
+      if ( !scanner.scanData( stats ) ) return false;
+    }
+    catch ( StkError & ) {
+      return false;
+    }
   }
+  else if ( !scanData( stats ) ) return false;
 
-  unsigned long i;
-  MY_FLOAT max = (MY_FLOAT) 0.0;
+  if ( path ) PeakCache::store( path, *stats );
+  return true;
+}
+
+void WvIn :: openReader( WvIn *reader ) const
+{
+  reader->flacSource = flac;
+  try {
+    reader->openFile( path, rawFile, FALSE, FALSE );
+  }
+  catch ( StkError & ) {
+    reader->flacSource = 0;
+    throw;
+  }
+  reader->flacSource = 0;
+}
+
+bool WvIn :: scanData( PeakStats *stats ) const
+{
+  const unsigned long block = 4096;
+  unsigned long i, start;
+  unsigned int j;
+  MY_FLOAT *buffer = new MY_FLOAT[block * channels];
+  MY_FLOAT *peaks = new MY_FLOAT[channels];
+  double *squares = new double[channels];
+  for (j=0; j<channels; j++) {
+    peaks[j] = 0.0;
+    squares[j] = 0.0;
+  }
 
-  for (i=0; i<channels*bufferSize; i++) {
-    if (fabs(data[i]) > max)
-      max = (MY_FLOAT) fabs((double) data[i]);
+  // Levels of each index block: the peak of any channel, and the RMS of
+  // the channels' average, which is what the vector tick methods return.
+  stats->resize( (fileSize + PEAKCACHE_BLOCK - 1) / PEAKCACHE_BLOCK );
+  MY_FLOAT blockPeak = 0.0;
+  double blockSquares = 0.0;
+
+  bool ok = true;
+  for (start=0; start<fileSize && ok; start+=block) {
+    unsigned long n = ( fileSize - start < block ) ? fileSize - start : block;
+    const MY_FLOAT *frames = buffer;
+    if ( rawData )
+      SampleConvert::convert( (const char *) rawData + (size_t) start * channels * sampleBytes(),
+                              dataType, false, 1.0, buffer, n * channels );
+    else if ( chunking )
+      ok = readFrames( fd, start, n, buffer );
+    else
+      frames = data + start * channels;
+
+    for (i=0; i<n; i++, frames+=channels) {
+      double sum = 0.0;
+      for (j=0; j<channels; j++) {
+        MY_FLOAT sample = (MY_FLOAT) fabs( (double) frames[j] );
+        if ( sample > peaks[j] ) peaks[j] = sample;
+        if ( sample > blockPeak ) blockPeak = sample;
+        squares[j] += (double) frames[j] * frames[j];
+        sum += frames[j];
+      }
+      sum /= channels;
+      blockSquares += sum * sum;
+
+      unsigned long frame = start + i + 1;
+      if ( frame % PEAKCACHE_BLOCK == 0 || frame == fileSize ) {
+        unsigned long b = (frame - 1) / PEAKCACHE_BLOCK;
+        stats->blockPeak[b] = blockPeak;
+        stats->blockRms[b] = (MY_FLOAT) sqrt( blockSquares / (frame - b * PEAKCACHE_BLOCK) );
+        blockPeak = 0.0;
+        blockSquares = 0.0;
+      }
+    }
   }
 
-  if (max > 0.0) {
-    max = (MY_FLOAT) 1.0 / max;
-    max *= peak;
-    for (i=0;i<=channels*bufferSize;i++)
-	    data[i] *= max;
+  if ( ok ) {
+    double total = 0.0;
+    stats->frames = fileSize;
+    stats->channels = channels;
+    stats->peak = 0.0;
+    for (j=0; j<channels; j++) {
+      if ( peaks[j] > stats->peak ) stats->peak = peaks[j];
+      total += squares[j];
+      if ( j < PEAKCACHE_CHANNELS ) {
+        stats->channelPeak[j] = peaks[j];
+        stats->channelRms[j] = (MY_FLOAT) sqrt( squares[j] / fileSize );
+      }
+    }
+    stats->rms = (MY_FLOAT) sqrt( total / ((double) fileSize * channels) );
   }
+  else stats->resize( 0 );
+
+  delete [] buffer;
+  delete [] peaks;
+  delete [] squares;
+  return ok;
+}
+
+unsigned long WvIn :: peekFrames( unsigned long start, unsigned long frames, MY_FLOAT *buffer ) const
+{
+  WvIn reader;
+  return peekFrames( start, frames, buffer, &reader );
+}
+
+unsigned long WvIn :: peekFrames( unsigned long start, unsigned long frames, MY_FLOAT *buffer, WvIn *reader ) const
+{
+  if ( start >= fileSize ) return 0;
+  if ( frames > fileSize - start ) frames = fileSize - start;
+
+  if ( chunking ) {
+    // Read the file through a second WvIn, so as not to disturb this one.
+    if ( !path ) return 0;
+    try {
+      if ( !reader->path || strcmp( reader->path, path ) )
+        openReader( reader );
+      if ( !reader->chunking ) return reader->peekFrames( start, frames, buffer );
+      if ( !reader->readFrames( reader->fd, start, frames, buffer ) ) return 0;
+    }
+    catch ( StkError & ) {
+      // Don't leave a half opened file to be read next time.
+      reader->closeFile();
+      return 0;
+    }
+  }
+  else if ( rawData )
+    SampleConvert::convert( (const char *) rawData + (size_t) start * channels * sampleBytes(),
+                            dataType, false, 1.0, buffer, frames * channels );
+  else
+    memcpy( buffer, data + start * channels, (size_t) frames * channels * sizeof(MY_FLOAT) );
+
+  return frames;
+}
+
+MY_FLOAT WvIn :: getPeak( unsigned long start, unsigned long frames ) const
+{
+  if (chunking) return fullScale();
+
+  if ( start >= fileSize ) return 0.0;
+  if ( frames > fileSize - start ) frames = fileSize - start;
+
+  unsigned long i, end = (start+frames)*channels;
+  MY_FLOAT max = (MY_FLOAT) 0.0;
+  if (rawData) {
+    for (i=start*channels; i<end; i++) {
+      MY_FLOAT sample = (MY_FLOAT) fabs((double) rawSample(i));
+      if (sample > max) max = sample;
+    }
+  }
+  else {
+    for (i=start*channels; i<end; i++) {
+      if (fabs(data[i]) > max)
+        max = (MY_FLOAT) fabs((double) data[i]);
+    }
+  }
+
+  return max;
+}
+
+bool WvIn :: isMapped(void) const
+{
+  return rawData != 0 && nativeData == 0;
 }
 
 unsigned long WvIn :: getSize(void) const
@@ -760,6 +1277,11 @@ unsigned int WvIn :: getChannels(void) const
   return channels;
 }
 
+Stk::STK_FORMAT WvIn :: getDataType(void) const
+{
+  return dataType;
+}
+
 MY_FLOAT WvIn :: getFileRate(void) const
 {
   return fileRate;
@@ -780,6 +1302,11 @@ void WvIn :: setRate(MY_FLOAT aRate)
 
   if (fmod((double)rate, 1.0) != 0.0) interpolate = true;
   else interpolate = false;
+
+  if ( resampler && rate > 0.0 ) {
+    resampler->setRatio( rate );
+    resampleTime = -1.0;
+  }
 }
 
 void WvIn :: addTime(MY_FLOAT aTime)   
@@ -794,6 +1321,141 @@ void WvIn :: addTime(MY_FLOAT aTime)
   }
 }
 
+void WvIn :: seek( double frame )
+{
+  // The chunk holding the new time is found by readData() on the next tick.
+  time = frame;
+  finished = false;
+  if (time < 0.0) time = 0.0;
+  if (time >= fileSize) {
+    time = fileSize;
+    finished = true;
+  }
+}
+
+double WvIn :: getTime(void) const
+{
+  return time;
+}
+
+void WvIn :: setLoop( unsigned long start, unsigned long end )
+{
+  if ( start >= end || end > fileSize ) {
+    sprintf(msg, "WvIn: Loop region (%lu to %lu) is empty or beyond the data.", start, end);
+    handleError(msg, StkError::WARNING);
+    return;
+  }
+
+  looping = true;
+  loopStart = start;
+  loopEnd = end;
+  resampleTime = -1.0;
+}
+
+void WvIn :: clearLoop(void)
+{
+  looping = false;
+  resampleTime = -1.0;
+}
+
+bool WvIn :: isLooping(void) const
+{
+  return looping;
+}
+
+void WvIn :: wrapLoop( double before )
+{
+  if ( !looping ) return;
+  double length = (double) (loopEnd - loopStart);
+  if ( rate > 0.0 && before < loopEnd && time >= loopEnd )
+    time -= length * (floor((time - loopEnd) / length) + 1.0);
+  else if ( rate < 0.0 && before >= loopStart && time < loopStart )
+    time += length * (floor((loopStart - time) / length) + 1.0);
+}
+
+void WvIn :: setResample(bool doResample)
+{
+  resampling = doResample;
+  if ( resampling ) {
+    if ( channels > 0 ) initResampler();
+  }
+  else {
+    if ( resampler ) delete resampler;
+    if ( resampleBuffer ) delete [] resampleBuffer;
+    resampler = 0;
+    resampleBuffer = 0;
+  }
+}
+
+void WvIn :: initResampler( void )
+{
+  if ( resampler ) delete resampler;
+  if ( resampleBuffer ) delete [] resampleBuffer;
+
+  // Room for a block of input frames and a block of output frames.
+  resampler = new Resampler( channels, (rate > 0.0) ? rate : 1.0 );
+  resampleBuffer = new MY_FLOAT[2 * RESAMPLE_BLOCK * channels];
+  resampleTime = -1.0;
+}
+
+void WvIn :: resampleData(void)
+{
+  if ( chunking ) {
+    sprintf(msg, "WvIn: Incrementally loaded files cannot be resampled in memory.");
+    handleError(msg, StkError::WARNING);
+    return;
+  }
+  if ( rate <= 0.0 || rate == 1.0 || fileSize == 0 ) return;
+
+  // The data is converted to floating-point at +-1.0 full scale and
+  // the normalization gain is adjusted to match.
+  double ratio = rate;
+  unsigned long frames = (unsigned long) ceil( fileSize / ratio );
+  char *buffer = new char[(size_t) frames * channels * sizeof(MY_FLOAT)];
+  MY_FLOAT *out = (MY_FLOAT *) buffer;
+  MY_FLOAT *in = new MY_FLOAT[RESAMPLE_BLOCK * channels];
+  MY_FLOAT scale = fullScale();
+  MY_FLOAT oldGain = gain;
+  gain = (MY_FLOAT) 1.0 / scale;
+
+  Resampler converter( channels, ratio );
+  converter.reset( converter.getHistory() );
+  long frame = -(long) converter.getHistory();
+  unsigned long done = 0;
+  while ( done < frames ) {
+    unsigned long n = converter.read( out + done*channels, frames - done );
+    done += n;
+    if ( n == 0 ) {
+      unsigned long m = converter.getSpace();
+      if ( m > RESAMPLE_BLOCK ) m = RESAMPLE_BLOCK;
+      readBlock( frame, m, in );
+      frame += converter.write( in, m );
+    }
+  }
+  delete [] in;
+
+  if ( data ) delete [] data;
+  data = 0;
+  releaseData();
+  nativeData = buffer;
+  rawData = buffer;
+  dataType = (sizeof(MY_FLOAT) == 8) ? MY_FLOAT64 : MY_FLOAT32;
+  byteswap = false;
+  fileSize = frames;
+  bufferSize = frames;
+  fileRate = (MY_FLOAT) (fileRate / ratio);
+  // The data no longer matches the file's peak cache.
+  if ( path ) delete [] path;
+  path = 0;
+  gain = oldGain * scale;
+  dataPeak /= scale;
+  time = time / ratio;
+  rate = 1.0;
+  interpolate = false;
+  if ( resampler ) resampler->setRatio( 1.0 );
+  resampleTime = -1.0;
+}
+
 void WvIn :: setInterpolate(bool doInterpolate)
 {
   interpolate = doInterpolate;
@@ -824,15 +1486,25 @@ MY_FLOAT WvIn :: tick(void)
 
 MY_FLOAT *WvIn :: tick(MY_FLOAT *vector, unsigned int vectorSize)
 {
-  for ( unsigned int i=0; i<vectorSize; i++ )
-    vector[i] = tick();
+  return tickBlock( vector, vectorSize, true );
+}
 
-  return vector;
+StkFrames& WvIn :: tick(StkFrames& frames)
+{
+  if ( frames.channels() != 1 && frames.channels() != channels ) {
+    sprintf(msg, "WvIn: StkFrames argument is incompatible with file data.");
+    handleError(msg, StkError::FUNCTION_ARGUMENT);
+  }
+
+  if ( frames.frames() )
+    tickBlock( &frames[0], frames.frames(), frames.channels() != channels || channels == 1 );
+  return frames;
 }
 
 const MY_FLOAT *WvIn :: tickFrame(void)
 {
-  register MY_FLOAT tyme, alpha;
+  register double tyme;
+  register MY_FLOAT alpha;
   register unsigned long i, index;
 
   if (finished) return lastOutput;
@@ -849,9 +1521,22 @@ const MY_FLOAT *WvIn :: tickFrame(void)
   // Integer part of time address.
   index = (long) tyme;
 
-  if (interpolate) {
+  if (rawData) {
+    // Native data has no extra frame at the end for interpolation.
+    alpha = (MY_FLOAT) (tyme - index);
+    bool last = (index+1 >= fileSize);
+    index *= channels;
+    for (i=0; i<channels; i++) {
+      lastOutput[i] = rawSample(index);
+      if (interpolate && !last)
+        lastOutput[i] += (alpha * (rawSample(index+channels) - lastOutput[i]));
+      lastOutput[i] *= gain;
+      index++;
+    }
+  }
+  else if (interpolate) {
     // Linear interpolation ... fractional part of time address.
-    alpha = tyme - (MY_FLOAT) index;
+    alpha = (MY_FLOAT) (tyme - index);
     index *= channels;
     for (i=0; i<channels; i++) {
       lastOutput[i] = data[index];
@@ -865,13 +1550,15 @@ const MY_FLOAT *WvIn :: tickFrame(void)
       lastOutput[i] = data[index++];
   }
 
-  if (chunking) {
-    // Scale outputs by gain.
+  if (!rawData) {
+    // Scale outputs by gain (native data was scaled above).
     for (i=0; i<channels; i++)  lastOutput[i] *= gain;
   }
 
   // Increment time, which can be negative.
+  double before = time;
   time += rate;
+  wrapLoop( before );
   if ( time < 0.0 || time >= fileSize ) finished = true;
 
   return lastOutput;
@@ -879,12 +1566,288 @@ const MY_FLOAT *WvIn :: tickFrame(void)
 
 MY_FLOAT *WvIn :: tickFrame(MY_FLOAT *frameVector, unsigned int frames)
 {
+  return tickBlock( frameVector, frames, false );
+}
+
+// A packed 24-bit sample in host byte order, for tickSegment().
+struct Sint24 {
+  unsigned char b[3];
+  operator MY_FLOAT() const {
+#ifdef __LITTLE_ENDIAN__
+    return (MY_FLOAT) ((SINT32) (((UINT32) b[2] << 24) | ((UINT32) b[1] << 16) | ((UINT32) b[0] << 8)) >> 8);
+#else
+    return (MY_FLOAT) ((SINT32) (((UINT32) b[0] << 24) | ((UINT32) b[1] << 16) | ((UINT32) b[2] << 8)) >> 8);
+#endif
+  }
+};
+
+// Compute up to n frames (or channel averages) from src, which holds
+// samples of type format, starting at the local time address t,
+// without reading at or beyond frame limit.  Returns the number of
+// frames computed and advances t.  The time address of the last frame
+// is stored in *last.
+template <class T>
+static unsigned long tickSegment( const T *src, Stk::STK_FORMAT format, unsigned int channels, double &t, MY_FLOAT rate,
+                                  bool interpolate, MY_FLOAT gain, bool average,
+                                  MY_FLOAT *out, unsigned long n, unsigned long limit, double *last )
+{
+  unsigned long i;
   unsigned int j;
-  for ( unsigned int i=0; i<frames; i++ ) {
-    tickFrame();
-    for ( j=0; j<channels; j++ )
-      frameVector[i*channels+j] = lastOutput[j];
+
+  if ( !interpolate && rate == 1.0 ) {
+    // Contiguous frames ... straight conversion, or simple loops which
+    // the compiler can vectorize.
+    const T *in = src + ((unsigned long) t) * channels;
+    *last = t + (double) (n-1);
+    if ( !average || channels == 1 ) {
+      unsigned long samples = average ? n : n*channels;
+      SampleConvert::convert( in, format, false, gain, out, samples );
+    }
+    else if ( channels == 2 ) {
+      MY_FLOAT scale = gain * (MY_FLOAT) 0.5;
+      for (i=0; i<n; i++)
+        out[i] = scale * ((MY_FLOAT) in[2*i] + (MY_FLOAT) in[2*i+1]);
+    }
+    else {
+      MY_FLOAT scale = gain / channels;
+      for (i=0; i<n; i++) {
+        MY_FLOAT sum = 0.0;
+        for (j=0; j<channels; j++)
+          sum += (MY_FLOAT) in[i*channels+j];
+        out[i] = scale * sum;
+      }
+    }
+    t += (double) n;
+    return n;
   }
 
-  return frameVector;
+  // The time address is rounded as it grows, so check every frame.
+  for (i=0; i<n; i++) {
+    if ( t < 0.0 || t >= limit ) break;
+    unsigned long index = (unsigned long) t;
+    MY_FLOAT alpha = (MY_FLOAT) (t - index);
+    const T *frame = src + index*channels;
+    MY_FLOAT sum = 0.0;
+    for (j=0; j<channels; j++) {
+      MY_FLOAT sample = (MY_FLOAT) frame[j];
+      if ( interpolate ) sample += alpha * ((MY_FLOAT) frame[j+channels] - sample);
+      if ( average ) sum += sample;
+      else out[i*channels+j] = gain * sample;
+    }
+    if ( average ) out[i] = gain * sum / channels;
+    *last = t;
+    t += rate;
+  }
+  return i;
+}
+
+MY_FLOAT *WvIn :: tickBlock( MY_FLOAT *out, unsigned int frames, bool average )
+{
+  if ( resampler && interpolate && rate > 0.0 )
+    return resampleBlock( out, frames, average );
+
+  unsigned int i = 0, j;
+  unsigned int width = average ? 1 : channels;
+
+  while ( i < frames ) {
+    if ( finished ) {
+      // Hold the last output, as tickFrame() does.
+      for ( ; i<frames; i++ ) {
+        if ( average ) out[i] = lastOut();
+        else for (j=0; j<channels; j++) out[i*channels+j] = lastOutput[j];
+      }
+      break;
+    }
+
+    double tyme = time;
+    if (chunking) {
+      // Check the time address vs. our current buffer limits.
+      if ( (tyme < chunkPointer) || (tyme >= chunkPointer+bufferSize) )
+        this->readData((long) tyme);
+      // Adjust index for the current buffer.
+      tyme -= chunkPointer;
+    }
+
+    // Number of frames which can be computed from the current buffer.
+    // Native data has no extra frame at the end for interpolation.
+    unsigned long n, limit = bufferSize;
+    if ( rawData && interpolate ) limit--;
+    if ( tyme >= limit ) n = 0;
+    else if ( rate > 0.0 ) n = (unsigned long) ((limit - tyme) / rate);
+    else if ( rate < 0.0 ) n = (unsigned long) (tyme / -rate) + 1;
+    else n = frames - i;
+    if ( n > frames - i ) n = frames - i;
+
+    // Stop at the loop boundary, so that the time can be wrapped.
+    if ( looping && n > 0 ) {
+      double position = tyme + ( chunking ? chunkPointer : 0 );
+      double left = -1.0;
+      if ( rate > 0.0 && position < loopEnd ) left = ceil( (loopEnd - position) / rate );
+      else if ( rate < 0.0 && position >= loopStart ) left = floor( (position - loopStart) / -rate ) + 1.0;
+      if ( left >= 1.0 && left < n ) n = (unsigned long) left;
+    }
+
+    double last = tyme;
+    MY_FLOAT *block = out + i*width;
+    if ( n > 0 ) {
+      if ( !rawData )
+        n = tickSegment( data, (sizeof(MY_FLOAT) == 8) ? MY_FLOAT64 : MY_FLOAT32, channels, tyme, rate, interpolate, gain, average, block, n, limit, &last );
+      else if ( dataType == STK_SINT16 )
+        n = tickSegment( (const SINT16 *) rawData, STK_SINT16, channels, tyme, rate, interpolate, gain, average, block, n, limit, &last );
+      else if ( dataType == MY_FLOAT32 )
+        n = tickSegment( (const FLOAT32 *) rawData, MY_FLOAT32, channels, tyme, rate, interpolate, gain, average, block, n, limit, &last );
+      else if ( dataType == STK_SINT32 )
+        n = tickSegment( (const SINT32 *) rawData, STK_SINT32, channels, tyme, rate, interpolate, gain, average, block, n, limit, &last );
+      else if ( dataType == STK_SINT24 )
+        n = tickSegment( (const Sint24 *) rawData, STK_SINT24, channels, tyme, rate, interpolate, gain, average, block, n, limit, &last );
+      else if ( dataType == STK_SINT8 )
+        n = tickSegment( (const signed char *) rawData, STK_SINT8, channels, tyme, rate, interpolate, gain, average, block, n, limit, &last );
+      else
+        n = tickSegment( (const FLOAT64 *) rawData, MY_FLOAT64, channels, tyme, rate, interpolate, gain, average, block, n, limit, &last );
+    }
+
+    if ( n == 0 ) {
+      // Let tickFrame() handle the frame at the buffer boundary.
+      tickFrame();
+      if ( average ) out[i] = lastOut();
+      else for (j=0; j<channels; j++) out[i*channels+j] = lastOutput[j];
+      i++;
+      continue;
+    }
+    i += n;
+
+    // Keep lastOutput current for lastFrame() and lastOut().
+    unsigned long index = (unsigned long) last;
+    MY_FLOAT alpha = (MY_FLOAT) (last - index);
+    index *= channels;
+    for (j=0; j<channels; j++, index++) {
+      lastOutput[j] = (rawData) ? rawSample(index) : data[index];
+      if ( interpolate )
+        lastOutput[j] += alpha * (((rawData) ? rawSample(index+channels) : data[index+channels]) - lastOutput[j]);
+      lastOutput[j] *= gain;
+    }
+
+    double before = time;
+    time = tyme;
+    if (chunking) time += chunkPointer;
+    wrapLoop( before );
+    if ( time < 0.0 || time >= fileSize ) finished = true;
+  }
+
+  return out;
+}
+
+MY_FLOAT *WvIn :: resampleBlock( MY_FLOAT *out, unsigned int frames, bool average )
+{
+  unsigned int i = 0, j;
+  unsigned long k;
+  MY_FLOAT *input = resampleBuffer;
+  MY_FLOAT *output = resampleBuffer + RESAMPLE_BLOCK*channels;
+
+  // Start the filter over if the time was changed since the last
+  // block.  The frames before the time are read again so that the
+  // filter has its full history.
+  if ( time != resampleTime ) {
+    double tyme = time;
+    long frame = (long) floor( tyme );
+    resampler->reset( resampler->getHistory() + (tyme - frame) );
+    resampleOrigin = frame - (long) resampler->getHistory();
+    resampleFrame = resampleOrigin;
+    resampleLoop = looping && tyme < loopEnd;
+  }
+
+  // With a loop, the resampler is fed a continuous stream, which goes
+  // on from the loop start when it reaches the loop end.  Its frame
+  // numbers past the loop end are mapped back into the loop.
+  long length = (long) (loopEnd - loopStart);
+
+  while ( i < frames ) {
+    if ( finished ) {
+      // Hold the last output, as tickFrame() does.
+      for ( ; i<frames; i++ ) {
+        if ( average ) out[i] = lastOut();
+        else for (j=0; j<channels; j++) out[i*channels+j] = lastOutput[j];
+      }
+      break;
+    }
+
+    // Averaged frames are computed in the output half of the buffer first.
+    unsigned long n = frames - i;
+    if ( average && n > RESAMPLE_BLOCK ) n = RESAMPLE_BLOCK;
+    MY_FLOAT *block = average ? output : out + i*channels;
+    n = resampler->read( block, n );
+    if ( n == 0 ) {
+      unsigned long m = resampler->getSpace();
+      if ( m > RESAMPLE_BLOCK ) m = RESAMPLE_BLOCK;
+      for (k=0; k<m; ) {
+        long frame = resampleFrame + (long) k;
+        unsigned long count = m - k;
+        if ( resampleLoop ) {
+          if ( frame >= (long) loopEnd ) frame = loopStart + (frame - (long) loopEnd) % length;
+          if ( frame < (long) loopEnd && frame + (long) count > (long) loopEnd ) count = loopEnd - frame;
+        }
+        readBlock( frame, count, input + k*channels );
+        k += count;
+      }
+      resampleFrame += resampler->write( input, m );
+      continue;
+    }
+
+    if ( average ) {
+      for (k=0; k<n; k++) {
+        MY_FLOAT sum = 0.0;
+        for (j=0; j<channels; j++)
+          sum += block[k*channels+j];
+        out[i+k] = sum / channels;
+      }
+    }
+    for (j=0; j<channels; j++)
+      lastOutput[j] = block[(n-1)*channels+j];
+    i += n;
+
+    double position = resampleOrigin + resampler->getPosition();
+    if ( resampleLoop && position >= loopEnd + length ) {
+      // Keep the stream frame numbers from growing without bound.
+      resampleOrigin -= length;
+      resampleFrame -= length;
+      position -= length;
+    }
+    if ( resampleLoop && position >= loopEnd )
+      position = loopStart + fmod( position - loopEnd, (double) length );
+    time = position;
+    if ( position >= fileSize ) finished = true;
+  }
+
+  resampleTime = time;
+  return out;
+}
+
+void WvIn :: readBlock( long frame, unsigned long frames, MY_FLOAT *buffer )
+{
+  unsigned long i = 0;
+  while ( i < frames ) {
+    long index = frame + (long) i;
+    unsigned long n = frames - i;
+    MY_FLOAT *block = buffer + i*channels;
+
+    if ( index < 0 || index >= (long) fileSize ) {
+      // Silence before and after the data.
+      if ( index < 0 && n > (unsigned long) -index ) n = (unsigned long) -index;
+      memset( block, 0, n * channels * sizeof(MY_FLOAT) );
+    }
+    else if ( rawData ) {
+      if ( n > fileSize - index ) n = fileSize - index;
+      const char *src = (const char *) rawData + (size_t) index * channels * sampleBytes();
+      SampleConvert::convert( src, dataType, false, gain, block, n * channels );
+    }
+    else {
+      if ( chunking && ( index < chunkPointer || index >= chunkPointer + (long) bufferSize ) )
+        this->readData( index );
+      long offset = (chunking) ? index - chunkPointer : index;
+      if ( n > bufferSize - offset ) n = bufferSize - offset;
+      SampleConvert::convert( data + offset*channels, (sizeof(MY_FLOAT) == 8) ? MY_FLOAT64 : MY_FLOAT32,
+                              false, gain, block, n * channels );
+    }
+    i += n;
+  }
 }
@@ -8,7 +8,11 @@
 
     WvIn loads the contents of an audio file for
     subsequent output.  Linear interpolation is
-    used for fractional "read rates".
+    used for fractional "read rates".  For better
+    quality, the vector and StkFrames tick methods
+    can instead use a windowed-sinc Resampler (see
+    setResample()), or the data can be converted to
+    the output rate once, with resampleData().
 
     WvIn supports multi-channel data in interleaved
     format.  It is important to distinguish the
@@ -17,18 +21,39 @@
     tickFrame() methods, which return pointers to
     multi-channel sample frames.  For single-channel
     data, these methods return equivalent values.
+    The vector and StkFrames versions compute a
+    whole block of frames per call.
 
     Small files are completely read into local memory
-    during instantiation.  Large files are read
-    incrementally from disk.  The file size threshold
+    during instantiation, keeping the samples at their
+    native width (16-bit data takes 2 bytes per
+    sample); the normalization gain is applied when
+    reading.  Large files are read incrementally from
+    disk.  The file size threshold
     and the increment size values are defined in
     WvIn.h.
 
-    WvIn currently supports WAV, AIFF, SND (AU),
-    MAT-file (Matlab), and STK RAW file formats.
-    Signed integer (8-, 16-, and 32-bit) and floating-
-    point (32- and 64-bit) data types are supported.
-    Uncompressed data types are not supported.  If
+    Uncompressed files in the host byte order can
+    instead be memory-mapped (see the \e doMap
+    argument).  Sample frames are then read directly
+    from the mapped data region and scaled by the
+    normalization gain in tickFrame(), so neither a
+    full copy nor a chunk buffer is needed.  Files
+    that require conversion (byte-swapped or 8-bit
+    data) are loaded as described above.  Data which
+    is already in memory, such as a stem of a mapped
+    StemBundle, can be read in place with attachData().
+
+    WvIn currently supports WAV (including
+    WAVE_FORMAT_EXTENSIBLE and RF64), AIFF, SND (AU),
+    FLAC, MAT-file (Matlab), and STK RAW file formats.
+    Signed integer (8-, 16-, packed 24-, and 32-bit)
+    and floating-point (32- and 64-bit) data types are
+    supported.  File offsets are 64-bit, so data over
+    4 GB streams through the chunked path.
+    FLAC data (up to 24 bits) is decoded by a
+    FlacDecoder, a block at a time as it is read.
+    Other compressed data types are not supported.  If
     using MAT-files, data should be saved in an array
     with each data channel filling a matrix row.
 
@@ -47,6 +72,9 @@
 #define CHUNK_SIZE 1024          // sample frames
 
 #include "Stk.h"
+#include "Resampler.h"
+#include "FlacDecoder.h"
+#include "PeakCache.h"
 #include <stdio.h>
 
 class WvIn : public Stk
@@ -60,7 +88,7 @@ public:
     An StkError will be thrown if the file is not found, its format is
     unknown, or a read error occurs.
   */
-  WvIn( const char *fileName, bool raw = FALSE, bool doNormalize = TRUE );
+  WvIn( const char *fileName, bool raw = FALSE, bool doNormalize = TRUE, bool doMap = FALSE );
 
   //! Class destructor.
   virtual ~WvIn();
@@ -68,9 +96,50 @@ public:
   //! Open the specified file and load its data.
   /*!
     An StkError will be thrown if the file is not found, its format is
-    unknown, or a read error occurs.
+    unknown, or a read error occurs.  If \e doMap is TRUE and the
+    file data can be used without conversion, the data region is
+    memory-mapped rather than read into memory.
+  */
+  void openFile( const char *fileName, bool raw = FALSE, bool doNormalize = TRUE, bool doMap = FALSE );
+
+  //! Read only the header of the specified file, without loading any data.
+  /*!
+    getSize(), getChannels(), getDataType() and getFileRate() then
+    describe the file, which is closed again.  getStats() and
+    peekFrames() open it again to read it, but the object can't be
+    ticked until a file is opened with openFile().  This is much quicker
+    than openFile() for collecting the formats of many files (see
+    LibraryScanner).  An StkError will be thrown as for openFile().
+  */
+  void openInfo( const char *fileName, bool raw = FALSE );
+
+  //! Read sample frames directly from memory owned by the caller.
+  /*!
+    \e samples holds \e frames interleaved sample frames of
+    \e nChannels channels in the host byte order, of type STK_SINT16,
+    STK_SINT24, STK_SINT32, MY_FLOAT32 or MY_FLOAT64.  The memory is not
+    copied and must remain valid while this object reads from it.
+    \e peak is the maximum sample magnitude in the data, or zero if
+    unknown, in which case normalize() scans the data.  An StkError
+    will be thrown if the format is not supported.
+  */
+  virtual void attachData( const void *samples, unsigned long frames, unsigned int nChannels,
+                           STK_FORMAT format, MY_FLOAT aFileRate, MY_FLOAT peak = 0.0,
+                           bool doNormalize = TRUE );
+
+  //! Read the same data as \e source, through a read pointer of this object's own.
+  /*!
+    Data which \e source holds in memory (mapped, attached or loaded)
+    is attached rather than copied, so \e source must stay open while
+    this object reads from it.  Otherwise its file is opened again,
+    a FLAC file without scanning it for its blocks again.
+    The data is scaled by the same normalization gain as in \e source.
+    This object can then be moved about and ticked, such as to look at
+    data ahead of where \e source is being played, while \e source is
+    ticked by another thread.  An StkError will be thrown if \e source
+    has nothing open or its file can't be opened.
   */
-  void openFile( const char *fileName, bool raw = FALSE, bool doNormalize = TRUE );
+  void openCursor( const WvIn &source );
 
   //! If a file is open, close it.
   void closeFile(void);
@@ -80,28 +149,73 @@ public:
 
   //! Normalize data to a maximum of +-1.0.
   /*!
-    For large, incrementally loaded files with integer data types,
-    normalization is computed relative to the data type maximum.
-    No normalization is performed for incrementally loaded files
-    with floating-point data types.
+    See normalize(MY_FLOAT).
   */
   void normalize(void);
 
   //! Normalize data to a maximum of \e +-peak.
   /*!
-    For large, incrementally loaded files with integer data types,
-    normalization is computed relative to the data type maximum 
-    (\e peak/maximum).  For incrementally loaded files with floating-
-    point data types, direct scaling by \e peak is performed.
+    The data maximum is found once, with getStats(), and applied as
+    a gain when reading; the data itself is never rescaled.  Files
+    which have been opened before take their maximum from the peak
+    cache rather than a scan.  If the data cannot be read through,
+    normalization is relative to the data type maximum.
   */
   void normalize(MY_FLOAT peak);
 
+  //! Find the peak and RMS levels of the whole file, overall, per channel and per block.
+  /*!
+    The levels are in the units of the data as stored.  They are
+    taken from the file's PeakCache if it is current.  Otherwise,
+    unless \e doScan is FALSE, the data is scanned, incrementally loaded
+    files through a second file handle so that this object can be
+    ticked meanwhile, and the levels are stored in the cache.  Returns
+    FALSE if \e doScan is FALSE and the cache has no levels, or if the
+    data could not be read.
+  */
+  bool getStats( PeakStats *stats, bool doScan = TRUE ) const;
+
+  //! Copy \e frames sample frames from frame \e start into \e buffer, without moving the read pointer.
+  /*!
+    The frames are interleaved and in the units of the data as
+    stored, as for getStats().  Incrementally loaded files are read
+    through a second file handle, so that this object can be ticked
+    meanwhile.  Returns the number of frames copied, which is fewer
+    than asked for at the end of the data, or zero if they could not
+    be read.
+  */
+  unsigned long peekFrames( unsigned long start, unsigned long frames, MY_FLOAT *buffer ) const;
+
+  //! Copy frames as peekFrames() does, through \e reader.
+  /*!
+    An incrementally loaded file is opened again in \e reader the
+    first time, and read through it until \e reader is closed or
+    the file changes, rather than opened for every call.  \e reader
+    mustn't be used otherwise meanwhile.
+  */
+  unsigned long peekFrames( unsigned long start, unsigned long frames, MY_FLOAT *buffer, WvIn *reader ) const;
+
+  //! Return the maximum sample magnitude in \e frames sample frames from \e start.
+  /*!
+    The magnitude is given in the units of the data as stored, as it
+    is read without normalization.  Reading the frames also brings
+    mapped data into memory.  For incrementally loaded files the data
+    is not read and the data type maximum is returned.
+  */
+  MY_FLOAT getPeak( unsigned long start, unsigned long frames ) const;
+
+  //! Query whether the file data is memory-mapped or attached.
+  bool isMapped(void) const;
+
   //! Return the file size in sample frames.
   unsigned long getSize(void) const;
 
   //! Return the number of audio channels in the file.
   unsigned int getChannels(void) const;
 
+  //! Return the data format of the file (one of the Stk::STK_FORMAT values).
+  STK_FORMAT getDataType(void) const;
+
   //! Return the input file sample rate in Hz (not the data read rate).
   /*!
     WAV, SND, and AIF formatted files specify a sample rate in
@@ -122,6 +236,55 @@ public:
   //! Increment the read pointer by \e aTime samples.
   virtual void addTime(MY_FLOAT aTime);
 
+  //! Move the read pointer to sample frame \e frame (with fraction).
+  /*!
+    The position is clamped to the file.  For incrementally loaded
+    files, the chunk holding the new position is read on the next
+    tick, without stepping through the chunks in between.
+  */
+  virtual void seek( double frame );
+
+  //! Return the read pointer position in sample frames.
+  double getTime(void) const;
+
+  //! Loop reading between sample frames \e start and \e end.
+  /*!
+    When reading forward reaches \e end, it continues from \e start
+    with the same fractional position, so the loop is seamless at any
+    rate.  Reading in reverse wraps from \e start back to \e end.  The
+    loop only applies while the read pointer is before \e end (after
+    \e start in reverse), so after a seek past the loop, reading plays
+    on.  A warning is given and nothing is changed if the region is
+    empty or extends beyond the file.
+  */
+  virtual void setLoop( unsigned long start, unsigned long end );
+
+  //! Stop looping.
+  virtual void clearLoop(void);
+
+  //! Query whether a loop is set.
+  bool isLooping(void) const;
+
+  //! Turn windowed-sinc resampling in the vector and StkFrames tick methods on/off.
+  /*!
+    When on, these methods use a Resampler rather than linear
+    interpolation while interpolation is on (as it is for fractional
+    rates) and the read rate is positive.  The single-frame tick methods still
+    interpolate linearly; after a call to one of them, to reset() or
+    to addTime(), the filter is started over at the new time.
+  */
+  void setResample(bool doResample);
+
+  //! Convert the data to the current read rate once, with a windowed-sinc Resampler.
+  /*!
+    The converted data is kept in memory as floating-point sample
+    frames, in place of the file data, and the read rate becomes 1.0.
+    Memory-mapped and attached data is released.  Nothing is done for
+    incrementally loaded files or a negative read rate; a warning is
+    given for the former.
+  */
+  void resampleData(void);
+
   //! Turn linear interpolation on/off.
   /*!
     Interpolation is automatically off when the read rate is
@@ -161,6 +324,16 @@ public:
   */
   virtual MY_FLOAT *tickFrame(MY_FLOAT *frameVector, unsigned int frames);
 
+  //! Fill the StkFrames argument with computed frames and return the same reference.
+  /*!
+    If \e frames has one channel, it is filled with averaged sample
+    frames, as with tick().  Otherwise its number of channels must
+    equal the number of channels in the file data, or an StkError is
+    thrown.  An StkError will also be thrown if a file is read
+    incrementally and a read error occurs.
+  */
+  virtual StkFrames& tick(StkFrames& frames);
+
 protected:
 
   // Initialize class variables.
@@ -169,6 +342,30 @@ protected:
   // Read file data.
   virtual void readData(unsigned long index);
 
+  // Compute \e frames sample frames (or their averages) into \e out.
+  MY_FLOAT *tickBlock( MY_FLOAT *out, unsigned int frames, bool average );
+
+  // Compute \e frames sample frames (or their averages) into \e out with the resampler.
+  MY_FLOAT *resampleBlock( MY_FLOAT *out, unsigned int frames, bool average );
+
+  // Create the resampler for the current data and rate.
+  void initResampler( void );
+
+  // Copy \e frames scaled sample frames from \e frame on to \e buffer, with zeros outside the data.
+  void readBlock( long frame, unsigned long frames, MY_FLOAT *buffer );
+
+  // Wrap the time around the loop if the step from time \e before crossed its boundary.
+  void wrapLoop( double before );
+
+  // Read \e samples samples, starting at sample \e first, from \e file into \e buffer at their native width.
+  bool readSamples( FILE *file, unsigned long first, unsigned long samples, void *buffer ) const;
+
+  // Read and convert \e frames sample frames, starting at \e frame, from \e file into \e buffer.
+  bool readFrames( FILE *file, unsigned long frame, unsigned long frames, MY_FLOAT *buffer ) const;
+
+  // Open the file and read its header, leaving the file open.
+  void readHeader( const char *fileName, bool raw );
+
   // Get STK RAW file information.
   bool getRawInfo( const char *fileName );
 
@@ -184,24 +381,87 @@ protected:
   // Get MAT-file header information.
   bool getMatInfo( const char *fileName );
 
+  // Get FLAC stream information, starting at file offset \e offset.
+  bool getFlacInfo( const char *fileName, long offset );
+
+  // Map the file data region into memory, if possible.
+  bool mapData( void );
+
+  // Read all of the file data into memory at its native width, if possible.
+  bool loadData( void );
+
+  // Release the file mapping or native data.
+  void releaseData( void );
+
+  // Return the size of one sample of the file data in bytes.
+  unsigned int sampleBytes( void ) const;
+
+  // Return the full scale magnitude of the file data type.
+  MY_FLOAT fullScale( void ) const;
+
+  // Return sample \e i of the mapped, attached or native data (unscaled).
+  MY_FLOAT rawSample( unsigned long i ) const;
+
+  // Scan all of the data for its levels.
+  bool scanData( PeakStats *stats ) const;
+
+  // Open this object's file again in \e reader, unnormalized, sharing its FLAC block table.
+  void openReader( WvIn *reader ) const;
+
   char msg[256];
+  char *path;             // the file name, if the data is as in the file
+  bool rawFile;
   FILE *fd;
+  FlacDecoder *flac;
+  const FlacDecoder *flacSource;  // whose block table the next FLAC file opened takes
   MY_FLOAT *data;
   MY_FLOAT *lastOutput;
+  void *mapBase;
+  size_t mapLength;
+  char *nativeData;
+  const void *rawData;
   bool chunking;
   bool finished;
   bool interpolate;
   bool byteswap;
   unsigned long fileSize;
   unsigned long bufferSize;
-  unsigned long dataOffset;
+  UINT64 dataOffset;
   unsigned int channels;
   long chunkPointer;
   STK_FORMAT dataType;
   MY_FLOAT fileRate;
   MY_FLOAT gain;
-  MY_FLOAT time;
+  MY_FLOAT dataPeak;
+  double time;
   MY_FLOAT rate;
+  bool resampling;
+  Resampler *resampler;
+  MY_FLOAT *resampleBuffer;
+  long resampleFrame;
+  long resampleOrigin;
+  double resampleTime;
+  bool resampleLoop;
+  bool looping;
+  unsigned long loopStart;
+  unsigned long loopEnd;
 };
 
+inline MY_FLOAT WvIn :: rawSample( unsigned long i ) const
+{
+  if ( dataType == STK_SINT16 ) return (MY_FLOAT) ((const SINT16 *) rawData)[i];
+  else if ( dataType == MY_FLOAT32 ) return (MY_FLOAT) ((const FLOAT32 *) rawData)[i];
+  else if ( dataType == STK_SINT32 ) return (MY_FLOAT) ((const SINT32 *) rawData)[i];
+  else if ( dataType == STK_SINT24 ) {
+    const unsigned char *p = (const unsigned char *) rawData + 3*i;
+#ifdef __LITTLE_ENDIAN__
+    return (MY_FLOAT) ((SINT32) (((UINT32) p[2] << 24) | ((UINT32) p[1] << 16) | ((UINT32) p[0] << 8)) >> 8);
+#else
+    return (MY_FLOAT) ((SINT32) (((UINT32) p[0] << 24) | ((UINT32) p[1] << 16) | ((UINT32) p[2] << 8)) >> 8);
+#endif
+  }
+  else if ( dataType == STK_SINT8 ) return (MY_FLOAT) ((const signed char *) rawData)[i];
+  return (MY_FLOAT) ((const FLOAT64 *) rawData)[i];
+}
+
 #endif // defined(__WVIN_H)
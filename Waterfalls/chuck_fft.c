@@ -50,8 +50,21 @@ void apply_window( float * data, float * window, unsigned long length )
 
 static float PI ;
 static float TWOPI ;
+static int fft_ready = 0 ;
 void bit_reverse( float * x, long N );
 
+//-----------------------------------------------------------------------------
+// name: init_fft()
+// desc: set up the constants rfft() and cfft() share; rfft() does this on
+//       first use otherwise, which mustn't happen in two threads at once
+//-----------------------------------------------------------------------------
+void init_fft( void )
+{
+    PI = (float) (4.*atan( 1. )) ;
+    TWOPI = (float) (8.*atan( 1. )) ;
+    fft_ready = 1 ;
+}
+
 //-----------------------------------------------------------------------------
 // name: rfft()
 // desc: real value fft
@@ -71,17 +84,12 @@ void bit_reverse( float * x, long N );
 //-----------------------------------------------------------------------------
 void rfft( float * x, long N, unsigned int forward )
 {
-    static int first = 1 ;
     float c1, c2, h1r, h1i, h2r, h2i, wr, wi, wpr, wpi, temp, theta ;
     float xr, xi ;
     long i, i1, i2, i3, i4, N2p1 ;
 
-    if( first )
-    {
-        PI = (float) (4.*atan( 1. )) ;
-        TWOPI = (float) (8.*atan( 1. )) ;
-        first = 0 ;
-    }
+    if( !fft_ready )
+        init_fft( ) ;
 
     theta = PI/N ;
     wr = 1. ;
@@ -32,6 +32,8 @@ void make_window( float * window, unsigned long length );
 // apply the window
 void apply_window( float * data, float * window, unsigned long length );
 
+// set up the fft's constants: call once, before any threads use rfft()
+void init_fft( void );
 // real fft, N must be power of 2
 void rfft( float * x, long N, unsigned int forward );
 // complex fft, NC must be power of 2
@@ -0,0 +1,262 @@
+//-----------------------------------------------------------------------------
+//   name: stemspack.cpp
+//   desc: Pack the stems of a song into one ".stems" bundle (see StemBundle.h),
+//         so that Waterfalls can open the whole song with one open and one mmap.
+//  usage: stemspack [-i] [-r rate] song.stems file.wav[,name[,icon]] ...
+//         -i stores 16-bit integers instead of 32-bit floats.  -r converts
+//         stems at other sample rates to the given rate, so that they need
+//         no resampling when played.  The name defaults to the file name
+//         without its extension.
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "Stk.h"
+#include "WvIn.h"
+#include "StemBundle.h"
+
+// sample frames converted at a time
+#define PACK_BLOCK 4096
+
+
+//-----------------------------------------------------------------------------
+// name: usage()
+//-----------------------------------------------------------------------------
+void usage( )
+{
+    fprintf( stderr, "usage: stemspack [-i] [-r rate] song.stems file.wav[,name[,icon]] ...\n" );
+    fprintf( stderr, "    -i  store 16-bit integers (default: 32-bit floats)\n" );
+    fprintf( stderr, "    -r  resample the stems to this rate in Hz (default: keep their rates)\n" );
+    exit( 1 );
+}
+
+
+//-----------------------------------------------------------------------------
+// name: pad()
+// desc: write zeros up to the next block boundary
+//-----------------------------------------------------------------------------
+bool pad( FILE * out )
+{
+    static char zeros[STEMS_ALIGNMENT];
+    long pos = ftell( out );
+    if( pos < 0 ) return false;
+    long n = ( STEMS_ALIGNMENT - pos % STEMS_ALIGNMENT ) % STEMS_ALIGNMENT;
+    return fwrite( zeros, 1, n, out ) == (size_t)n;
+}
+
+
+//-----------------------------------------------------------------------------
+// name: main()
+//-----------------------------------------------------------------------------
+int main( int argc, char ** argv )
+{
+    int arg = 1;
+    bool int16 = false;
+    double srate = 0.0;
+    while( arg < argc && argv[arg][0] == '-' )
+    {
+        if( !strcmp( argv[arg], "-i" ) ) { int16 = true; arg++; }
+        else if( !strcmp( argv[arg], "-r" ) && arg + 1 < argc )
+        {
+            srate = atof( argv[arg+1] );
+            if( srate <= 0.0 ) usage();
+            arg += 2;
+        }
+        else usage();
+    }
+    if( argc - arg < 2 ) usage();
+
+    // bundles hold little-endian data
+    UINT32 one = 1;
+    if( *(unsigned char *)&one != 1 )
+    {
+        fprintf( stderr, "stemspack: bundles can only be written on little-endian hosts\n" );
+        return 1;
+    }
+
+    const char * outname = argv[arg++];
+    UINT32 stems = argc - arg;
+    StemsEntry * entries = new StemsEntry[stems];
+    WvIn ** inputs = new WvIn *[stems];
+    memset( entries, 0, stems * sizeof(StemsEntry) );
+
+    // open all the stems and lay out the bundle before writing any data
+    UINT64 offset = sizeof(StemsHeader) + stems * sizeof(StemsEntry);
+    UINT32 bytes = int16 ? 2 : 4;
+    try
+    {
+        for( UINT32 s = 0; s < stems; s++ )
+        {
+            char spec[1024];
+            strncpy( spec, argv[arg+s], sizeof(spec) - 1 );
+            spec[sizeof(spec) - 1] = 0;
+
+            char * name = strchr( spec, ',' );
+            char * icon = NULL;
+            if( name ) { *name++ = 0; icon = strchr( name, ',' ); }
+            if( icon ) *icon++ = 0;
+
+            inputs[s] = new WvIn( spec, FALSE, FALSE );
+
+            if( !name || !*name )
+            {
+                // file name without directory and extension
+                name = strrchr( spec, '/' );
+                name = name ? name + 1 : spec;
+                char * dot = strrchr( name, '.' );
+                if( dot && dot != name ) *dot = 0;
+            }
+            // cut to fit, leaving the (zeroed) last byte as the terminator
+            size_t length = strlen( name );
+            if( length > STEMS_NAME_LENGTH - 1 ) length = STEMS_NAME_LENGTH - 1;
+            memcpy( entries[s].name, name, length );
+            if( icon )
+            {
+                length = strlen( icon );
+                if( length > STEMS_ICON_LENGTH - 1 ) length = STEMS_ICON_LENGTH - 1;
+                memcpy( entries[s].icon, icon, length );
+            }
+
+            offset = ( offset + STEMS_ALIGNMENT - 1 ) / STEMS_ALIGNMENT * STEMS_ALIGNMENT;
+            entries[s].sampleRate = inputs[s]->getFileRate();
+            entries[s].offset = offset;
+            entries[s].frames = inputs[s]->getSize();
+            if( srate > 0.0 && srate != entries[s].sampleRate )
+            {
+                // one output frame for every ratio input frames
+                double ratio = entries[s].sampleRate / srate;
+                entries[s].frames = (UINT64)ceil( entries[s].frames / ratio );
+                entries[s].sampleRate = srate;
+            }
+            entries[s].channels = inputs[s]->getChannels();
+            entries[s].format = int16 ? Stk::STK_SINT16 : Stk::MY_FLOAT32;
+            offset += entries[s].frames * entries[s].channels * bytes;
+        }
+    }
+    catch( StkError & e )
+    {
+        fprintf( stderr, "stemspack: %s\n", e.getMessage() );
+        return 1;
+    }
+
+    FILE * out = fopen( outname, "wb" );
+    if( !out )
+    {
+        fprintf( stderr, "stemspack: could not create %s\n", outname );
+        return 1;
+    }
+
+    // the index is written again once the peaks are known
+    StemsHeader header;
+    memset( &header, 0, sizeof(header) );
+    memcpy( header.magic, STEMS_MAGIC, 8 );
+    header.version = STEMS_VERSION;
+    header.stems = stems;
+    header.alignment = STEMS_ALIGNMENT;
+    bool ok = fwrite( &header, sizeof(header), 1, out ) == 1 &&
+              fwrite( entries, sizeof(StemsEntry), stems, out ) == stems;
+
+    MY_FLOAT * frames = NULL;
+    unsigned int frameChannels = 0;
+    for( UINT32 s = 0; s < stems && ok; s++ )
+    {
+        WvIn * input = inputs[s];
+        unsigned int channels = entries[s].channels;
+        if( channels > frameChannels )
+        {
+            delete [] frames;
+            frames = new MY_FLOAT[PACK_BLOCK * channels];
+            frameChannels = channels;
+        }
+
+        if( entries[s].sampleRate != input->getFileRate() )
+        {
+            // convert with the windowed-sinc resampler, even at integer ratios
+            input->setResample( true );
+            input->setRate( input->getFileRate() / entries[s].sampleRate );
+            input->setInterpolate( true );
+        }
+        else
+        {
+            // read the file data as it is, one sample frame per tick
+            input->setRate( 1.0 );
+            input->setInterpolate( false );
+        }
+
+        // scale to +-1.0 full scale
+        MY_FLOAT scale = 1.0;
+        Stk::STK_FORMAT type = input->getDataType();
+        if( type == Stk::STK_SINT8 ) scale = 1.0 / 128.0;
+        else if( type == Stk::STK_SINT16 ) scale = 1.0 / 32768.0;
+        else if( type == Stk::STK_SINT24 ) scale = 1.0 / 8388608.0;
+        else if( type == Stk::STK_SINT32 ) scale = 1.0 / 2147483648.0;
+
+        ok = pad( out );
+        MY_FLOAT peak = 0.0;
+        for( UINT64 done = 0; done < entries[s].frames && ok; )
+        {
+            unsigned long n = PACK_BLOCK;
+            if( entries[s].frames - done < n ) n = entries[s].frames - done;
+            unsigned long samples = n * channels;
+            input->tickFrame( frames, n );
+
+            for( unsigned long i = 0; i < samples; i++ )
+            {
+                frames[i] *= scale;
+                if( frames[i] > peak ) peak = frames[i];
+                else if( -frames[i] > peak ) peak = -frames[i];
+            }
+
+            if( int16 )
+            {
+                SINT16 block[PACK_BLOCK * 2];
+                for( unsigned long i = 0; i < samples; )
+                {
+                    unsigned long m = samples - i < PACK_BLOCK * 2 ? samples - i : PACK_BLOCK * 2;
+                    for( unsigned long j = 0; j < m; j++ )
+                    {
+                        MY_FLOAT x = frames[i+j] * 32768.0f;
+                        if( x > 32767.0f ) x = 32767.0f;
+                        else if( x < -32768.0f ) x = -32768.0f;
+                        block[j] = (SINT16)( x < 0 ? x - 0.5f : x + 0.5f );
+                    }
+                    ok = ok && fwrite( block, sizeof(SINT16), m, out ) == m;
+                    i += m;
+                }
+            }
+            else
+            {
+                FLOAT32 * block = (FLOAT32 *)frames;
+                ok = fwrite( block, sizeof(FLOAT32), samples, out ) == samples;
+            }
+            done += n;
+        }
+        entries[s].peak = peak;
+
+        fprintf( stderr, "stem %d: %s, %lu frames, %d channel(s), %.0f Hz, peak %.3f\n", s+1,
+                 entries[s].name, (unsigned long)entries[s].frames, channels,
+                 entries[s].sampleRate, peak );
+    }
+
+    ok = ok && pad( out );
+    ok = ok && fseek( out, sizeof(header), SEEK_SET ) == 0 &&
+         fwrite( entries, sizeof(StemsEntry), stems, out ) == stems;
+    ok = ( fclose( out ) == 0 ) && ok;
+
+    for( UINT32 s = 0; s < stems; s++ ) delete inputs[s];
+    delete [] inputs;
+    delete [] entries;
+    delete [] frames;
+
+    if( !ok )
+    {
+        fprintf( stderr, "stemspack: error writing %s\n", outname );
+        remove( outname );
+        return 1;
+    }
+
+    return 0;
+}
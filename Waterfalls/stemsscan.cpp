@@ -0,0 +1,126 @@
+//-----------------------------------------------------------------------------
+//   name: stemsscan.cpp
+//   desc: Index the formats of a library of stem files (see LibraryScanner.h)
+//         and list them, so that songs can be picked without opening them.
+//  usage: stemsscan [-f index] [-j threads] [dir|file ...]
+//         The index is read, brought up to date with the files and the
+//         directories given (searched below for audio files), saved and
+//         listed.  Only new or changed files are read, and only their
+//         headers.  The index defaults to LIBRARY_INDEX in $HOME.
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "Stk.h"
+#include "LibraryScanner.h"
+
+// default index file, in the home directory
+#define LIBRARY_INDEX ".waterfalls-library"
+
+
+//-----------------------------------------------------------------------------
+// name: usage()
+//-----------------------------------------------------------------------------
+void usage( )
+{
+    fprintf( stderr, "usage: stemsscan [-f index] [-j threads] [dir|file ...]\n" );
+    fprintf( stderr, "    -f  index file (default: $HOME/%s)\n", LIBRARY_INDEX );
+    fprintf( stderr, "    -j  threads reading headers (default: one per processor)\n" );
+    exit( 1 );
+}
+
+
+//-----------------------------------------------------------------------------
+// name: formatName()
+// desc: short name of a data format
+//-----------------------------------------------------------------------------
+const char * formatName( UINT32 format )
+{
+    if( format == Stk::STK_SINT8 ) return "int8";
+    if( format == Stk::STK_SINT16 ) return "int16";
+    if( format == Stk::STK_SINT24 ) return "int24";
+    if( format == Stk::STK_SINT32 ) return "int32";
+    if( format == Stk::MY_FLOAT32 ) return "float32";
+    if( format == Stk::MY_FLOAT64 ) return "float64";
+    return "?";
+}
+
+
+//-----------------------------------------------------------------------------
+// name: main()
+//-----------------------------------------------------------------------------
+int main( int argc, char ** argv )
+{
+    int arg = 1;
+    const char * indexName = NULL;
+    unsigned int threads = 0;
+    while( arg < argc && argv[arg][0] == '-' )
+    {
+        if( !strcmp( argv[arg], "-f" ) && arg + 1 < argc )
+        {
+            indexName = argv[arg+1];
+            arg += 2;
+        }
+        else if( !strcmp( argv[arg], "-j" ) && arg + 1 < argc )
+        {
+            threads = atoi( argv[arg+1] );
+            if( threads == 0 ) usage();
+            arg += 2;
+        }
+        else usage();
+    }
+
+    char defaultName[1024];
+    if( !indexName )
+    {
+        const char * home = getenv( "HOME" );
+        if( !home ) usage();
+        snprintf( defaultName, sizeof(defaultName), "%s/%s", home, LIBRARY_INDEX );
+        indexName = defaultName;
+    }
+
+    LibraryScanner library;
+    library.load( indexName );
+    try
+    {
+        for( ; arg < argc; arg++ )
+        {
+            struct stat filestat;
+            if( stat( argv[arg], &filestat ) == 0 && S_ISDIR( filestat.st_mode ) )
+                library.addDirectory( argv[arg] );
+            else
+                library.addFile( argv[arg] );
+        }
+    }
+    catch( StkError & )
+    {
+        return 1;
+    }
+
+    unsigned long read = library.scan( threads );
+    if( !library.save( indexName ) )
+        fprintf( stderr, "stemsscan: couldn't write the index (%s)\n", indexName );
+
+    // channels, rate, length and format of each file
+    unsigned long count = library.getCount();
+    for( unsigned long i = 0; i < count; i++ )
+    {
+        const LibraryEntry * entry = library.getEntry( i );
+        if( entry->channels == 0 )
+        {
+            printf( "%-32s unreadable\n", entry->fileName );
+            continue;
+        }
+        double seconds = entry->frames / entry->fileRate;
+        printf( "%-32s %2u ch %6.0f Hz %4d:%05.2f %s\n", entry->fileName,
+                (unsigned int)entry->channels, (double)entry->fileRate,
+                (int)(seconds / 60), seconds - 60 * (int)(seconds / 60),
+                formatName( entry->format ) );
+    }
+    fprintf( stderr, "stemsscan: %lu files, %lu read\n", count, read );
+
+    return 0;
+}